@@ -0,0 +1,70 @@
+# capi.pro - smart-sweepers-qt engine library
+# Copyright (c) 2018 Arkadiusz Bokowy
+
+TEMPLATE = lib
+
+TARGET = smart-sweepers
+VERSION = 1.0.0
+
+CONFIG -= qt
+CONFIG += shared
+CONFIG += c++11
+
+DEFINES += SS_BUILD_LIBRARY
+INCLUDEPATH += ../src
+
+unix {
+	# required by the std::thread
+	QMAKE_CXXFLAGS += -pthread
+	QMAKE_LFLAGS += -pthread
+	# only the C API is exported
+	QMAKE_CXXFLAGS += -fvisibility=hidden
+}
+
+HEADERS += \
+	smartsweepers.h \
+	../src/CCheckpoint.h \
+	../src/CExportWriter.h \
+	../src/CGenAlg.h \
+	../src/CGenomeHistory.h \
+	../src/CHallOfFame.h \
+	../src/CMineGrid.h \
+	../src/CMinesweeper.h \
+	../src/CNeuralNet.h \
+	../src/CPopulationStats.h \
+	../src/CProfiler.h \
+	../src/CQuantileSketch.h \
+	../src/CSimulation.h \
+	../src/CThreadPool.h \
+	../src/CTrajectory.h \
+	../src/SSimulationConfig.h \
+	../src/SVector2D.h \
+	../src/utils.h
+
+SOURCES += \
+	smartsweepers.cpp \
+	../src/CCheckpoint.cpp \
+	../src/CExportWriter.cpp \
+	../src/CGenAlg.cpp \
+	../src/CGenomeHistory.cpp \
+	../src/CHallOfFame.cpp \
+	../src/CMineGrid.cpp \
+	../src/CMinesweeper.cpp \
+	../src/CNeuralNet.cpp \
+	../src/CPopulationStats.cpp \
+	../src/CProfiler.cpp \
+	../src/CQuantileSketch.cpp \
+	../src/CSimulation.cpp \
+	../src/CThreadPool.cpp \
+	../src/CTrajectory.cpp
+
+unix {
+
+	isEmpty(PREFIX): PREFIX = /usr/local
+
+	target.path = $$PREFIX/lib
+	headers.path = $$PREFIX/include
+	headers.files += smartsweepers.h
+
+	INSTALLS += target headers
+}
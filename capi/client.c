@@ -0,0 +1,143 @@
+// client.c
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Example client of the engine library. It evolves a small population,
+// prints statistics of every generation read from published frames and
+// checks the consistency of exposed buffers. The exit status is non-zero
+// if any check has failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "smartsweepers.h"
+
+
+static int failures = 0;
+
+#define CHECK(expr) do { \
+		if (!(expr)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+			failures++; \
+		} \
+	} while (0)
+
+static double element(const ss_buffer *buffer, size_t i, size_t j) {
+	const char *data = (const char *)buffer->data;
+	return *(const double *)(data + i * buffer->strides[0] + j * buffer->strides[1]);
+}
+
+int main(int argc, char *argv[]) {
+
+	const int generations = argc > 1 ? atoi(argv[1]) : 10;
+
+	CHECK(ss_api_version() == SS_API_VERSION);
+
+	ss_simulation *sim = ss_create(640, 480, 1);
+	CHECK(sim != NULL);
+	if (!sim)
+		return 1;
+
+	CHECK(ss_set_int(sim, "iNumSweepers", 40) == 0);
+	CHECK(ss_set_int(sim, "iNumTicks", 500) == 0);
+	CHECK(ss_set_double(sim, "dMutationRate", 0.05) == 0);
+	CHECK(ss_set_int(sim, "iNoSuchValue", 1) == -1);
+	CHECK(ss_set_int(sim, "iNumInputs", 8) == -1);
+	CHECK(ss_set_double(sim, "iNumSweepers", 1.5) == -1);
+	// copies of the elite have to fit into the population (without overflow)
+	CHECK(ss_set_int(sim, "iNumCopiesElite", 0) == 0);
+	CHECK(ss_set_int(sim, "iNumElite", 1000000) == 0);
+	CHECK(ss_set_int(sim, "iNumCopiesElite", 1000000) == -1);
+	CHECK(ss_set_int(sim, "iNumElite", 4) == 0);
+	CHECK(ss_set_int(sim, "iNumCopiesElite", 1) == 0);
+	ss_reset(sim, 1);
+
+	int weights = 0;
+	CHECK(ss_get_int(sim, "iNumSweepers", &weights) == 0 && weights == 40);
+
+	// the frame of the initial population is held during the whole run
+	const ss_frame *initial = ss_acquire(sim);
+	CHECK(ss_frame_stats(initial)->generation == -1);
+
+	printf("generation,best,average,median,distance\n");
+	for (int i = 0; i < generations; i++) {
+
+		CHECK(ss_step_generations(sim, 1) == 0);
+
+		const ss_frame *frame = ss_acquire(sim);
+		const ss_stats *stats = ss_frame_stats(frame);
+		ss_buffer w, f, s;
+		ss_frame_weights(frame, &w);
+		ss_frame_fitness(frame, &f);
+		ss_frame_sweepers(frame, &s);
+
+		CHECK(ss_frame_generation(frame) == i + 1);
+		CHECK(stats->generation == i);
+		CHECK(w.ndim == 2 && w.shape[0] == 40 && w.shape[0] == f.shape[0]);
+		CHECK(s.ndim == 2 && s.shape[0] == 40 && s.shape[1] == SS_SWEEPER_COLUMNS);
+
+		double best = 0;
+		for (size_t j = 0; j < f.shape[0]; j++)
+			if (element(&f, j, 0) > best)
+				best = element(&f, j, 0);
+		CHECK(best == stats->best_fitness);
+
+		printf("%d,%g,%g,%g,%g\n", stats->generation, stats->best_fitness,
+				stats->average_fitness, stats->fitness_percentiles[2], stats->genome_distance);
+		ss_release(frame);
+
+	}
+
+	// stepping by ticks crosses the generation boundary
+	CHECK(ss_step_ticks(sim, 600) == 0);
+	const ss_frame *frame = ss_acquire(sim);
+	CHECK(ss_frame_generation(frame) == generations + 1);
+	CHECK(ss_frame_tick(frame) == 99);
+	ss_release(frame);
+
+	ss_buffer w;
+	ss_frame_weights(initial, &w);
+	CHECK(w.shape[0] == 0);
+	ss_release(initial);
+
+	// the run does not depend on the number of threads
+	ss_simulation *other = ss_create(640, 480, 1);
+	ss_set_int(other, "iNumSweepers", 40);
+	ss_set_int(other, "iNumTicks", 500);
+	ss_set_double(other, "dMutationRate", 0.05);
+	ss_set_threads(other, 4);
+	ss_reset(other, 1);
+	ss_step_generations(other, generations);
+	ss_step_ticks(other, 600);
+
+	const ss_frame *a = ss_acquire(sim);
+	const ss_frame *b = ss_acquire(other);
+	ss_buffer wa, wb;
+	ss_frame_weights(a, &wa);
+	ss_frame_weights(b, &wb);
+	CHECK(wa.shape[0] == wb.shape[0] && wa.shape[1] == wb.shape[1] &&
+			memcmp(wa.data, wb.data, wa.shape[0] * wa.strides[0]) == 0);
+	ss_release(a);
+	ss_release(b);
+
+	// there are no ticks to step when genomes are evaluated in episodes
+	CHECK(ss_set_int(other, "iNumEpisodes", 2) == 0);
+	ss_reset(other, 1);
+	CHECK(ss_step_ticks(other, 10) == -1);
+	CHECK(ss_step_generations(other, 1) == 0);
+	frame = ss_acquire(other);
+	CHECK(ss_frame_generation(frame) == 1);
+	ss_release(frame);
+
+	ss_destroy(other);
+	ss_destroy(sim);
+
+	if (failures)
+		fprintf(stderr, "%d checks failed\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,457 @@
+// smartsweepers.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#define _USE_MATH_DEFINES
+#include "smartsweepers.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "CSimulation.h"
+
+
+#ifndef M_PI
+#define M_PI (4 * atan(1))
+#endif
+
+
+// Data of the finished generation. It is shared by all frames published
+// until the next generation is finished.
+struct SGenerationFrame {
+	ss_stats stats;
+	int iWeights;
+	vector<double> vecWeights;
+	vector<double> vecFitness;
+	vector<double> vecWeightMean;
+	vector<double> vecWeightVariance;
+};
+
+struct ss_frame {
+	mutable std::atomic<int> refs;
+	int generation;
+	int tick;
+	std::shared_ptr<const SGenerationFrame> finished;
+	vector<double> vecSweepers;
+};
+
+struct ss_simulation {
+
+	ss_simulation(const SSimulationConfig &config, int width, int height) :
+			simulation(config, width, height),
+			config(config),
+			published(nullptr) {  }
+
+	// serializes calls on the simulation
+	std::mutex mutex;
+	CSimulation simulation;
+	SSimulationConfig config;
+
+	// generation finished during the current step, not published yet
+	std::shared_ptr<const SGenerationFrame> finished;
+
+	// the latest frame, swapped under its own lock, so readers are never
+	// blocked by the running step
+	std::mutex publishMutex;
+	const ss_frame *published;
+
+};
+
+
+// the same configuration as the application defaults
+static void configDefaults(SSimulationConfig &config) {
+
+	config.iNumSweepers = 30;
+	config.iNumMines = 40;
+	config.iNumTicks = 2000;
+	config.iControlInterval = 1;
+	config.bControlOnMineEvent = false;
+	config.iNumRays = 0;
+	config.dRayRange = 100;
+	config.dRayFieldOfView = M_PI;
+	config.dMaxTurnRate = 0.3;
+	config.dMaxSpeed = 2;
+	config.dSweeperScale = 5;
+	config.dMineScale = 2;
+
+	config.iNumInputs = CMinesweeper::NumberOfInputs(config.iNumRays);
+	config.iNumHiddenLayers = 1;
+	config.iNeuronsPerHiddenLayer = 6;
+	config.iNumOutputs = 2;
+	config.dActivationResponse = 1;
+	config.dBias = -1;
+
+	config.dCrossoverRate = 0.7;
+	config.dMutationRate = 0.1;
+	config.dMaxPerturbation = 0.3;
+	config.iNumElite = 4;
+	config.iNumCopiesElite = 1;
+	config.iNumEpisodes = 1;
+	config.iEpisodeStatistic = EpisodeStatisticMean;
+
+}
+
+enum ConfigFieldType {
+	ConfigFieldInt,
+	ConfigFieldBool,
+	ConfigFieldDouble,
+};
+
+struct SConfigField {
+	const char *name;
+	size_t offset;
+	int type;
+	// allowed range, read-only fields have an empty one
+	double min;
+	double max;
+};
+
+#define CONFIG_FIELD(name, type, min, max) \
+	{ #name, offsetof(SSimulationConfig, name), type, min, max }
+
+// the number of inputs is derived from the number of rays, and outputs
+// drive the two tracks
+static const SConfigField configFields[] = {
+	CONFIG_FIELD(iNumInputs, ConfigFieldInt, 1, 0),
+	CONFIG_FIELD(iNumHiddenLayers, ConfigFieldInt, 0, 100),
+	CONFIG_FIELD(iNeuronsPerHiddenLayer, ConfigFieldInt, 1, 10000),
+	CONFIG_FIELD(iNumOutputs, ConfigFieldInt, 1, 0),
+	CONFIG_FIELD(dActivationResponse, ConfigFieldDouble, 1e-6, 1e6),
+	CONFIG_FIELD(dBias, ConfigFieldDouble, -1e6, 1e6),
+	CONFIG_FIELD(dMaxTurnRate, ConfigFieldDouble, 0, 2 * M_PI),
+	CONFIG_FIELD(dMaxSpeed, ConfigFieldDouble, 0, 1e6),
+	CONFIG_FIELD(dSweeperScale, ConfigFieldDouble, 0, 1e6),
+	CONFIG_FIELD(dMineScale, ConfigFieldDouble, 0, 1e6),
+	CONFIG_FIELD(iNumSweepers, ConfigFieldInt, 1, 1000000),
+	CONFIG_FIELD(iNumMines, ConfigFieldInt, 1, 1000000),
+	CONFIG_FIELD(iNumTicks, ConfigFieldInt, 1, 1000000000),
+	CONFIG_FIELD(iControlInterval, ConfigFieldInt, 1, 1000000),
+	CONFIG_FIELD(bControlOnMineEvent, ConfigFieldBool, 0, 1),
+	CONFIG_FIELD(iNumRays, ConfigFieldInt, 0, 1000),
+	CONFIG_FIELD(dRayRange, ConfigFieldDouble, 0, 1e6),
+	CONFIG_FIELD(dRayFieldOfView, ConfigFieldDouble, 0, 2 * M_PI),
+	CONFIG_FIELD(dCrossoverRate, ConfigFieldDouble, 0, 1),
+	CONFIG_FIELD(dMutationRate, ConfigFieldDouble, 0, 1),
+	CONFIG_FIELD(dMaxPerturbation, ConfigFieldDouble, 0, 1e6),
+	CONFIG_FIELD(iNumElite, ConfigFieldInt, 0, 1000000),
+	CONFIG_FIELD(iNumCopiesElite, ConfigFieldInt, 0, 1000000),
+	CONFIG_FIELD(iNumEpisodes, ConfigFieldInt, 1, 10000),
+	CONFIG_FIELD(iEpisodeStatistic, ConfigFieldInt, EpisodeStatisticMean, EpisodeStatisticMinimum),
+};
+
+static const SConfigField *configField(const char *name) {
+	if (name)
+		for (auto &field : configFields)
+			if (strcmp(field.name, name) == 0)
+				return &field;
+	return nullptr;
+}
+
+// store the value into the configuration, returns false if it is not allowed
+static bool configSet(SSimulationConfig &config, const SConfigField &field, double value) {
+
+	if (!(value >= field.min && value <= field.max))
+		return false;
+
+	char *data = reinterpret_cast<char *>(&config) + field.offset;
+	switch (field.type) {
+	case ConfigFieldInt:
+		if (value != (int)value)
+			return false;
+		*reinterpret_cast<int *>(data) = value;
+		break;
+	case ConfigFieldBool:
+		*reinterpret_cast<bool *>(data) = value != 0;
+		break;
+	case ConfigFieldDouble:
+		*reinterpret_cast<double *>(data) = value;
+		break;
+	}
+
+	config.iNumInputs = CMinesweeper::NumberOfInputs(config.iNumRays);
+	return true;
+}
+
+static double configGet(const SSimulationConfig &config, const SConfigField &field) {
+	const char *data = reinterpret_cast<const char *>(&config) + field.offset;
+	switch (field.type) {
+	case ConfigFieldInt:
+		return *reinterpret_cast<const int *>(data);
+	case ConfigFieldBool:
+		return *reinterpret_cast<const bool *>(data);
+	default:
+		return *reinterpret_cast<const double *>(data);
+	}
+}
+
+static void frameRelease(const ss_frame *frame) {
+	if (frame && --frame->refs == 0)
+		delete frame;
+}
+
+// Capture the current state into a new frame and make it the latest one.
+// It has to be called with the simulation lock held.
+static void framePublish(ss_simulation *sim) {
+
+	ss_frame *frame = new ss_frame;
+	frame->refs = 1;
+	frame->generation = sim->simulation.Generation();
+	frame->tick = sim->simulation.Ticks();
+	frame->finished = sim->finished;
+
+	const vector<CMinesweeper> &sweepers = sim->simulation.Sweepers();
+	frame->vecSweepers.resize(sweepers.size() * SS_SWEEPER_COLUMNS);
+	double *data = frame->vecSweepers.data();
+	for (auto i = sweepers.begin(); i != sweepers.end(); ++i) {
+		SMinesweeperState state;
+		i->GetState(state);
+		data[SS_SWEEPER_X] = state.x;
+		data[SS_SWEEPER_Y] = state.y;
+		data[SS_SWEEPER_ROTATION] = state.rotation;
+		data[SS_SWEEPER_SPEED] = state.speed;
+		data[SS_SWEEPER_LEFT_TRACK] = state.lTrack;
+		data[SS_SWEEPER_RIGHT_TRACK] = state.rTrack;
+		data[SS_SWEEPER_FITNESS] = state.fitness;
+		data += SS_SWEEPER_COLUMNS;
+	}
+
+	const ss_frame *previous;
+	{
+		std::lock_guard<std::mutex> lock(sim->publishMutex);
+		previous = sim->published;
+		sim->published = frame;
+	}
+	frameRelease(previous);
+
+}
+
+// Genomes are stored by the engine one vector per genome, so they are laid
+// out into the matrix once per generation. Frames share it afterwards.
+static void generationFinished(ss_simulation *sim, const SGenerationStats &stats,
+		const vector<SGenome> &population) {
+
+	auto frame = std::make_shared<SGenerationFrame>();
+
+	frame->stats.generation = stats.iGeneration;
+	frame->stats.population = stats.iPopulation;
+	frame->stats.best_fitness = stats.dBestFitness;
+	frame->stats.worst_fitness = stats.dWorstFitness;
+	frame->stats.average_fitness = stats.dAverageFitness;
+	frame->stats.fitness_variance = stats.dFitnessVariance;
+	for (int i = 0; i < GenerationStatsNumPercentiles; ++i)
+		frame->stats.fitness_percentiles[i] = stats.dFitnessPercentiles[i];
+	frame->stats.genome_distance = stats.dGenomeDistance;
+	frame->stats.weight_diversity = stats.dWeightDiversity;
+	frame->vecWeightMean = stats.vecWeightMean;
+	frame->vecWeightVariance = stats.vecWeightVariance;
+
+	frame->iWeights = population.empty() ? 0 : population[0].vecWeights.size();
+	frame->vecWeights.resize(population.size() * frame->iWeights);
+	frame->vecFitness.resize(population.size());
+	for (unsigned int i = 0; i < population.size(); ++i) {
+		std::copy(population[i].vecWeights.begin(), population[i].vecWeights.end(),
+				frame->vecWeights.begin() + (size_t)i * frame->iWeights);
+		frame->vecFitness[i] = population[i].dFitness;
+	}
+
+	sim->finished = frame;
+
+}
+
+static void bufferMatrix(ss_buffer *buffer, const double *data, size_t rows, size_t columns) {
+	buffer->data = data;
+	buffer->ndim = 2;
+	buffer->shape[0] = rows;
+	buffer->shape[1] = columns;
+	buffer->strides[0] = columns * sizeof(double);
+	buffer->strides[1] = sizeof(double);
+}
+
+static void bufferVector(ss_buffer *buffer, const vector<double> &data) {
+	buffer->data = data.data();
+	buffer->ndim = 1;
+	buffer->shape[0] = data.size();
+	buffer->shape[1] = 1;
+	buffer->strides[0] = sizeof(double);
+	buffer->strides[1] = sizeof(double);
+}
+
+static const vector<double> frameEmpty;
+
+static const ss_stats frameNoStats = { -1, 0, 0, 0, 0, 0, { 0, 0, 0, 0, 0 }, 0, 0 };
+
+
+int ss_api_version(void) {
+	return SS_API_VERSION;
+}
+
+ss_simulation *ss_create(int width, int height, uint64_t seed) {
+
+	if (width <= 0 || height <= 0)
+		return nullptr;
+
+	SSimulationConfig config;
+	configDefaults(config);
+
+	ss_simulation *sim = new (std::nothrow) ss_simulation(config, width, height);
+	if (!sim)
+		return nullptr;
+
+	sim->simulation.SetThreads(1, false);
+	sim->simulation.SetGenerationObserver([sim](const SGenerationStats &stats,
+			const vector<SGenome> &population) {
+		generationFinished(sim, stats, population);
+	});
+	sim->simulation.Reset(seed);
+	framePublish(sim);
+
+	return sim;
+}
+
+void ss_destroy(ss_simulation *sim) {
+	if (!sim)
+		return;
+	frameRelease(sim->published);
+	delete sim;
+}
+
+int ss_set_int(ss_simulation *sim, const char *name, int value) {
+	return ss_set_double(sim, name, value);
+}
+
+int ss_set_double(ss_simulation *sim, const char *name, double value) {
+	const SConfigField *field = configField(name);
+	if (!field)
+		return -1;
+	std::lock_guard<std::mutex> lock(sim->mutex);
+	SSimulationConfig config = sim->config;
+	// the engine checks the whole configuration (e.g. whether copies of the
+	// elite fit into the population)
+	if (!configSet(config, *field, value) || !CSimulation::ValidConfig(config))
+		return -1;
+	sim->config = config;
+	sim->simulation.SetConfig(config);
+	return 0;
+}
+
+int ss_get_int(ss_simulation *sim, const char *name, int *value) {
+	const SConfigField *field = configField(name);
+	if (!field || field->type == ConfigFieldDouble)
+		return -1;
+	std::lock_guard<std::mutex> lock(sim->mutex);
+	*value = configGet(sim->config, *field);
+	return 0;
+}
+
+int ss_get_double(ss_simulation *sim, const char *name, double *value) {
+	const SConfigField *field = configField(name);
+	if (!field)
+		return -1;
+	std::lock_guard<std::mutex> lock(sim->mutex);
+	*value = configGet(sim->config, *field);
+	return 0;
+}
+
+int ss_set_threads(ss_simulation *sim, int threads) {
+	if (threads < 0)
+		return -1;
+	std::lock_guard<std::mutex> lock(sim->mutex);
+	sim->simulation.SetThreads(threads, false);
+	return 0;
+}
+
+void ss_reset(ss_simulation *sim, uint64_t seed) {
+	std::lock_guard<std::mutex> lock(sim->mutex);
+	sim->simulation.Reset(seed);
+	sim->finished.reset();
+	framePublish(sim);
+}
+
+int ss_step_ticks(ss_simulation *sim, int ticks) {
+	std::lock_guard<std::mutex> lock(sim->mutex);
+	int generation = sim->simulation.Generation();
+	for (int i = 0; i < ticks; ++i) {
+		// the whole generation is evaluated at once in the multi-episode mode
+		// (the configuration might have been changed at the generation boundary)
+		if (sim->simulation.Config().iNumEpisodes > 1) {
+			framePublish(sim);
+			return -1;
+		}
+		if (!sim->simulation.Update()) {
+			framePublish(sim);
+			return -1;
+		}
+		if (sim->simulation.Generation() != generation && i + 1 < ticks) {
+			generation = sim->simulation.Generation();
+			framePublish(sim);
+		}
+	}
+	framePublish(sim);
+	return 0;
+}
+
+int ss_step_generations(ss_simulation *sim, int generations) {
+	std::lock_guard<std::mutex> lock(sim->mutex);
+	for (int i = 0; i < generations; ++i) {
+		const int generation = sim->simulation.Generation();
+		while (sim->simulation.Generation() == generation)
+			if (!sim->simulation.Update()) {
+				framePublish(sim);
+				return -1;
+			}
+		framePublish(sim);
+	}
+	return 0;
+}
+
+const ss_frame *ss_acquire(ss_simulation *sim) {
+	std::lock_guard<std::mutex> lock(sim->publishMutex);
+	++sim->published->refs;
+	return sim->published;
+}
+
+void ss_release(const ss_frame *frame) {
+	frameRelease(frame);
+}
+
+int ss_frame_generation(const ss_frame *frame) {
+	return frame->generation;
+}
+
+int ss_frame_tick(const ss_frame *frame) {
+	return frame->tick;
+}
+
+void ss_frame_weights(const ss_frame *frame, ss_buffer *weights) {
+	if (frame->finished)
+		bufferMatrix(weights, frame->finished->vecWeights.data(),
+				frame->finished->vecFitness.size(), frame->finished->iWeights);
+	else
+		bufferMatrix(weights, frameEmpty.data(), 0, 0);
+}
+
+void ss_frame_fitness(const ss_frame *frame, ss_buffer *fitness) {
+	bufferVector(fitness, frame->finished ? frame->finished->vecFitness : frameEmpty);
+}
+
+void ss_frame_weight_stats(const ss_frame *frame, ss_buffer *mean, ss_buffer *variance) {
+	bufferVector(mean, frame->finished ? frame->finished->vecWeightMean : frameEmpty);
+	bufferVector(variance, frame->finished ? frame->finished->vecWeightVariance : frameEmpty);
+}
+
+const ss_stats *ss_frame_stats(const ss_frame *frame) {
+	return frame->finished ? &frame->finished->stats : &frameNoStats;
+}
+
+void ss_frame_sweepers(const ss_frame *frame, ss_buffer *sweepers) {
+	bufferMatrix(sweepers, frame->vecSweepers.data(),
+			frame->vecSweepers.size() / SS_SWEEPER_COLUMNS, SS_SWEEPER_COLUMNS);
+}
@@ -0,0 +1,147 @@
+// smartsweepers.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// C API of the simulation engine, so the evolution can be driven (and its
+// results analyzed) by external tools. The simulation is created, configured
+// and stepped via the opaque handle. The state is published as immutable
+// frames: matrices of genome weights and fitness, sweepers state and the
+// generation statistics. Frames are described by shapes and strides, so
+// tools can wrap them (e.g. as NumPy arrays) without copying.
+//
+// All functions taking the simulation handle can be called from any thread,
+// calls are serialized. A frame stays valid until it is released, even if
+// the simulation is stepped (or destroyed) in the meantime.
+
+#ifndef SMARTSWEEPERSQT_SMARTSWEEPERS_H_
+#define SMARTSWEEPERSQT_SMARTSWEEPERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+# if defined(SS_BUILD_LIBRARY)
+#  define SS_API __declspec(dllexport)
+# else
+#  define SS_API __declspec(dllimport)
+# endif
+#else
+# define SS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// incremented upon any incompatible change of this API
+#define SS_API_VERSION 1
+
+typedef struct ss_simulation ss_simulation;
+typedef struct ss_frame ss_frame;
+
+// Read-only view of float64 values. The element (i, j) is located at the
+// byte offset i * strides[0] + j * strides[1] from the data pointer. Vectors
+// have a single dimension (shape[1] is 1 then).
+typedef struct ss_buffer {
+	const void *data;
+	int ndim;
+	size_t shape[2];
+	size_t strides[2];
+} ss_buffer;
+
+// columns of the sweepers matrix
+enum {
+	SS_SWEEPER_X,
+	SS_SWEEPER_Y,
+	SS_SWEEPER_ROTATION,
+	SS_SWEEPER_SPEED,
+	SS_SWEEPER_LEFT_TRACK,
+	SS_SWEEPER_RIGHT_TRACK,
+	SS_SWEEPER_FITNESS,
+	SS_SWEEPER_COLUMNS,
+};
+
+// distribution and diversity statistics of the finished generation
+typedef struct ss_stats {
+	int32_t generation;
+	int32_t population;
+	double best_fitness;
+	double worst_fitness;
+	double average_fitness;
+	double fitness_variance;
+	// 10th, 25th, 50th, 75th and 90th percentile
+	double fitness_percentiles[5];
+	double genome_distance;
+	double weight_diversity;
+} ss_stats;
+
+// version of the library, compare it with SS_API_VERSION
+SS_API int ss_api_version(void);
+
+// Create the simulation of the world with the given dimensions, using the
+// default configuration of the application and a single thread. The first
+// generation is created with the given seed. Returns NULL upon failure.
+SS_API ss_simulation *ss_create(int width, int height, uint64_t seed);
+SS_API void ss_destroy(ss_simulation *sim);
+
+// Set or get the configuration value. Values are named the same way as in
+// the application settings file (e.g. "iNumSweepers", "dMutationRate").
+// Boolean values are integers, double values can not be read as integers.
+// Changes are applied at the next generation boundary or upon the reset.
+// Returns 0 on success, -1 if the name is not known, the value is read-only
+// or it is out of range.
+SS_API int ss_set_int(ss_simulation *sim, const char *name, int value);
+SS_API int ss_set_double(ss_simulation *sim, const char *name, double value);
+SS_API int ss_get_int(ss_simulation *sim, const char *name, int *value);
+SS_API int ss_get_double(ss_simulation *sim, const char *name, double *value);
+
+// set the number of simulation threads (0 - one per CPU), the outcome of
+// the simulation does not depend on it
+SS_API int ss_set_threads(ss_simulation *sim, int threads);
+
+// start a new run with the given seed
+SS_API void ss_reset(ss_simulation *sim, uint64_t seed);
+
+// Run the given number of simulation ticks or whole generations. The frame
+// is published after every finished generation and before returning.
+// Returns 0 on success, -1 upon the neural network error. In the
+// multi-episode mode (iNumEpisodes > 1) the whole generation is evaluated at
+// once, so there are no ticks to step: ss_step_ticks() returns -1 when it
+// reaches a generation run in that mode (including one started by the step).
+SS_API int ss_step_ticks(ss_simulation *sim, int ticks);
+SS_API int ss_step_generations(ss_simulation *sim, int generations);
+
+// Get the latest published frame, it has to be released afterwards. The
+// frame is never modified.
+SS_API const ss_frame *ss_acquire(ss_simulation *sim);
+SS_API void ss_release(const ss_frame *frame);
+
+// current generation and ticks elapsed in it
+SS_API int ss_frame_generation(const ss_frame *frame);
+SS_API int ss_frame_tick(const ss_frame *frame);
+
+// Genomes of the last finished generation: weights (genomes x weights) and
+// fitness (genomes), in the order of the population. Buffers are empty
+// until the first generation of the run has been finished.
+SS_API void ss_frame_weights(const ss_frame *frame, ss_buffer *weights);
+SS_API void ss_frame_fitness(const ss_frame *frame, ss_buffer *fitness);
+
+// per-weight mean and variance (weights) of the last finished generation
+SS_API void ss_frame_weight_stats(const ss_frame *frame, ss_buffer *mean, ss_buffer *variance);
+
+// statistics of the last finished generation (generation is -1 before the
+// first one has been finished)
+SS_API const ss_stats *ss_frame_stats(const ss_frame *frame);
+
+// state of sweepers at the time of publishing (sweepers x SS_SWEEPER_COLUMNS)
+SS_API void ss_frame_sweepers(const ss_frame *frame, ss_buffer *sweepers);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,173 @@
+// CCheckpoint.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CCheckpoint.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+
+// format version, increment upon any incompatible change
+static const uint32_t checkpointVersion = 1;
+
+
+void CheckpointLayout(SCheckpointHeader &header) {
+
+	memcpy(header.magic, "SSCP", 4);
+	header.version = checkpointVersion;
+	header.configSize = sizeof(SSimulationConfig);
+	header.sweeperSize = sizeof(SMinesweeperState);
+	header.reserved = 0;
+
+	uint64_t offset = CheckpointAlign(sizeof(header));
+	header.fitnessOffset = offset;
+	offset = CheckpointAlign(offset + (uint64_t)header.sweepers * sizeof(double));
+	header.weightsOffset = offset;
+	offset = CheckpointAlign(offset + (uint64_t)header.sweepers * header.weights * sizeof(double));
+	header.sweepersOffset = offset;
+	offset = CheckpointAlign(offset + (uint64_t)header.sweepers * sizeof(SMinesweeperState));
+	header.minesOffset = offset;
+	offset = CheckpointAlign(offset + (uint64_t)header.mines * 2 * sizeof(double));
+	header.relocatedOffset = offset;
+	offset = CheckpointAlign(offset + (uint64_t)header.relocated * sizeof(int32_t));
+	header.histogramOffset = offset;
+	header.size = offset + (uint64_t)header.histogram * sizeof(int32_t);
+
+}
+
+// The layout is computed again from counts, so the header can not point
+// outside of the file nor make sections overlap.
+bool CheckpointValid(const SCheckpointHeader &header, uint64_t size) {
+
+	if (memcmp(header.magic, "SSCP", 4) != 0 ||
+			header.version != checkpointVersion ||
+			header.configSize != sizeof(SSimulationConfig) ||
+			header.sweeperSize != sizeof(SMinesweeperState))
+		return false;
+
+	SCheckpointHeader layout = header;
+	CheckpointLayout(layout);
+
+	return layout.size == header.size && header.size <= size &&
+		layout.fitnessOffset == header.fitnessOffset &&
+		layout.weightsOffset == header.weightsOffset &&
+		layout.sweepersOffset == header.sweepersOffset &&
+		layout.minesOffset == header.minesOffset &&
+		layout.relocatedOffset == header.relocatedOffset &&
+		layout.histogramOffset == header.histogramOffset &&
+		header.width > 0 && header.height > 0 &&
+		header.sweepers > 0 && header.histogram > 0;
+}
+
+
+CCheckpointWriter::CCheckpointWriter() :
+		m_bQuit(false),
+		m_bPending(false),
+		m_bBusy(false),
+		m_iWritten(0),
+		m_dWriteTime(0),
+		m_bError(false) {
+}
+
+CCheckpointWriter::~CCheckpointWriter() {
+	if (m_Thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_bQuit = true;
+		}
+		m_Condition.notify_all();
+		m_Thread.join();
+	}
+}
+
+// The writer thread is started with the first checkpoint.
+void CCheckpointWriter::Write(const std::string &path, vector<unsigned char> &image) {
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_sPath = path;
+		m_vecImage.swap(image);
+		m_bPending = true;
+	}
+
+	if (!m_Thread.joinable())
+		m_Thread = std::thread(&CCheckpointWriter::WriterMain, this);
+	m_Condition.notify_all();
+
+}
+
+void CCheckpointWriter::Wait() {
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Condition.wait(lock, [this]() { return !m_bPending && !m_bBusy; });
+}
+
+int CCheckpointWriter::Written() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_iWritten;
+}
+
+double CCheckpointWriter::WriteTime() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_dWriteTime;
+}
+
+bool CCheckpointWriter::Error() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_bError;
+}
+
+// The checkpoint is written into a temporary file, which replaces the target
+// one afterwards, so there is always a complete checkpoint on the disk. The
+// pending checkpoint is written before the thread exits.
+void CCheckpointWriter::WriterMain() {
+
+	vector<unsigned char> image;
+	std::string path;
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	for (;;) {
+
+		m_Condition.wait(lock, [this]() { return m_bQuit || m_bPending; });
+		if (!m_bPending)
+			break;
+
+		// the previously written buffer is given back for reuse
+		image.swap(m_vecImage);
+		path = m_sPath;
+		m_bPending = false;
+		m_bBusy = true;
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+
+		const std::string temporary = path + ".tmp";
+		FILE *file = fopen(temporary.c_str(), "wb");
+		bool ok = file != nullptr;
+		if (ok) {
+			ok = image.empty() || fwrite(image.data(), image.size(), 1, file) == 1;
+			ok = fclose(file) == 0 && ok;
+		}
+		if (ok && rename(temporary.c_str(), path.c_str()) != 0) {
+			// on some systems the target has to be removed first
+			remove(path.c_str());
+			ok = rename(temporary.c_str(), path.c_str()) == 0;
+		}
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		lock.lock();
+		m_bBusy = false;
+		m_bError = !ok;
+		if (ok)
+			++m_iWritten;
+		m_dWriteTime = elapsed.count();
+		m_Condition.notify_all();
+
+	}
+
+}
@@ -0,0 +1,134 @@
+// CCheckpoint.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Checkpoint of the complete simulation state. The header is followed by
+// sections of fixed-size records (aligned to CheckpointAlignment), so the
+// checkpoint can be used directly from the memory-mapped file - restoring
+// it is mostly a matter of copying weights into place. Checkpoints are
+// written by a background thread, which replaces the file atomically.
+
+#ifndef SMARTSWEEPERSQT_CCHECKPOINT_H_
+#define SMARTSWEEPERSQT_CCHECKPOINT_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CGenAlg.h"
+#include "CMinesweeper.h"
+#include "SSimulationConfig.h"
+
+using std::vector;
+
+
+// alignment of sections (cache line)
+const uint64_t CheckpointAlignment = 64;
+
+// All values are stored in the native byte order. Offsets are relative to
+// the file start. Sections: fitness (double per genome), weights (doubles,
+// genome after genome), sweepers (SMinesweeperState), mines (x and y as
+// doubles), mines relocated during the last tick (int32) and the fitness
+// histogram of sweepers (int32).
+struct SCheckpointHeader {
+	char magic[4];
+	uint32_t version;
+	// sizes of stored structures, so checkpoints written by a different
+	// build (or a different compiler) are rejected
+	uint32_t configSize;
+	uint32_t sweeperSize;
+	uint64_t size;
+
+	SSimulationConfig config;
+	SGenAlgState ga;
+	uint64_t random;
+
+	int32_t width;
+	int32_t height;
+	int32_t ticks;
+	int32_t generations;
+	int32_t eliteThreshold;
+	int32_t eliteCount;
+
+	uint32_t sweepers;
+	uint32_t weights;
+	uint32_t mines;
+	uint32_t relocated;
+	uint32_t histogram;
+	uint32_t reserved;
+
+	uint64_t fitnessOffset;
+	uint64_t weightsOffset;
+	uint64_t sweepersOffset;
+	uint64_t minesOffset;
+	uint64_t relocatedOffset;
+	uint64_t histogramOffset;
+};
+
+// round the offset up to the section alignment
+inline uint64_t CheckpointAlign(uint64_t offset) {
+	return (offset + CheckpointAlignment - 1) / CheckpointAlignment * CheckpointAlignment;
+}
+
+// Fill in the header identification and section offsets for the counts
+// already set in the header.
+void CheckpointLayout(SCheckpointHeader &header);
+
+// Check the header identification and whether all sections fit within the
+// given size (usually the size of the file).
+bool CheckpointValid(const SCheckpointHeader &header, uint64_t size);
+
+
+class CCheckpointWriter {
+
+public:
+
+	CCheckpointWriter();
+	// waits until the pending checkpoint has been written
+	~CCheckpointWriter();
+
+	// Write the checkpoint image in the background. The image is swapped
+	// with the buffer of the previously written one, so buffers are reused.
+	// If the previous checkpoint has not been written yet, it is replaced.
+	void Write(const std::string &path, vector<unsigned char> &image);
+
+	// wait until the pending checkpoint has been written
+	void Wait();
+
+	int Written() const;
+	// time spent on writing the last checkpoint (in seconds)
+	double WriteTime() const;
+	bool Error() const;
+
+private:
+
+	void WriterMain();
+
+	std::thread m_Thread;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_bQuit;
+
+	// pending checkpoint and whether it is being written
+	std::string m_sPath;
+	vector<unsigned char> m_vecImage;
+	bool m_bPending;
+	bool m_bBusy;
+
+	int m_iWritten;
+	double m_dWriteTime;
+	bool m_bError;
+
+	CCheckpointWriter(const CCheckpointWriter &);
+	CCheckpointWriter &operator=(const CCheckpointWriter &);
+
+};
+
+#endif
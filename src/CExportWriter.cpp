@@ -0,0 +1,406 @@
+// CExportWriter.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CExportWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using std::chrono::steady_clock;
+
+
+// format version, increment upon any incompatible change
+static const uint32_t exportVersion = 1;
+
+static const char *exportColumns[] = {
+	"generation", "population",
+	"best_fitness", "average_fitness", "worst_fitness", "fitness_variance",
+	"fitness_p10", "fitness_p25", "fitness_p50", "fitness_p75", "fitness_p90",
+	"genome_distance", "weight_diversity", "compute_time" };
+
+static const int exportNumColumns = sizeof(exportColumns) / sizeof(*exportColumns);
+
+// buffer size of exported files
+static const size_t exportBufferSize = 1024 * 1024;
+
+
+// values of the statistics row in the order of columns
+static void exportRow(const SGenerationStats &stats, double *row) {
+	*row++ = stats.iGeneration;
+	*row++ = stats.iPopulation;
+	*row++ = stats.dBestFitness;
+	*row++ = stats.dAverageFitness;
+	*row++ = stats.dWorstFitness;
+	*row++ = stats.dFitnessVariance;
+	for (int i = 0; i < GenerationStatsNumPercentiles; ++i)
+		*row++ = stats.dFitnessPercentiles[i];
+	*row++ = stats.dGenomeDistance;
+	*row++ = stats.dWeightDiversity;
+	*row++ = stats.dComputeTime;
+}
+
+static FILE *exportOpen(const std::string &path) {
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file)
+		setvbuf(file, nullptr, _IOFBF, exportBufferSize);
+	return file;
+}
+
+
+CExportWriter::CExportWriter(size_t queueLimit) :
+		m_bOpen(false),
+		m_pCSV(nullptr),
+		m_pStats(nullptr),
+		m_pGenomes(nullptr),
+		m_bHistoryChain(false),
+		m_iSinceKeyframe(0),
+		m_iHistoryRawBytes(0),
+		m_iHistoryBytes(0),
+		m_dHistoryEncodeTime(0),
+		m_iHistoryEncoded(0),
+		m_iQueueLimit(queueLimit),
+		m_iQueuedBytes(0),
+		m_bQuit(false),
+		m_iExported(0),
+		m_iDropped(0),
+		m_iWrittenBytes(0),
+		m_dWriteTime(0),
+		m_bError(false) {
+}
+
+CExportWriter::~CExportWriter() {
+	Close();
+}
+
+// Headers are written right away, so a failure is reported before the
+// writer is started.
+bool CExportWriter::Open(const SExportConfig &config) {
+
+	Close();
+
+	m_Config = config;
+	m_iExported = m_iDropped = 0;
+	m_iWrittenBytes = 0;
+	m_dWriteTime = 0;
+	m_bError = false;
+	m_bHistoryChain = false;
+	m_iSinceKeyframe = 0;
+	m_iHistoryRawBytes = m_iHistoryBytes = 0;
+	m_dHistoryEncodeTime = 0;
+	m_iHistoryEncoded = 0;
+
+	const bool history = config.iGenomes == ExportGenomesHistory;
+	m_pCSV = exportOpen(config.sPath + ".csv");
+	m_pStats = exportOpen(config.sPath + ".stats");
+	if (config.iGenomes != ExportGenomesNone)
+		m_pGenomes = exportOpen(config.sPath + (history ? ".history" : ".genomes"));
+
+	bool ok = m_pCSV && m_pStats && (m_pGenomes || config.iGenomes == ExportGenomesNone);
+
+	for (int i = 0; ok && i < exportNumColumns; ++i)
+		ok = fprintf(m_pCSV, i ? ",%s" : "%s", exportColumns[i]) > 0;
+	ok = ok && fputc('\n', m_pCSV) != EOF;
+
+	SExportHeader header;
+	memcpy(header.magic, "SSGS", 4);
+	header.version = exportVersion;
+	const uint32_t columns = exportNumColumns;
+	ok = ok && Write(m_pStats, &header, sizeof(header));
+	ok = ok && Write(m_pStats, &columns, sizeof(columns));
+	for (int i = 0; ok && i < exportNumColumns; ++i) {
+		char name[ExportColumnNameSize] = { 0 };
+		strncpy(name, exportColumns[i], sizeof(name) - 1);
+		ok = Write(m_pStats, name, sizeof(name));
+	}
+
+	if (ok && m_pGenomes) {
+		memcpy(header.magic, history ? "SSGH" : "SSGN", 4);
+		ok = Write(m_pGenomes, &header, sizeof(header));
+	}
+
+	if (!ok) {
+		Close();
+		return false;
+	}
+
+	m_bQuit = false;
+	m_bOpen = true;
+	m_Thread = std::thread(&CExportWriter::WriterMain, this);
+	return true;
+}
+
+void CExportWriter::Close() {
+
+	if (m_Thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_bQuit = true;
+		}
+		m_Condition.notify_one();
+		m_Thread.join();
+	}
+
+	m_bOpen = false;
+	m_Queue.clear();
+	m_iQueuedBytes = 0;
+
+	FILE **files[] = { &m_pCSV, &m_pStats, &m_pGenomes };
+	for (FILE **file : files) {
+		if (*file)
+			fclose(*file);
+		*file = nullptr;
+	}
+
+}
+
+// The fittest genomes are selected in linear time, and only those are sorted.
+void CExportWriter::Push(const SGenerationStats &stats, const vector<SGenome> &population,
+		const SGenomeLineage *lineage) {
+
+	if (!m_bOpen)
+		return;
+
+	SItem item;
+	item.stats = stats;
+	item.iWeights = population.empty() ? 0 : population[0].vecWeights.size();
+
+	if (m_Config.iGenomes == ExportGenomesHistory) {
+		const bool dropped = !PushHistory(item, population, lineage);
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (dropped)
+			++m_iDropped;
+		m_iQueuedBytes += sizeof(SItem) + item.vecHistory.size();
+		m_Queue.push_back(std::move(item));
+		m_Condition.notify_one();
+		return;
+	}
+
+	int count = 0;
+	if (m_Config.iGenomes == ExportGenomesAll)
+		count = population.size();
+	else if (m_Config.iGenomes == ExportGenomesFittest)
+		count = std::min<int>(std::max(0, m_Config.iTopGenomes), population.size());
+
+	const size_t size = sizeof(SItem) + (size_t)count * (item.iWeights + 1) * sizeof(double);
+
+	bool dropped = false;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		// there is always room for the statistics alone
+		if (count && m_iQueuedBytes && m_iQueuedBytes + size > m_iQueueLimit) {
+			dropped = true;
+			++m_iDropped;
+			count = 0;
+		}
+	}
+
+	if (count) {
+
+		m_vecOrder.resize(population.size());
+		for (unsigned int i = 0; i < m_vecOrder.size(); ++i)
+			m_vecOrder[i] = i;
+
+		auto fitter = [&population](int a, int b) {
+			return population[a].dFitness > population[b].dFitness;
+		};
+		if (count < (int)population.size())
+			std::nth_element(m_vecOrder.begin(), m_vecOrder.begin() + count, m_vecOrder.end(), fitter);
+		if (m_Config.iGenomes == ExportGenomesFittest)
+			std::sort(m_vecOrder.begin(), m_vecOrder.begin() + count, fitter);
+
+		item.vecGenomes.resize((size_t)count * (item.iWeights + 1));
+		double *data = item.vecGenomes.data();
+		for (int i = 0; i < count; ++i) {
+			const SGenome &genome = population[m_vecOrder[i]];
+			*data++ = genome.dFitness;
+			const int weights = std::min<int>(item.iWeights, genome.vecWeights.size());
+			std::copy_n(genome.vecWeights.begin(), weights, data);
+			std::fill(data + weights, data + item.iWeights, 0.0);
+			data += item.iWeights;
+		}
+
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_iQueuedBytes += dropped ? sizeof(SItem) : size;
+		m_Queue.push_back(std::move(item));
+	}
+	m_Condition.notify_one();
+
+}
+
+// The keyframe is stored every n-th generation, and whenever the delta can
+// not be stored. The keyframe is dropped if it does not fit into the queue,
+// and then the chain is broken, so the next generation is tried again.
+bool CExportWriter::PushHistory(SItem &item, const vector<SGenome> &population,
+		const SGenomeLineage *lineage) {
+
+	auto start = steady_clock::now();
+
+	const bool delta = lineage && m_bHistoryChain &&
+		lineage->vecFirst.size() == population.size() &&
+		m_iSinceKeyframe + 1 < std::max(1, m_Config.iKeyframeInterval);
+
+	if (delta)
+		GenomeHistoryEncodeDelta(item.stats.iGeneration, population, *lineage, item.vecHistory);
+	else {
+		const size_t size = sizeof(SItem) + sizeof(SGenomeHistoryRecord) +
+			population.size() * (item.iWeights + 1) * sizeof(double);
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_iQueuedBytes && m_iQueuedBytes + size > m_iQueueLimit) {
+			m_bHistoryChain = false;
+			return false;
+		}
+		lock.unlock();
+		GenomeHistoryEncodeKey(item.stats.iGeneration, population, item.vecHistory);
+	}
+
+	std::chrono::duration<double> elapsed = steady_clock::now() - start;
+
+	m_bHistoryChain = true;
+	m_iSinceKeyframe = delta ? m_iSinceKeyframe + 1 : 0;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_iHistoryRawBytes += population.size() * (item.iWeights + 1) * sizeof(double);
+	m_iHistoryBytes += item.vecHistory.size();
+	m_dHistoryEncodeTime += elapsed.count();
+	++m_iHistoryEncoded;
+	return true;
+}
+
+int CExportWriter::ExportedGenerations() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_iExported;
+}
+
+int CExportWriter::DroppedGenerations() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_iDropped;
+}
+
+int CExportWriter::QueuedGenerations() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Queue.size();
+}
+
+size_t CExportWriter::QueuedBytes() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_iQueuedBytes;
+}
+
+double CExportWriter::Throughput() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_dWriteTime ? m_iWrittenBytes / m_dWriteTime : 0;
+}
+
+double CExportWriter::HistoryCompression() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_iHistoryBytes ? (double)m_iHistoryRawBytes / m_iHistoryBytes : 0;
+}
+
+double CExportWriter::HistoryEncodeTime() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_iHistoryEncoded ? m_dHistoryEncodeTime / m_iHistoryEncoded : 0;
+}
+
+bool CExportWriter::Error() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_bError;
+}
+
+// The whole queue is taken at once, so generations which have piled up
+// during a slow write are written as a single batch. Upon quit the queue is
+// drained before the writer exits.
+void CExportWriter::WriterMain() {
+
+	std::deque<SItem> batch;
+
+	for (;;) {
+
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_bQuit || !m_Queue.empty(); });
+			if (m_Queue.empty())
+				break;
+			batch.swap(m_Queue);
+		}
+
+		auto start = steady_clock::now();
+		WriteBatch(batch);
+		std::chrono::duration<double> elapsed = steady_clock::now() - start;
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto i = batch.begin(); i != batch.end(); ++i)
+			m_iQueuedBytes -= sizeof(SItem) + i->vecGenomes.size() * sizeof(double) + i->vecHistory.size();
+		m_iExported += batch.size();
+		m_dWriteTime += elapsed.count();
+		batch.clear();
+
+	}
+
+}
+
+void CExportWriter::WriteBatch(std::deque<SItem> &batch) {
+
+	const uint32_t rows = batch.size();
+	vector<double> values(rows * exportNumColumns);
+	vector<double> row(exportNumColumns);
+
+	std::string csv;
+	for (uint32_t i = 0; i < rows; ++i) {
+		exportRow(batch[i].stats, row.data());
+		for (int j = 0; j < exportNumColumns; ++j) {
+			// transpose rows into the columnar block
+			values[j * rows + i] = row[j];
+			char text[32];
+			snprintf(text, sizeof(text), j ? ",%.17g" : "%.17g", row[j]);
+			csv += text;
+		}
+		csv += '\n';
+	}
+
+	bool ok = Write(m_pCSV, csv.data(), csv.size()) &&
+		Write(m_pStats, &rows, sizeof(rows)) &&
+		Write(m_pStats, values.data(), values.size() * sizeof(double));
+
+	for (auto i = batch.begin(); ok && m_pGenomes && i != batch.end(); ++i) {
+		if (!i->vecHistory.empty())
+			ok = Write(m_pGenomes, i->vecHistory.data(), i->vecHistory.size());
+		if (i->vecGenomes.empty())
+			continue;
+		const uint32_t record[3] = { (uint32_t)i->stats.iGeneration,
+			(uint32_t)(i->vecGenomes.size() / (i->iWeights + 1)), (uint32_t)i->iWeights };
+		ok = Write(m_pGenomes, record, sizeof(record)) &&
+			Write(m_pGenomes, i->vecGenomes.data(), i->vecGenomes.size() * sizeof(double));
+	}
+
+	FILE *files[] = { m_pCSV, m_pStats, m_pGenomes };
+	for (FILE *file : files)
+		if (ok && file && fflush(file) != 0)
+			ok = false;
+
+	if (!ok) {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bError = true;
+	}
+
+}
+
+// Upon write error nothing more is written, but the queue is still drained.
+bool CExportWriter::Write(FILE *file, const void *data, size_t size) {
+
+	if (m_bError)
+		return false;
+	if (size && fwrite(data, size, 1, file) != 1)
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_iWrittenBytes += size;
+	return true;
+}
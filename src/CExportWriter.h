@@ -0,0 +1,173 @@
+// CExportWriter.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Background export of per-generation results. Statistics are written as
+// CSV and as the binary columnar file, optionally followed by the fittest
+// genomes (or the whole population). Generations are handed over through
+// the bounded queue and written in batches by a dedicated thread, so the
+// simulation never waits for the disk.
+
+#ifndef SMARTSWEEPERSQT_CEXPORTWRITER_H_
+#define SMARTSWEEPERSQT_CEXPORTWRITER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CGenAlg.h"
+#include "CGenomeHistory.h"
+#include "CPopulationStats.h"
+
+using std::vector;
+
+
+enum ExportGenomes {
+	ExportGenomesNone,
+	ExportGenomesFittest,
+	ExportGenomesAll,
+	// every generation as the delta from the previous one (see CGenomeHistory.h)
+	ExportGenomesHistory,
+};
+
+struct SExportConfig {
+
+	SExportConfig() :
+			iGenomes(ExportGenomesNone),
+			iTopGenomes(10),
+			iKeyframeInterval(50) {  }
+
+	// path of exported files without the suffix, files are named
+	// <path>.csv, <path>.stats and <path>.genomes (or <path>.history)
+	std::string sPath;
+
+	// which genomes are exported (see ExportGenomes), and how many of the
+	// fittest ones
+	int iGenomes;
+	int iTopGenomes;
+
+	// every n-th generation of the history is stored as the keyframe
+	int iKeyframeInterval;
+
+};
+
+// Columnar statistics file: the header is followed by the column count and
+// 32-byte column names. Then come blocks of rows - the number of rows in the
+// block followed by the values of every column in turn (float64). Genomes
+// file: the header is followed by generation records - the generation, the
+// number of genomes and the number of weights, then the fitness and weights
+// of every genome (float64). All values are stored in the native byte order.
+struct SExportHeader {
+	char magic[4];
+	uint32_t version;
+};
+
+const int ExportColumnNameSize = 32;
+
+
+class CExportWriter {
+
+public:
+
+	// genomes are not queued above the given number of bytes
+	explicit CExportWriter(size_t queueLimit = 64 * 1024 * 1024);
+	~CExportWriter();
+
+	// create exported files and start the writer, returns false upon failure
+	bool Open(const SExportConfig &config);
+	// write everything which has been queued and stop the writer
+	void Close();
+
+	bool IsOpen() const { return m_bOpen; }
+	// whether the lineage of genomes shall be given with the population
+	bool WantsLineage() const { return m_bOpen && m_Config.iGenomes == ExportGenomesHistory; }
+
+	// Queue the generation for writing. Genomes are copied, so the caller
+	// can modify the population right away. When the queue is full, only
+	// the statistics are queued and the generation is counted as dropped.
+	// The history is stored as the delta if the lineage of the population
+	// is given (it has to refer to the previously pushed population). The
+	// delta is small, so it is never dropped, only keyframes are.
+	void Push(const SGenerationStats &stats, const vector<SGenome> &population,
+			const SGenomeLineage *lineage = nullptr);
+
+	// writer state, it is safe to call these from the pushing thread
+	int ExportedGenerations() const;
+	int DroppedGenerations() const;
+	int QueuedGenerations() const;
+	size_t QueuedBytes() const;
+	// bytes written per second of the writer activity
+	double Throughput() const;
+	// size of raw weights compared to the encoded history, and the time of
+	// encoding the generation (in seconds)
+	double HistoryCompression() const;
+	double HistoryEncodeTime() const;
+	bool Error() const;
+
+private:
+
+	struct SItem {
+		SGenerationStats stats;
+		int iWeights;
+		vector<double> vecGenomes;
+		// encoded history record
+		vector<unsigned char> vecHistory;
+	};
+
+	bool PushHistory(SItem &item, const vector<SGenome> &population,
+			const SGenomeLineage *lineage);
+
+	void WriterMain();
+	void WriteBatch(std::deque<SItem> &batch);
+	bool Write(FILE *file, const void *data, size_t size);
+
+	SExportConfig m_Config;
+	bool m_bOpen;
+
+	FILE *m_pCSV;
+	FILE *m_pStats;
+	FILE *m_pGenomes;
+
+	// indexes of genomes sorted by fitness (reused between pushes)
+	vector<int> m_vecOrder;
+
+	// History is encoded by the pushing thread. The delta can be stored only
+	// if the previous generation has been stored as well.
+	bool m_bHistoryChain;
+	int m_iSinceKeyframe;
+	uint64_t m_iHistoryRawBytes;
+	uint64_t m_iHistoryBytes;
+	double m_dHistoryEncodeTime;
+	int m_iHistoryEncoded;
+
+	std::thread m_Thread;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::deque<SItem> m_Queue;
+	size_t m_iQueueLimit;
+	size_t m_iQueuedBytes;
+	bool m_bQuit;
+
+	// writer statistics (guarded by the mutex)
+	int m_iExported;
+	int m_iDropped;
+	uint64_t m_iWrittenBytes;
+	double m_dWriteTime;
+	bool m_bError;
+
+	CExportWriter(const CExportWriter &);
+	CExportWriter &operator=(const CExportWriter &);
+
+};
+
+#endif
@@ -10,14 +10,20 @@
 
 #include <algorithm>
 
-#include "MainWindow.h"
-#include "utils.h"
+#include "CThreadPool.h"
 
 using std::sort;
 
 
-// Sets up the population with random floats.
-CGenAlg::CGenAlg(int popsize, int numweights) :
+// Number of offspring pairs bred by a single pool task. Every pair has its
+// own generator, so this affects only the scheduling.
+static const int breedChunkPairs = 16;
+
+
+// Sets up the GA. The initial population is created by the caller with the
+// CreateChromos(), so it can be allocated in place and in parallel.
+CGenAlg::CGenAlg(int popsize, int numweights, const SSimulationConfig &config) :
+		m_Config(config),
 		m_iPopSize(popsize),
 		m_iChromoLength(numweights),
 		m_dTotalFitness(0),
@@ -26,37 +32,65 @@ CGenAlg::CGenAlg(int popsize, int numweights) :
 		m_dWorstFitness(99999999),
 		m_iFittestGenome(0),
 		m_cGeneration(0) {
+}
 
-	// initialize population with chromosomes consisting of random
-	// weights and all fitnesses set to zero
-	for (int i = 0; i < m_iPopSize; ++i) {
-		m_vecPop.push_back(SGenome());
+void CGenAlg::GetState(SGenAlgState &state) const {
+	state.random = m_Random.State();
+	state.totalFitness = m_dTotalFitness;
+	state.bestFitness = m_dBestFitness;
+	state.averageFitness = m_dAverageFitness;
+	state.worstFitness = m_dWorstFitness;
+	state.fittestGenome = m_iFittestGenome;
+	state.generation = m_cGeneration;
+}
+
+void CGenAlg::SetState(const SGenAlgState &state) {
+	m_Random.Seed(state.random);
+	m_dTotalFitness = state.totalFitness;
+	m_dBestFitness = state.bestFitness;
+	m_dAverageFitness = state.averageFitness;
+	m_dWorstFitness = state.worstFitness;
+	m_iFittestGenome = state.fittestGenome;
+	m_cGeneration = state.generation;
+}
+
+// Initialize chromosomes with random weights and set fitnesses to zero.
+void CGenAlg::CreateChromos(vector<SGenome> &population, int first, int last, uint64_t seed) const {
+	for (int i = first; i < last; ++i) {
+		CRandom random(SplitSeed(seed, i));
+		population[i].vecWeights.resize(m_iChromoLength);
 		for (int j = 0; j < m_iChromoLength; ++j)
-			m_vecPop[i].vecWeights.push_back(RandomClamped());
+			population[i].vecWeights[j] = random.RandomClamped();
+		population[i].dFitness = 0;
 	}
-
 }
 
 // Mutates a chromosome by perturbing its weights by an amount not
 // greater than max perturbation.
-void CGenAlg::Mutate(vector<double> &chromo) {
+void CGenAlg::Mutate(vector<double> &chromo, CRandom &random, SMutations *mutations) const {
+	const double rate = m_Config.dMutationRate;
+	const double perturbation = m_Config.dMaxPerturbation;
 	// traverse the chromosome and mutate each weight dependent
 	// on the mutation rate
 	for (unsigned int i = 0; i < chromo.size(); ++i)
 		// do we perturb this weight?
-		if (RandFloat() < MainWindow::s.dMutationRate)
+		if (random.RandFloat() < rate) {
 			// add or subtract a small value to the weight
-			chromo[i] += RandomClamped() * MainWindow::s.dMaxPerturbation;
+			const double delta = random.RandomClamped() * perturbation;
+			chromo[i] += delta;
+			if (mutations) {
+				mutations->vecIndex.push_back(i);
+				mutations->vecDelta.push_back(delta);
+			}
+		}
 }
 
-// Returns a chromo based on roulette wheel sampling.
-SGenome CGenAlg::GetChromoRoulette() {
+// Returns a chromo based on roulette wheel sampling. The chromo is not
+// copied, the caller reads its weights in place.
+int CGenAlg::GetChromoRoulette(CRandom &random) const {
 
 	// generate a random number between 0 & total fitness count
-	double Slice = (double)(RandFloat() * m_dTotalFitness);
-
-	// this will be set to the chosen chromosome
-	SGenome TheChosenOne;
+	double Slice = (double)(random.RandFloat() * m_dTotalFitness);
 
 	// go through the chromosones adding up the fitness so far
 	double FitnessSoFar = 0;
@@ -66,31 +100,30 @@ SGenome CGenAlg::GetChromoRoulette() {
 
 		// if the fitness so far > random number return
 		// the chromo at this point
-		if (FitnessSoFar >= Slice) {
-			TheChosenOne = m_vecPop[i];
-			break;
-		}
+		if (FitnessSoFar >= Slice)
+			return i;
 
 	}
 
-	return TheChosenOne;
+	// the slice never exceeds the total, this is just for the safety
+	return m_iPopSize - 1;
 }
 
 // Given parents and storage for the offspring this method performs
 // crossover according to the GAs crossover rate.
-void CGenAlg::Crossover(const vector<double> &mum, const vector<double> &dad,
-			vector<double> &baby1, vector<double> &baby2) {
+int CGenAlg::Crossover(const vector<double> &mum, const vector<double> &dad,
+			vector<double> &baby1, vector<double> &baby2, CRandom &random) const {
 
 	// just return parents as offspring dependent on the rate
 	// or if parents are the same
-	if (RandFloat() > MainWindow::s.dCrossoverRate || mum == dad) {
+	if (random.RandFloat() > m_Config.dCrossoverRate || mum == dad) {
 		baby1 = mum;
 		baby2 = dad;
-		return;
+		return mum.size();
 	}
 
 	// determine a crossover point
-	int cp = RandInt(0, m_iChromoLength - 1);
+	int cp = random.RandInt(0, m_iChromoLength - 1);
 
 	//create the offspring
 	for (int i = 0; i < cp; ++i) {
@@ -103,20 +136,42 @@ void CGenAlg::Crossover(const vector<double> &mum, const vector<double> &dad,
 		baby2.push_back(mum[i]);
 	}
 
+	return cp;
 }
 
 // Takes a population of chromosones and runs the algorithm through one
 // cycle. Returns a new population of chromosones.
-vector<SGenome> CGenAlg::Epoch(vector<SGenome> &old_pop) {
-
-	// assign the given population to the classes population
-	m_vecPop = old_pop;
+vector<SGenome> CGenAlg::Epoch(vector<SGenome> &old_pop, CThreadPool &pool,
+		SGenomeLineage *lineage) {
 
 	// reset the appropriate variables
 	Reset();
 
-	// sort the population (for scaling and elitism)
-	sort(m_vecPop.begin(), m_vecPop.end());
+	// Sort the population (for scaling and elitism). Keys are sorted in place
+	// of genomes, so the origin of every genome is known. The order is the
+	// same as the one of sorted genomes, because only fitness is compared.
+	struct SKey {
+		double dFitness;
+		int iIndex;
+	};
+	vector<SKey> keys(old_pop.size());
+	for (unsigned int i = 0; i < old_pop.size(); ++i) {
+		keys[i].dFitness = old_pop[i].dFitness;
+		keys[i].iIndex = i;
+	}
+	sort(keys.begin(), keys.end(),
+			[](const SKey &a, const SKey &b) { return a.dFitness < b.dFitness; });
+
+	// assign the given population to the classes population
+	m_vecPop.resize(old_pop.size());
+	m_vecOrigin.resize(old_pop.size());
+	for (unsigned int i = 0; i < keys.size(); ++i) {
+		m_vecPop[i] = old_pop[keys[i].iIndex];
+		m_vecOrigin[i] = keys[i].iIndex;
+	}
+
+	if (lineage)
+		lineage->Clear();
 
 	// calculate best, worst, average and total fitness
 	CalculateBestWorstAvTot();
@@ -127,30 +182,77 @@ vector<SGenome> CGenAlg::Epoch(vector<SGenome> &old_pop) {
 	// Now to add a little elitism we shall add in some copies of the
 	// fittest genomes. Make sure we add an EVEN number or the roulette
 	// wheel sampling will crash.
-	if (!(MainWindow::s.iNumCopiesElite * MainWindow::s.iNumElite % 2))
-		GrabNBest(MainWindow::s.iNumElite, MainWindow::s.iNumCopiesElite, vecNewPop);
+	if (!(m_Config.iNumCopiesElite * m_Config.iNumElite % 2))
+		GrabNBest(m_Config.iNumElite, m_Config.iNumCopiesElite, vecNewPop, lineage);
+
+	// Now we enter the GA loop. Babies are created in pairs, and every pair
+	// draws from its own generator, so pairs can be bred concurrently. With
+	// an odd population there is one genome too many. It is dropped, so the
+	// size of the population (which is saved in checkpoints) never changes.
+	const int elites = vecNewPop.size();
+	const int pairs = std::max(0, m_iPopSize - elites + 1) / 2;
+	const uint64_t seed = m_Random.Next();
+	vecNewPop.resize(elites + pairs * 2);
+
+	vector<SMutations> vecMutations;
+	if (lineage) {
+		lineage->vecFirst.resize(elites + pairs * 2);
+		lineage->vecSecond.resize(elites + pairs * 2);
+		lineage->vecCrossover.resize(elites + pairs * 2);
+		vecMutations.resize(pairs * 2);
+	}
+
+	pool.ParallelFor(0, pairs, breedChunkPairs, [&](int first, int last) {
+		for (int k = first; k < last; ++k) {
 
-	// now we enter the GA loop
+			CRandom random(SplitSeed(seed, k));
+			const int i = elites + k * 2;
 
-	// repeat until a new population is generated
-	while (vecNewPop.size() < (unsigned)m_iPopSize) {
+			// grab two chromosones
+			const int mum = GetChromoRoulette(random);
+			const int dad = GetChromoRoulette(random);
 
-		// grab two chromosones
-		SGenome mum = GetChromoRoulette();
-		SGenome dad = GetChromoRoulette();
+			// create some offspring via crossover
+			vector<double> &baby1 = vecNewPop[i].vecWeights;
+			vector<double> &baby2 = vecNewPop[i + 1].vecWeights;
 
-		// create some offspring via crossover
-		vector<double> baby1, baby2;
+			const int cp = Crossover(m_vecPop[mum].vecWeights, m_vecPop[dad].vecWeights,
+					baby1, baby2, random);
 
-		Crossover(mum.vecWeights, dad.vecWeights, baby1, baby2);
+			if (lineage) {
+				// without the crossover babies are copies of their parents
+				const bool copies = cp == (int)m_vecPop[mum].vecWeights.size();
+				lineage->vecFirst[i] = m_vecOrigin[mum];
+				lineage->vecSecond[i] = m_vecOrigin[copies ? mum : dad];
+				lineage->vecCrossover[i] = cp;
+				lineage->vecFirst[i + 1] = m_vecOrigin[dad];
+				lineage->vecSecond[i + 1] = m_vecOrigin[copies ? dad : mum];
+				lineage->vecCrossover[i + 1] = cp;
+			}
 
-		// now we mutate
-		Mutate(baby1);
-		Mutate(baby2);
+			// now we mutate
+			Mutate(baby1, random, lineage ? &vecMutations[k * 2] : nullptr);
+			Mutate(baby2, random, lineage ? &vecMutations[k * 2 + 1] : nullptr);
 
-		// now copy into vecNewPop population
-		vecNewPop.push_back(SGenome(baby1, 0));
-		vecNewPop.push_back(SGenome(baby2, 0));
+		}
+	});
+
+	vecNewPop.resize(std::min<int>(vecNewPop.size(), m_iPopSize));
+
+	if (lineage) {
+		// mutations are gathered per genome, so they are merged in order
+		lineage->vecFirst.resize(vecNewPop.size());
+		lineage->vecSecond.resize(vecNewPop.size());
+		lineage->vecCrossover.resize(vecNewPop.size());
+		lineage->vecMutationsEnd.resize(std::min<int>(elites, vecNewPop.size()));
+		for (unsigned int i = elites; i < vecNewPop.size(); ++i) {
+			const SMutations &mutations = vecMutations[i - elites];
+			lineage->vecMutationIndex.insert(lineage->vecMutationIndex.end(),
+					mutations.vecIndex.begin(), mutations.vecIndex.end());
+			lineage->vecMutationDelta.insert(lineage->vecMutationDelta.end(),
+					mutations.vecDelta.begin(), mutations.vecDelta.end());
+			lineage->vecMutationsEnd.push_back(lineage->vecMutationIndex.size());
+		}
 	}
 
 	// finished so assign new pop back into m_vecPop
@@ -161,12 +263,21 @@ vector<SGenome> CGenAlg::Epoch(vector<SGenome> &old_pop) {
 
 // This works like an advanced form of elitism by inserting NumCopies
 // copies of the NBest most fittest genomes into a population vector.
-void CGenAlg::GrabNBest(int NBest, const int NumCopies, vector<SGenome> &vecPop) {
+void CGenAlg::GrabNBest(int NBest, const int NumCopies, vector<SGenome> &vecPop,
+		SGenomeLineage *lineage) {
 	// add the required amount of copies of the n most fittest
 	// to the supplied vector
 	while (NBest--)
-		for (int i = 0; i < NumCopies; ++i)
-			vecPop.push_back(m_vecPop[(m_iPopSize - 1) - NBest]);
+		for (int i = 0; i < NumCopies; ++i) {
+			const int elite = (m_iPopSize - 1) - NBest;
+			vecPop.push_back(m_vecPop[elite]);
+			if (lineage) {
+				lineage->vecFirst.push_back(m_vecOrigin[elite]);
+				lineage->vecSecond.push_back(m_vecOrigin[elite]);
+				lineage->vecCrossover.push_back(m_vecPop[elite].vecWeights.size());
+				lineage->vecMutationsEnd.push_back(lineage->vecMutationIndex.size());
+			}
+		}
 }
 
 // Calculates the fittest and weakest genome and the average/total
@@ -14,10 +14,16 @@
 #ifndef SMARTSWEEPERSQT_CGENALG_H_
 #define SMARTSWEEPERSQT_CGENALG_H_
 
+#include <cstdint>
 #include <vector>
 
+#include "SSimulationConfig.h"
+#include "utils.h"
+
 using std::vector;
 
+class CThreadPool;
+
 
 // create a structure to hold each genome
 struct SGenome {
@@ -39,39 +45,113 @@ struct SGenome {
 };
 
 
+// Origin of genomes created by the GA epoch. Indexes refer to the population
+// given to the epoch. The genome consists of weights [0, crossover) of the
+// first parent and the rest of the second one, then mutation deltas are
+// added to the listed weights. Elite copies have the same parents and no
+// mutations.
+struct SGenomeLineage {
+
+	void Clear() {
+		vecFirst.clear();
+		vecSecond.clear();
+		vecCrossover.clear();
+		vecMutationsEnd.clear();
+		vecMutationIndex.clear();
+		vecMutationDelta.clear();
+	}
+
+	vector<int> vecFirst;
+	vector<int> vecSecond;
+	vector<int> vecCrossover;
+	// mutations of the i-th genome are [vecMutationsEnd[i - 1], vecMutationsEnd[i])
+	vector<int> vecMutationsEnd;
+	vector<int> vecMutationIndex;
+	vector<double> vecMutationDelta;
+
+};
+
+
+// GA state carried over between epochs, stored in checkpoints
+struct SGenAlgState {
+	uint64_t random;
+	double totalFitness;
+	double bestFitness;
+	double averageFitness;
+	double worstFitness;
+	int32_t fittestGenome;
+	int32_t generation;
+};
+
+
 // the genetic algorithm class
 class CGenAlg {
 
 public:
 
-	CGenAlg(int popsize, int numweights);
+	CGenAlg(int popsize, int numweights, const SSimulationConfig &config);
+
+	// replace GA parameters used by the next epoch
+	void SetConfig(const SSimulationConfig &config) { m_Config = config; }
+
+	// seed the generator used for the selection, crossover and mutation
+	void Seed(uint64_t seed) { m_Random.Seed(seed); }
+
+	void GetState(SGenAlgState &state) const;
+	void SetState(const SGenAlgState &state);
 
-	// this runs the GA for one generation
-	vector<SGenome> Epoch(vector<SGenome> &old_pop);
+	// Fill genomes [first, last) of the given population with random weights.
+	// Every genome uses its own generator derived from the seed, so ranges
+	// can be processed concurrently and the outcome is always the same.
+	void CreateChromos(vector<SGenome> &population, int first, int last, uint64_t seed) const;
 
-	vector<SGenome> GetChromos() const { return m_vecPop; }
+	// This runs the GA for one generation. Offspring pairs are bred on the
+	// pool, every pair with its own generator derived from the GA one, so
+	// the outcome does not depend on the number of threads. If the lineage
+	// is given, it is filled in with the origin of every new genome.
+	vector<SGenome> Epoch(vector<SGenome> &old_pop, CThreadPool &pool,
+			SGenomeLineage *lineage = nullptr);
 	double AverageFitness() const { return m_dTotalFitness / m_iPopSize; }
 	double BestFitness() const { return m_dBestFitness; }
 
 private:
 
-	void Crossover(const vector<double> &mum, const vector<double> &dad,
-			vector<double> &baby1, vector<double> &baby2);
+	// mutations of a single genome recorded for the lineage
+	struct SMutations {
+		vector<int> vecIndex;
+		vector<double> vecDelta;
+	};
 
-	void Mutate(vector<double> &chromo);
+	// returns the crossover point (the chromosome length if there was none)
+	int Crossover(const vector<double> &mum, const vector<double> &dad,
+			vector<double> &baby1, vector<double> &baby2, CRandom &random) const;
 
-	SGenome GetChromoRoulette();
+	void Mutate(vector<double> &chromo, CRandom &random, SMutations *mutations) const;
+
+	// returns the index of the chosen chromosome
+	int GetChromoRoulette(CRandom &random) const;
 
 	// use to introduce elitism
-	void GrabNBest(int NBest, const int NumCopies, vector<SGenome> &vecPop);
+	void GrabNBest(int NBest, const int NumCopies, vector<SGenome> &vecPop,
+			SGenomeLineage *lineage);
 
 	void CalculateBestWorstAvTot();
 
 	void Reset();
 
+	// GA parameters
+	SSimulationConfig m_Config;
+
+	// generator owned by the GA, so the evolution does not depend on other
+	// users of the global generator (and its state can be saved)
+	CRandom m_Random;
+
 	// this holds the entire population of chromosomes
 	vector<SGenome> m_vecPop;
 
+	// index of every chromosome in the population given to the epoch
+	vector<int> m_vecOrigin;
+
 	// size of population
 	int m_iPopSize;
 
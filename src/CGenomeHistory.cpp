@@ -0,0 +1,264 @@
+// CGenomeHistory.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CGenomeHistory.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "CExportWriter.h"
+
+
+// format version, increment upon any incompatible change
+static const uint32_t historyVersion = 1;
+
+
+static uint64_t historyPayloadSize(const SGenomeHistoryRecord &record) {
+	if (record.type == GenomeHistoryKey)
+		return (uint64_t)record.genomes * ((uint64_t)record.weights + 1) * sizeof(double);
+	return (uint64_t)record.genomes * (sizeof(double) + 4 * sizeof(uint32_t)) +
+		(uint64_t)record.mutations * (sizeof(uint32_t) + sizeof(double));
+}
+
+static unsigned char *historyAppend(vector<unsigned char> &buffer, size_t size) {
+	const size_t offset = buffer.size();
+	buffer.resize(offset + size);
+	return buffer.data() + offset;
+}
+
+static void historyAppendIndexes(vector<unsigned char> &buffer, const vector<int> &values) {
+	unsigned char *data = historyAppend(buffer, values.size() * sizeof(uint32_t));
+	for (unsigned int i = 0; i < values.size(); ++i) {
+		const uint32_t value = values[i];
+		memcpy(data + i * sizeof(value), &value, sizeof(value));
+	}
+}
+
+static void historyAppendFitness(vector<unsigned char> &buffer, const vector<SGenome> &population) {
+	unsigned char *data = historyAppend(buffer, population.size() * sizeof(double));
+	for (unsigned int i = 0; i < population.size(); ++i)
+		memcpy(data + i * sizeof(double), &population[i].dFitness, sizeof(double));
+}
+
+void GenomeHistoryEncodeKey(int generation, const vector<SGenome> &population,
+		vector<unsigned char> &buffer) {
+
+	SGenomeHistoryRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = GenomeHistoryKey;
+	record.generation = generation;
+	record.genomes = population.size();
+	record.weights = population.empty() ? 0 : population[0].vecWeights.size();
+	record.size = historyPayloadSize(record);
+
+	buffer.reserve(buffer.size() + sizeof(record) + record.size);
+	memcpy(historyAppend(buffer, sizeof(record)), &record, sizeof(record));
+	historyAppendFitness(buffer, population);
+
+	const size_t size = record.weights * sizeof(double);
+	unsigned char *data = historyAppend(buffer, record.genomes * size);
+	for (unsigned int i = 0; i < population.size(); ++i)
+		memcpy(data + i * size, population[i].vecWeights.data(), size);
+
+}
+
+void GenomeHistoryEncodeDelta(int generation, const vector<SGenome> &population,
+		const SGenomeLineage &lineage, vector<unsigned char> &buffer) {
+
+	SGenomeHistoryRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = GenomeHistoryDelta;
+	record.generation = generation;
+	record.genomes = population.size();
+	record.weights = population.empty() ? 0 : population[0].vecWeights.size();
+	record.mutations = lineage.vecMutationIndex.size();
+	record.size = historyPayloadSize(record);
+
+	buffer.reserve(buffer.size() + sizeof(record) + record.size);
+	memcpy(historyAppend(buffer, sizeof(record)), &record, sizeof(record));
+	historyAppendFitness(buffer, population);
+	historyAppendIndexes(buffer, lineage.vecFirst);
+	historyAppendIndexes(buffer, lineage.vecSecond);
+	historyAppendIndexes(buffer, lineage.vecCrossover);
+	historyAppendIndexes(buffer, lineage.vecMutationsEnd);
+	historyAppendIndexes(buffer, lineage.vecMutationIndex);
+
+	const size_t size = record.mutations * sizeof(double);
+	memcpy(historyAppend(buffer, size), lineage.vecMutationDelta.data(), size);
+
+}
+
+
+CGenomeHistoryReader::CGenomeHistoryReader() :
+		m_pData(nullptr),
+		m_iCurrent(-1) {
+}
+
+// Records are only indexed here. The archive might have been cut in the
+// middle of the record (e.g. the export has not been finished), so the
+// incomplete record at the end is ignored.
+bool CGenomeHistoryReader::Open(const unsigned char *data, uint64_t size) {
+
+	m_pData = data;
+	m_vecRecords.clear();
+	m_vecOffsets.clear();
+	m_iCurrent = -1;
+
+	SExportHeader header;
+	if (size < sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, "SSGH", 4) != 0 || header.version != historyVersion)
+		return false;
+
+	uint64_t offset = sizeof(header);
+	while (size - offset >= sizeof(SGenomeHistoryRecord)) {
+
+		SGenomeHistoryRecord record;
+		memcpy(&record, data + offset, sizeof(record));
+		if ((record.type != GenomeHistoryKey && record.type != GenomeHistoryDelta) ||
+				record.size != historyPayloadSize(record))
+			return false;
+		// the archive has to start with the keyframe
+		if (m_vecRecords.empty() && record.type != GenomeHistoryKey)
+			return false;
+
+		offset += sizeof(record);
+		if (size - offset < record.size)
+			break;
+
+		m_vecRecords.push_back(record);
+		m_vecOffsets.push_back(offset);
+		offset += record.size;
+
+	}
+
+	return true;
+}
+
+// generations are stored in the ascending order
+int CGenomeHistoryReader::Find(int generation) const {
+	int first = 0, last = m_vecRecords.size();
+	while (first < last) {
+		const int middle = (first + last) / 2;
+		if (m_vecRecords[middle].generation < generation)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+	if (first < (int)m_vecRecords.size() && m_vecRecords[first].generation == generation)
+		return first;
+	return -1;
+}
+
+bool CGenomeHistoryReader::Population(int index, vector<SGenome> &population) {
+
+	if (index < 0 || index >= (int)m_vecRecords.size())
+		return false;
+
+	// continue from the last decoded record if it is on the way
+	int key = index;
+	while (m_vecRecords[key].type != GenomeHistoryKey)
+		--key;
+	int next = key;
+	if (m_iCurrent >= key && m_iCurrent <= index)
+		next = m_iCurrent + 1;
+	else if (!DecodeKey(key))
+		return false;
+
+	for (; next <= index; ++next)
+		if (!(m_vecRecords[next].type == GenomeHistoryKey ? DecodeKey(next) : DecodeDelta(next))) {
+			m_iCurrent = -1;
+			return false;
+		}
+
+	population = m_vecPopulation;
+	return true;
+}
+
+bool CGenomeHistoryReader::DecodeKey(int index) {
+
+	const SGenomeHistoryRecord &record = m_vecRecords[index];
+	const unsigned char *fitness = m_pData + m_vecOffsets[index];
+	const unsigned char *weights = fitness + record.genomes * sizeof(double);
+	const size_t size = record.weights * sizeof(double);
+
+	m_vecPopulation.resize(record.genomes);
+	for (unsigned int i = 0; i < record.genomes; ++i) {
+		SGenome &genome = m_vecPopulation[i];
+		memcpy(&genome.dFitness, fitness + i * sizeof(double), sizeof(double));
+		genome.vecWeights.resize(record.weights);
+		memcpy(genome.vecWeights.data(), weights + i * size, size);
+	}
+
+	m_iCurrent = index;
+	return true;
+}
+
+// Every genome is spliced from its parents and then mutated. Indexes are
+// validated, so the corrupted archive can not make the reader access memory
+// out of bounds.
+bool CGenomeHistoryReader::DecodeDelta(int index) {
+
+	const SGenomeHistoryRecord &record = m_vecRecords[index];
+	const uint32_t genomes = record.genomes;
+	const uint32_t weights = record.weights;
+	if (m_iCurrent != index - 1 || m_vecPopulation.empty() ||
+			m_vecPopulation[0].vecWeights.size() != weights)
+		return false;
+
+	const unsigned char *fitness = m_pData + m_vecOffsets[index];
+	const unsigned char *first = fitness + genomes * sizeof(double);
+	const unsigned char *second = first + genomes * sizeof(uint32_t);
+	const unsigned char *crossover = second + genomes * sizeof(uint32_t);
+	const unsigned char *mutationsEnd = crossover + genomes * sizeof(uint32_t);
+	const unsigned char *mutationIndex = mutationsEnd + genomes * sizeof(uint32_t);
+	const unsigned char *mutationDelta = mutationIndex + record.mutations * sizeof(uint32_t);
+
+	auto load = [](const unsigned char *data, uint32_t i) {
+		uint32_t value;
+		memcpy(&value, data + i * sizeof(value), sizeof(value));
+		return value;
+	};
+
+	const uint32_t parents = m_vecPopulation.size();
+	m_vecNext.resize(genomes);
+	uint32_t mutation = 0;
+
+	for (uint32_t i = 0; i < genomes; ++i) {
+
+		const uint32_t a = load(first, i);
+		const uint32_t b = load(second, i);
+		const uint32_t cp = load(crossover, i);
+		const uint32_t end = load(mutationsEnd, i);
+		if (a >= parents || b >= parents || cp > weights ||
+				end < mutation || end > record.mutations)
+			return false;
+
+		SGenome &genome = m_vecNext[i];
+		memcpy(&genome.dFitness, fitness + i * sizeof(double), sizeof(double));
+		genome.vecWeights.resize(weights);
+		const vector<double> &mum = m_vecPopulation[a].vecWeights;
+		const vector<double> &dad = m_vecPopulation[b].vecWeights;
+		std::copy(mum.begin(), mum.begin() + cp, genome.vecWeights.begin());
+		std::copy(dad.begin() + cp, dad.end(), genome.vecWeights.begin() + cp);
+
+		for (; mutation < end; ++mutation) {
+			const uint32_t weight = load(mutationIndex, mutation);
+			if (weight >= weights)
+				return false;
+			double delta;
+			memcpy(&delta, mutationDelta + mutation * sizeof(delta), sizeof(delta));
+			genome.vecWeights[weight] += delta;
+		}
+
+	}
+
+	m_vecPopulation.swap(m_vecNext);
+	m_iCurrent = index;
+	return true;
+}
@@ -0,0 +1,97 @@
+// CGenomeHistory.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Compact archive of every generation's population. Consecutive populations
+// are highly redundant - elite genomes are copied, and the rest is spliced
+// from two parents with a few weights mutated. So most generations are
+// stored as deltas: parents of every genome, the crossover point and the
+// sparse list of mutations. Every n-th generation is stored as a keyframe
+// with all weights, so any generation can be decoded quickly.
+
+#ifndef SMARTSWEEPERSQT_CGENOMEHISTORY_H_
+#define SMARTSWEEPERSQT_CGENOMEHISTORY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "CGenAlg.h"
+
+using std::vector;
+
+
+enum GenomeHistoryRecordType {
+	GenomeHistoryKey = 1,
+	GenomeHistoryDelta,
+};
+
+// The file header (see SExportHeader) is followed by generation records. The
+// keyframe payload holds the fitness of every genome, then its weights. The
+// delta payload holds the fitness, the first parent, the second parent, the
+// crossover point and the end of the genome's mutations (the index into the
+// mutations list) of every genome, then mutated weight indexes and deltas.
+// Parents refer to the population of the previous record. Fitness, weights
+// and deltas are float64, the rest is uint32, in the native byte order.
+struct SGenomeHistoryRecord {
+	uint32_t type;
+	int32_t generation;
+	uint32_t genomes;
+	uint32_t weights;
+	uint32_t mutations;
+	uint32_t reserved;
+	// size of the payload following this record
+	uint64_t size;
+};
+
+// Append the population encoded as the keyframe to the buffer.
+void GenomeHistoryEncodeKey(int generation, const vector<SGenome> &population,
+		vector<unsigned char> &buffer);
+
+// Append the population encoded as the delta from the previous one to the
+// buffer. The lineage has to describe every genome of the population.
+void GenomeHistoryEncodeDelta(int generation, const vector<SGenome> &population,
+		const SGenomeLineage &lineage, vector<unsigned char> &buffer);
+
+
+class CGenomeHistoryReader {
+
+public:
+
+	CGenomeHistoryReader();
+
+	// Parse the archive, returns false if it is not valid. The memory has to
+	// stay valid as long as the reader is used.
+	bool Open(const unsigned char *data, uint64_t size);
+
+	int Records() const { return m_vecRecords.size(); }
+	const SGenomeHistoryRecord &Record(int index) const { return m_vecRecords[index]; }
+	// index of the record of the given generation, -1 if there is none
+	int Find(int generation) const;
+
+	// Reconstruct the population of the given record. Decoding starts at the
+	// nearest keyframe, unless it can continue from the last decoded record.
+	// Returns false if the record is not consistent with its predecessors.
+	bool Population(int index, vector<SGenome> &population);
+
+private:
+
+	bool DecodeKey(int index);
+	bool DecodeDelta(int index);
+
+	const unsigned char *m_pData;
+	vector<SGenomeHistoryRecord> m_vecRecords;
+	vector<uint64_t> m_vecOffsets;
+
+	// the last decoded record and its population (and the buffer for the
+	// next one, so storage is reused)
+	int m_iCurrent;
+	vector<SGenome> m_vecPopulation;
+	vector<SGenome> m_vecNext;
+
+};
+
+#endif
@@ -0,0 +1,258 @@
+// CHallOfFame.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CHallOfFame.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "CNeuralNet.h"
+
+
+// format version, increment upon any incompatible change
+static const uint32_t hallOfFameVersion = 1;
+
+
+CHallOfFame::CHallOfFame(int capacity) :
+		m_iCapacity(std::max(0, capacity)) {
+}
+
+void CHallOfFame::SetCapacity(int capacity) {
+	m_iCapacity = std::max(0, capacity);
+	for (auto i = m_vecTopologies.begin(); i != m_vecTopologies.end(); ++i)
+		if ((int)i->vecChampions.size() > m_iCapacity)
+			i->vecChampions.resize(m_iCapacity);
+}
+
+// The whole file is read at once - it holds a few champions per topology,
+// so it is small. Every record is checked against the remaining size.
+bool CHallOfFame::Load(const std::string &path) {
+
+	m_vecTopologies.clear();
+
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+		return true;
+
+	vector<unsigned char> data;
+	unsigned char buffer[64 * 1024];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + size);
+	const bool error = ferror(file) != 0;
+	fclose(file);
+
+	const unsigned char *p = data.data();
+	const unsigned char *end = p + data.size();
+
+	SHallOfFameHeader header;
+	if (error || (size_t)(end - p) < sizeof(header))
+		return false;
+	memcpy(&header, p, sizeof(header));
+	p += sizeof(header);
+	if (memcmp(header.magic, "SSHF", 4) != 0 || header.version != hallOfFameVersion)
+		return false;
+
+	for (uint32_t i = 0; i < header.topologies; ++i) {
+
+		int32_t record[6];
+		if ((size_t)(end - p) < sizeof(record))
+			break;
+		memcpy(record, p, sizeof(record));
+		p += sizeof(record);
+
+		SSimulationConfig config;
+		config.iNumInputs = record[0];
+		config.iNumHiddenLayers = record[1];
+		config.iNeuronsPerHiddenLayer = record[2];
+		config.iNumOutputs = record[3];
+		const int32_t champions = record[4];
+		const int32_t weights = record[5];
+		if (config.iNumInputs <= 0 || config.iNumHiddenLayers < 0 ||
+				config.iNeuronsPerHiddenLayer < 0 || config.iNumOutputs <= 0 ||
+				champions < 0 || weights != CNeuralNet::NumberOfWeights(config) ||
+				(uint64_t)(end - p) < (uint64_t)champions * (weights + 1) * sizeof(double))
+			break;
+
+		STopology &topology = Insert(config);
+		topology.vecChampions.resize(champions);
+		for (auto j = topology.vecChampions.begin(); j != topology.vecChampions.end(); ++j) {
+			memcpy(&j->dFitness, p, sizeof(double));
+			p += sizeof(double);
+			j->vecWeights.resize(weights);
+			memcpy(j->vecWeights.data(), p, weights * sizeof(double));
+			p += weights * sizeof(double);
+			j->iHash = Hash(j->vecWeights);
+		}
+
+		if ((int)topology.vecChampions.size() > m_iCapacity)
+			topology.vecChampions.resize(m_iCapacity);
+
+	}
+
+	if (p != end) {
+		m_vecTopologies.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void CHallOfFame::Store(vector<unsigned char> &image) const {
+
+	SHallOfFameHeader header;
+	memcpy(header.magic, "SSHF", 4);
+	header.version = hallOfFameVersion;
+	header.topologies = 0;
+	header.reserved = 0;
+	for (auto i = m_vecTopologies.begin(); i != m_vecTopologies.end(); ++i)
+		if (!i->vecChampions.empty())
+			++header.topologies;
+
+	image.resize(sizeof(header));
+	memcpy(image.data(), &header, sizeof(header));
+
+	auto append = [&image](const void *data, size_t size) {
+		const unsigned char *bytes = static_cast<const unsigned char *>(data);
+		image.insert(image.end(), bytes, bytes + size);
+	};
+
+	for (auto i = m_vecTopologies.begin(); i != m_vecTopologies.end(); ++i) {
+		if (i->vecChampions.empty())
+			continue;
+		const int32_t weights = i->vecChampions[0].vecWeights.size();
+		const int32_t record[6] = { i->iNumInputs, i->iNumHiddenLayers,
+			i->iNeuronsPerHiddenLayer, i->iNumOutputs, (int32_t)i->vecChampions.size(), weights };
+		append(record, sizeof(record));
+		for (auto j = i->vecChampions.begin(); j != i->vecChampions.end(); ++j) {
+			append(&j->dFitness, sizeof(double));
+			append(j->vecWeights.data(), weights * sizeof(double));
+		}
+	}
+
+}
+
+// Only genomes fitter than the least fit champion are considered, so after
+// the library has been filled up, the offer is a single pass over fitness
+// values. Genomes which have not collected anything never enter.
+bool CHallOfFame::Offer(const SSimulationConfig &config, const vector<SGenome> &population) {
+
+	if (m_iCapacity == 0 || population.empty() ||
+			(int)population[0].vecWeights.size() != CNeuralNet::NumberOfWeights(config))
+		return false;
+
+	const STopology *existing = Find(config);
+	double threshold = 0;
+	if (existing && (int)existing->vecChampions.size() == m_iCapacity)
+		threshold = std::max(threshold, existing->vecChampions.back().dFitness);
+
+	m_vecCandidates.clear();
+	for (unsigned int i = 0; i < population.size(); ++i)
+		if (population[i].dFitness > threshold)
+			m_vecCandidates.push_back(i);
+	if (m_vecCandidates.empty())
+		return false;
+
+	// the fittest first, ties are resolved by the position in the population
+	auto fitter = [&population](int a, int b) {
+		if (population[a].dFitness != population[b].dFitness)
+			return population[a].dFitness > population[b].dFitness;
+		return a < b;
+	};
+	if ((int)m_vecCandidates.size() > m_iCapacity) {
+		std::nth_element(m_vecCandidates.begin(), m_vecCandidates.begin() + m_iCapacity,
+				m_vecCandidates.end(), fitter);
+		m_vecCandidates.resize(m_iCapacity);
+	}
+	std::sort(m_vecCandidates.begin(), m_vecCandidates.end(), fitter);
+
+	vector<SChampion> &champions = Insert(config).vecChampions;
+	bool changed = false;
+
+	for (auto i = m_vecCandidates.begin(); i != m_vecCandidates.end(); ++i) {
+
+		const SGenome &genome = population[*i];
+		const uint64_t hash = Hash(genome.vecWeights);
+
+		// the same genome might have been more lucky this time
+		auto duplicate = std::find_if(champions.begin(), champions.end(),
+				[&](const SChampion &champion) {
+			return champion.iHash == hash && champion.vecWeights == genome.vecWeights;
+		});
+		if (duplicate != champions.end()) {
+			if (duplicate->dFitness >= genome.dFitness)
+				continue;
+			champions.erase(duplicate);
+		}
+
+		auto position = std::upper_bound(champions.begin(), champions.end(), genome.dFitness,
+				[](double fitness, const SChampion &champion) { return fitness > champion.dFitness; });
+		if (position - champions.begin() >= m_iCapacity)
+			continue;
+
+		SChampion champion;
+		champion.dFitness = genome.dFitness;
+		champion.iHash = hash;
+		champion.vecWeights = genome.vecWeights;
+		champions.insert(position, std::move(champion));
+		if ((int)champions.size() > m_iCapacity)
+			champions.pop_back();
+		changed = true;
+
+	}
+
+	return changed;
+}
+
+int CHallOfFame::Champions(const SSimulationConfig &config) const {
+	const STopology *topology = Find(config);
+	return topology ? topology->vecChampions.size() : 0;
+}
+
+const vector<double> &CHallOfFame::Weights(const SSimulationConfig &config, int index) const {
+	return Find(config)->vecChampions[index].vecWeights;
+}
+
+double CHallOfFame::Fitness(const SSimulationConfig &config, int index) const {
+	return Find(config)->vecChampions[index].dFitness;
+}
+
+const CHallOfFame::STopology *CHallOfFame::Find(const SSimulationConfig &config) const {
+	for (auto i = m_vecTopologies.begin(); i != m_vecTopologies.end(); ++i)
+		if (i->iNumInputs == config.iNumInputs &&
+				i->iNumHiddenLayers == config.iNumHiddenLayers &&
+				i->iNeuronsPerHiddenLayer == config.iNeuronsPerHiddenLayer &&
+				i->iNumOutputs == config.iNumOutputs)
+			return &*i;
+	return nullptr;
+}
+
+CHallOfFame::STopology &CHallOfFame::Insert(const SSimulationConfig &config) {
+
+	if (const STopology *topology = Find(config))
+		return const_cast<STopology &>(*topology);
+
+	STopology topology;
+	topology.iNumInputs = config.iNumInputs;
+	topology.iNumHiddenLayers = config.iNumHiddenLayers;
+	topology.iNeuronsPerHiddenLayer = config.iNeuronsPerHiddenLayer;
+	topology.iNumOutputs = config.iNumOutputs;
+	m_vecTopologies.push_back(topology);
+	return m_vecTopologies.back();
+}
+
+// FNV-1a of the weights representation, used for the quick rejection of
+// genomes which are different from champions
+uint64_t CHallOfFame::Hash(const vector<double> &weights) {
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(weights.data());
+	const unsigned char *end = p + weights.size() * sizeof(double);
+	uint64_t hash = 14695981039346656037ULL;
+	for (; p != end; ++p)
+		hash = (hash ^ *p) * 1099511628211ULL;
+	return hash;
+}
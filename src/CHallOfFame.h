@@ -0,0 +1,102 @@
+// CHallOfFame.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Library of the fittest genomes (champions) collected across runs. Genomes
+// are interchangeable only between brains of the same NN topology, so the
+// library keeps a separate list of champions for every topology. A new run
+// can take part of its initial population from these champions instead of
+// evolving the basic behavior from scratch again.
+
+#ifndef SMARTSWEEPERSQT_CHALLOFFAME_H_
+#define SMARTSWEEPERSQT_CHALLOFFAME_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CGenAlg.h"
+#include "SSimulationConfig.h"
+
+using std::vector;
+
+
+// The file header is followed by topology records: the topology (number of
+// inputs, hidden layers, neurons per hidden layer and outputs), the number
+// of champions and the number of weights (all int32), then the fitness and
+// weights of every champion (float64), the fittest one first. All values are
+// stored in the native byte order.
+struct SHallOfFameHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t topologies;
+	uint32_t reserved;
+};
+
+
+class CHallOfFame {
+
+public:
+
+	explicit CHallOfFame(int capacity = 20);
+
+	// maximal number of champions kept for every topology, the least fit
+	// ones are dropped when the capacity is reduced
+	void SetCapacity(int capacity);
+	int Capacity() const { return m_iCapacity; }
+
+	void Clear() { m_vecTopologies.clear(); }
+
+	// Replace the content with the one read from the file. Missing file is
+	// the same as the empty one, false is returned if the file is not valid
+	// (the library is empty then).
+	bool Load(const std::string &path);
+	// serialize the library into the given buffer (see the file format)
+	void Store(vector<unsigned char> &image) const;
+
+	// Offer genomes of the evaluated generation run with the given config.
+	// Genomes fitter than the least fit champion enter the library, unless
+	// the very same genome is already there (elite genomes are carried over
+	// unchanged). Returns true if the library has been changed.
+	bool Offer(const SSimulationConfig &config, const vector<SGenome> &population);
+
+	// number of champions for the topology of the given config, and their
+	// weights (the fittest champion first)
+	int Champions(const SSimulationConfig &config) const;
+	const vector<double> &Weights(const SSimulationConfig &config, int index) const;
+	double Fitness(const SSimulationConfig &config, int index) const;
+
+private:
+
+	struct SChampion {
+		double dFitness;
+		uint64_t iHash;
+		vector<double> vecWeights;
+	};
+
+	struct STopology {
+		int32_t iNumInputs;
+		int32_t iNumHiddenLayers;
+		int32_t iNeuronsPerHiddenLayer;
+		int32_t iNumOutputs;
+		vector<SChampion> vecChampions;
+	};
+
+	const STopology *Find(const SSimulationConfig &config) const;
+	STopology &Insert(const SSimulationConfig &config);
+
+	static uint64_t Hash(const vector<double> &weights);
+
+	int m_iCapacity;
+	vector<STopology> m_vecTopologies;
+
+	// candidates of the last offer (reused between offers)
+	vector<int> m_vecCandidates;
+
+};
+
+#endif
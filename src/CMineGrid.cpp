@@ -0,0 +1,139 @@
+// CMineGrid.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CMineGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+CMineGrid::CMineGrid() :
+		m_dCellSize(1),
+		m_iColumns(1),
+		m_iRows(1),
+		m_dRadius(0),
+		m_vecCellStart(2, 0) {
+}
+
+// Mines are distributed among cells with the counting sort, so the build is
+// linear in the number of mines and cells.
+void CMineGrid::Build(const vector<SVector2D> &mines, double width, double height, double radius) {
+
+	m_dRadius = radius;
+
+	// about one mine per cell, but cells can not be smaller than the mine
+	// and there is no point in having more than a few million of them
+	double area = std::max(width * height, 1.0);
+	m_dCellSize = std::sqrt(area / std::max<size_t>(mines.size(), 1));
+	m_dCellSize = std::max(m_dCellSize, 2 * radius);
+	m_dCellSize = std::max(m_dCellSize, std::sqrt(area / (1 << 22)));
+
+	m_iColumns = std::max(1, (int)std::ceil(width / m_dCellSize));
+	m_iRows = std::max(1, (int)std::ceil(height / m_dCellSize));
+
+	auto cellRange = [this](double value, int cells, int &first, int &last) {
+		first = std::min(std::max((int)((value - m_dRadius) / m_dCellSize), 0), cells - 1);
+		last = std::min(std::max((int)((value + m_dRadius) / m_dCellSize), 0), cells - 1);
+	};
+
+	// count mines in every cell (shifted by one for the prefix sum)
+	m_vecCellStart.assign(m_iColumns * m_iRows + 1, 0);
+	for (auto i = mines.begin(); i != mines.end(); ++i) {
+		int x1, x2, y1, y2;
+		cellRange(i->x, m_iColumns, x1, x2);
+		cellRange(i->y, m_iRows, y1, y2);
+		for (int y = y1; y <= y2; ++y)
+			for (int x = x1; x <= x2; ++x)
+				++m_vecCellStart[y * m_iColumns + x + 1];
+	}
+
+	for (unsigned int i = 1; i < m_vecCellStart.size(); ++i)
+		m_vecCellStart[i] += m_vecCellStart[i - 1];
+
+	// scatter mines into their cells
+	vector<int> fill(m_vecCellStart.begin(), m_vecCellStart.end() - 1);
+	m_vecCellMines.resize(m_vecCellStart.back());
+	for (auto i = mines.begin(); i != mines.end(); ++i) {
+		int x1, x2, y1, y2;
+		cellRange(i->x, m_iColumns, x1, x2);
+		cellRange(i->y, m_iRows, y1, y2);
+		for (int y = y1; y <= y2; ++y)
+			for (int x = x1; x <= x2; ++x)
+				m_vecCellMines[fill[y * m_iColumns + x]++] = *i;
+	}
+
+}
+
+// Amanatides-Woo traversal. Cells are visited in the order of the ray, so
+// the traversal stops as soon as the closest hit lies within the current
+// cell, or the ray leaves the range or the grid.
+double CMineGrid::CastRay(SVector2D origin, SVector2D direction, double range) const {
+
+	const double inf = std::numeric_limits<double>::infinity();
+	const double radius2 = m_dRadius * m_dRadius;
+
+	int x = std::min(std::max((int)(origin.x / m_dCellSize), 0), m_iColumns - 1);
+	int y = std::min(std::max((int)(origin.y / m_dCellSize), 0), m_iRows - 1);
+
+	const int stepX = direction.x > 0 ? 1 : -1;
+	const int stepY = direction.y > 0 ? 1 : -1;
+
+	// ray distance between vertical and horizontal cell boundaries
+	const double deltaX = direction.x != 0 ? m_dCellSize / std::fabs(direction.x) : inf;
+	const double deltaY = direction.y != 0 ? m_dCellSize / std::fabs(direction.y) : inf;
+
+	// ray distance to the first vertical and horizontal cell boundary
+	double maxX = direction.x != 0 ?
+		((x + (stepX > 0)) * m_dCellSize - origin.x) / direction.x : inf;
+	double maxY = direction.y != 0 ?
+		((y + (stepY > 0)) * m_dCellSize - origin.y) / direction.y : inf;
+
+	double closest = range;
+
+	for (;;) {
+
+		const int cell = y * m_iColumns + x;
+		for (int i = m_vecCellStart[cell]; i < m_vecCellStart[cell + 1]; ++i) {
+
+			SVector2D toMine = m_vecCellMines[i] - origin;
+			double c = toMine.x * toMine.x + toMine.y * toMine.y - radius2;
+
+			// the origin lies within the mine
+			if (c <= 0)
+				return 0;
+
+			double b = toMine.x * direction.x + toMine.y * direction.y;
+			double discriminant = b * b - c;
+			if (b <= 0 || discriminant < 0)
+				continue;
+
+			double distance = b - std::sqrt(discriminant);
+			if (distance < closest)
+				closest = distance;
+
+		}
+
+		double exit = std::min(maxX, maxY);
+		if (closest <= exit || exit >= range)
+			break;
+
+		if (maxX < maxY) {
+			if ((x += stepX) < 0 || x >= m_iColumns)
+				break;
+			maxX += deltaX;
+		}
+		else {
+			if ((y += stepY) < 0 || y >= m_iRows)
+				break;
+			maxY += deltaY;
+		}
+
+	}
+
+	return closest;
+}
@@ -0,0 +1,54 @@
+// CMineGrid.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Uniform grid over the mine field used for answering ray queries. Every
+// mine is registered in all cells overlapped by its bounding box, and rays
+// are traversed cell by cell (DDA), so only mines close to the ray are
+// tested. The cell size follows the mines density, hence the cost of a ray
+// does not grow with the number of mines.
+
+#ifndef SMARTSWEEPERSQT_CMINEGRID_H_
+#define SMARTSWEEPERSQT_CMINEGRID_H_
+
+#include <vector>
+
+#include "SVector2D.h"
+
+using std::vector;
+
+
+class CMineGrid {
+
+public:
+
+	CMineGrid();
+
+	// rebuild the grid for the given mines and the world dimensions
+	void Build(const vector<SVector2D> &mines, double width, double height, double radius);
+
+	// Cast a ray from the origin in the given (normalized) direction. Returns
+	// the distance to the first mine hit or the range if there was no hit.
+	double CastRay(SVector2D origin, SVector2D direction, double range) const;
+
+private:
+
+	double m_dCellSize;
+	int m_iColumns;
+	int m_iRows;
+
+	// radius of the mine used for the ray intersection test
+	double m_dRadius;
+
+	// Mines positions sorted by cells. Mines of the cell i are stored in the
+	// range [m_vecCellStart[i], m_vecCellStart[i + 1]).
+	vector<int> m_vecCellStart;
+	vector<SVector2D> m_vecCellMines;
+
+};
+
+#endif
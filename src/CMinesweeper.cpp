@@ -8,40 +8,155 @@
 
 #include "CMinesweeper.h"
 
+#include <algorithm>
 #include <cmath>
 
-#include "MainWindow.h"
+#include "CProfiler.h"
 #include "utils.h"
 
 
-CMinesweeper::CMinesweeper(SVector2D position, double rotation) :
+CMinesweeper::CMinesweeper(const SSimulationConfig &config, SVector2D position, double rotation) :
+		m_ItsBrain(config),
 		m_vPosition(position),
 		m_dRotation(rotation),
+		m_dSpeed(0),
 		m_lTrack(0.16),
 		m_rTrack(0.16),
 		m_iFitness(0),
-		m_iClosestMine(0) {
+		m_iClosestMine(0),
+		m_bClosestMineValid(false),
+		m_dClosestMine(0),
+		m_dSecondClosestMine(0),
+		m_iClosestMineSearches(0),
+		m_iClosestMineCacheHits(0),
+		m_iControlCountdown(0),
+		m_iControlUpdates(0),
+		m_iKinematicUpdates(0) {
 
 }
 
+void CMinesweeper::Respawn(SVector2D position, double rotation) {
+	m_vPosition = position;
+	m_vLookAt = SVector2D();
+	m_dRotation = rotation;
+	m_lTrack = m_rTrack = 0.16;
+	m_iFitness = 0;
+	m_iClosestMine = 0;
+	m_bClosestMineValid = false;
+	m_iControlCountdown = 0;
+	m_iClosestMineSearches = m_iClosestMineCacheHits = 0;
+	m_iControlUpdates = m_iKinematicUpdates = 0;
+}
+
+void CMinesweeper::GetState(SMinesweeperState &state) const {
+	state.x = m_vPosition.x;
+	state.y = m_vPosition.y;
+	state.lookAtX = m_vLookAt.x;
+	state.lookAtY = m_vLookAt.y;
+	state.rotation = m_dRotation;
+	state.speed = m_dSpeed;
+	state.lTrack = m_lTrack;
+	state.rTrack = m_rTrack;
+	state.searchX = m_vSearchPosition.x;
+	state.searchY = m_vSearchPosition.y;
+	state.closestMineDistance = m_dClosestMine;
+	state.secondClosestMineDistance = m_dSecondClosestMine;
+	state.closestMineSearches = m_iClosestMineSearches;
+	state.closestMineCacheHits = m_iClosestMineCacheHits;
+	state.controlUpdates = m_iControlUpdates;
+	state.kinematicUpdates = m_iKinematicUpdates;
+	state.fitness = m_iFitness;
+	state.closestMine = m_iClosestMine;
+	state.closestMineValid = m_bClosestMineValid;
+	state.controlCountdown = m_iControlCountdown;
+}
+
+void CMinesweeper::SetState(const SMinesweeperState &state) {
+	m_vPosition = SVector2D(state.x, state.y);
+	m_vLookAt = SVector2D(state.lookAtX, state.lookAtY);
+	m_dRotation = state.rotation;
+	m_dSpeed = state.speed;
+	m_lTrack = state.lTrack;
+	m_rTrack = state.rTrack;
+	m_vSearchPosition = SVector2D(state.searchX, state.searchY);
+	m_dClosestMine = state.closestMineDistance;
+	m_dSecondClosestMine = state.secondClosestMineDistance;
+	m_iClosestMineSearches = state.closestMineSearches;
+	m_iClosestMineCacheHits = state.closestMineCacheHits;
+	m_iControlUpdates = state.controlUpdates;
+	m_iKinematicUpdates = state.kinematicUpdates;
+	m_iFitness = state.fitness;
+	m_iClosestMine = state.closestMine;
+	m_bClosestMineValid = state.closestMineValid != 0;
+	m_iControlCountdown = state.controlCountdown;
+}
+
 // First we take sensor readings and feed these into the sweepers brain.
 //
 // The inputs are:
 // - vector to the closest mine (x, y)
 // - the sweepers 'look at' vector (x, y)
+// - distances to the first mine hit by each ray sensor (optional)
 //
 // We receive two outputs from the brain.. lTrack & rTrack. So given a force
 // for each track we calculate the resultant rotation and acceleration and
 // apply to current velocity vector.
-bool CMinesweeper::Update(vector<SVector2D> &mines) {
+//
+// Sensors and the brain are updated every iControlInterval ticks only. In
+// between, the sweeper moves with the track forces held fixed. Optionally,
+// relocation of the tracked mine triggers an immediate brain update. The
+// closest mine is tracked on every tick, though, so the cache sees all
+// relocated mines and the collision is checked with the actual closest one.
+bool CMinesweeper::Update(vector<SVector2D> &mines, const vector<int> &relocated,
+		const CMineGrid &grid, const SSimulationConfig &config) {
+
+	bool control = m_iControlCountdown <= 0;
+
+	if (!control && config.bControlOnMineEvent)
+		control = std::find(relocated.begin(), relocated.end(), m_iClosestMine) != relocated.end();
+
+	SVector2D vClosestMine = GetClosestMineCached(mines, relocated);
+
+	if (control) {
+		if (!UpdateControl(vClosestMine, grid, config))
+			return false;
+		m_iControlCountdown = config.iControlInterval;
+		++m_iControlUpdates;
+	}
+	else
+		++m_iKinematicUpdates;
+
+	--m_iControlCountdown;
+
+	// calculate steering forces
+	double RotForce = m_lTrack - m_rTrack;
+
+	// clamp rotation
+	Clamp(RotForce, -config.dMaxTurnRate, config.dMaxTurnRate);
+
+	m_dRotation += RotForce;
+
+	m_dSpeed = (m_lTrack + m_rTrack);
+
+	// update Look At
+	m_vLookAt.x = -sin(m_dRotation);
+	m_vLookAt.y = cos(m_dRotation);
+
+	// update position
+	m_vPosition += m_vLookAt * m_dSpeed;
+
+	return true;
+}
+
+// Take sensor readings and feed them into the brain. Returns false if the
+// brain has not produced required outputs.
+bool CMinesweeper::UpdateControl(SVector2D vClosestMine, const CMineGrid &grid,
+		const SSimulationConfig &config) {
 
 	// this will store all the inputs for the NN
 	vector<double> inputs;
 
-	// get vector to closest mine
-	SVector2D vClosestMine = GetClosestMine(mines);
-
-	// normalize it
+	// normalize vector to closest mine
 	Vec2DNormalize(vClosestMine);
 
 	// add in vector to closest mine
@@ -52,60 +167,117 @@ bool CMinesweeper::Update(vector<SVector2D> &mines) {
 	inputs.push_back(m_vLookAt.x);
 	inputs.push_back(m_vLookAt.y);
 
+	// Add in ray sensor readings normalized to the range [0, 1], where 1
+	// means that there is no mine within the range. Rays are spread evenly
+	// across the field of view centered at the sweepers heading.
+	const int rays = config.iNumRays;
+	const double range = config.dRayRange;
+	for (int i = 0; i < rays; ++i) {
+		double angle = m_dRotation;
+		if (rays > 1)
+			angle += config.dRayFieldOfView * ((double)i / (rays - 1) - 0.5);
+		double distance = grid.CastRay(m_vPosition, SVector2D(-sin(angle), cos(angle)), range);
+		inputs.push_back(distance / range);
+	}
+
 	// update the brain and get feedback
-	vector<double> output = m_ItsBrain.Update(inputs);
+	vector<double> output = m_ItsBrain.Update(inputs, config);
 
 	// make sure there were no errors in calculating the output
-	if (output.size() < (unsigned)MainWindow::s.iNumOutputs)
+	if (output.size() < (unsigned)config.iNumOutputs)
 		return false;
 
 	// assign the outputs to the sweepers left & right tracks
 	m_lTrack = output[0];
 	m_rTrack = output[1];
 
-	// calculate steering forces
-	double RotForce = m_lTrack - m_rTrack;
+	return true;
+}
 
-	// clamp rotation
-	Clamp(RotForce, -MainWindow::s.dMaxTurnRate, MainWindow::s.dMaxTurnRate);
+// Returns the vector from the sweeper to the closest mine.
+SVector2D CMinesweeper::GetClosestMine(vector<SVector2D> &mines) {
 
-	m_dRotation += RotForce;
+	CProfileScope profile(ProfileClosestMine);
 
-	m_dSpeed = (m_lTrack + m_rTrack);
+	double closest_so_far = 99999;
+	SVector2D vClosestObject(0, 0);
 
-	// update Look At
-	m_vLookAt.x = -sin(m_dRotation);
-	m_vLookAt.y = cos(m_dRotation);
+	// cycle through mines to find closest
+	for (unsigned int i = 0; i < mines.size(); i++) {
+		double len_to_object = Vec2DLength(mines[i] - m_vPosition);
 
-	// update position
-	m_vPosition += m_vLookAt * m_dSpeed;
+		if (len_to_object < closest_so_far) {
+			closest_so_far	= len_to_object;
+			vClosestObject	= m_vPosition - mines[i];
+			m_iClosestMine = i;
+		}
+	}
 
-	return true;
+	return vClosestObject;
 }
 
-// Returns the vector from the sweeper to the closest mine.
-SVector2D CMinesweeper::GetClosestMine(vector<SVector2D> &mines) {
+// Returns the vector from the sweeper to the closest mine. The result is
+// exactly the same as the one returned by the GetClosestMine(), however the
+// full search is skipped if the cached mine is guaranteed to be the closest.
+SVector2D CMinesweeper::GetClosestMineCached(vector<SVector2D> &mines, const vector<int> &relocated) {
+
+	CProfileScope profile(ProfileClosestMine);
+
+	// relocated mines might have moved closer than our lower bound
+	if (m_bClosestMineValid)
+		for (auto i = relocated.begin(); i != relocated.end(); ++i) {
+			if (*i == m_iClosestMine) {
+				m_bClosestMineValid = false;
+				break;
+			}
+			double len_to_object = Vec2DLength(mines[*i] - m_vSearchPosition);
+			if (len_to_object < m_dSecondClosestMine)
+				m_dSecondClosestMine = len_to_object;
+		}
+
+	if (m_bClosestMineValid) {
+		// The distance to the cached mine is at most m_dClosestMine + moved,
+		// while the distance to any other mine is at least the lower bound
+		// minus moved. Small margin covers floating point rounding errors.
+		double moved = Vec2DLength(m_vPosition - m_vSearchPosition);
+		if (m_dClosestMine + 2 * moved + 1e-6 < m_dSecondClosestMine) {
+			++m_iClosestMineCacheHits;
+			return m_vPosition - mines[m_iClosestMine];
+		}
+	}
+
+	++m_iClosestMineSearches;
 
 	double closest_so_far = 99999;
+	double second_so_far = 99999;
 	SVector2D vClosestObject(0, 0);
 
-	// cycle through mines to find closest
+	// cycle through mines to find closest and the second closest
 	for (unsigned int i = 0; i < mines.size(); i++) {
 		double len_to_object = Vec2DLength(mines[i] - m_vPosition);
 
 		if (len_to_object < closest_so_far) {
+			second_so_far = closest_so_far;
 			closest_so_far	= len_to_object;
 			vClosestObject	= m_vPosition - mines[i];
 			m_iClosestMine = i;
 		}
+		else if (len_to_object < second_so_far)
+			second_so_far = len_to_object;
 	}
 
+	m_bClosestMineValid = closest_so_far < 99999;
+	m_vSearchPosition = m_vPosition;
+	m_dClosestMine = closest_so_far;
+	m_dSecondClosestMine = second_so_far;
+
 	return vClosestObject;
 }
 
 // This function checks for collision with its closest mine (calculated
 // earlier and stored in m_iClosestMine).
 int CMinesweeper::CheckForMine(vector<SVector2D> &mines, double size) {
+	CProfileScope profile(ProfileCheckForMine);
 	SVector2D DistToObject = m_vPosition - mines[m_iClosestMine];
 	if (Vec2DLength(DistToObject) < size + 5)
 		return m_iClosestMine;
@@ -12,34 +12,79 @@
 #ifndef SMARTSWEEPERSQT_CMINESWEEPER_H_
 #define SMARTSWEEPERSQT_CMINESWEEPER_H_
 
+#include <cstdint>
 #include <vector>
 
+#include "CMineGrid.h"
 #include "CNeuralNet.h"
+#include "SSimulationConfig.h"
 #include "SVector2D.h"
 
 using std::vector;
 
 
+// The whole sweeper state except the brain (weights are stored with the
+// genome), stored in checkpoints. The layout does not depend on the
+// compiler, so the array of states can be used in place.
+struct SMinesweeperState {
+	double x, y;
+	double lookAtX, lookAtY;
+	double rotation;
+	double speed;
+	double lTrack, rTrack;
+	double searchX, searchY;
+	double closestMineDistance;
+	double secondClosestMineDistance;
+	uint64_t closestMineSearches;
+	uint64_t closestMineCacheHits;
+	uint64_t controlUpdates;
+	uint64_t kinematicUpdates;
+	int32_t fitness;
+	int32_t closestMine;
+	int32_t closestMineValid;
+	int32_t controlCountdown;
+};
+
+
 class CMinesweeper {
 
 public:
 
-	CMinesweeper(SVector2D position, double rotation);
-	CMinesweeper(int x = 0, int y = 0, double rotation = 0) :
-			CMinesweeper(SVector2D(x, y), rotation) {  }
+	explicit CMinesweeper(const SSimulationConfig &config,
+			SVector2D position = SVector2D(), double rotation = 0);
 
-	// updates the ANN with information from the sweepers environment
-	bool Update(vector<SVector2D> &mines);
+	// updates the ANN with information from the sweepers environment,
+	// the relocated vector holds indexes of mines moved since last update,
+	// the grid is used by ray sensors (it has to be built for given mines)
+	bool Update(vector<SVector2D> &mines, const vector<int> &relocated,
+			const CMineGrid &grid, const SSimulationConfig &config);
+
+	// number of NN inputs required for the given number of ray sensors
+	static int NumberOfInputs(int rays) { return 4 + rays; }
 
 	// reset rotation and fitness
-	void Respawn() { m_dRotation = m_iFitness = 0; };
+	void Respawn() { m_dRotation = m_iFitness = m_iControlCountdown = 0; };
+
+	// reset the whole sweeper state (except the brain) including statistics
+	// and place it in the given position
+	void Respawn(SVector2D position, double rotation);
 
 	// returns a vector to the closest mine
 	SVector2D GetClosestMine(vector<SVector2D> &objects);
 
+	// the same as above, but the full search is performed only when the
+	// previously found mine might not be the closest one anymore
+	SVector2D GetClosestMineCached(vector<SVector2D> &objects, const vector<int> &relocated);
+
+	// force the full search upon the next closest mine query
+	void ResetClosestMineCache() { m_bClosestMineValid = false; }
+
 	// checks to see if the minesweeper has 'collected' a mine
 	int CheckForMine(vector<SVector2D> &mines, double size);
 
+	// index of the closest mine found by the last update
+	int ClosestMine() const { return m_iClosestMine; }
+
 	// warp the minesweeper position to fit into given viewport
 	void WarpWorld(int x, int y, int width, int height);
 
@@ -50,12 +95,31 @@ public:
 
 	int Fitness() const { return m_iFitness; }
 
-	void PutWeights(vector<double> &w) { m_ItsBrain.PutWeights(w); }
+	void PutWeights(const vector<double> &w) { m_ItsBrain.PutWeights(w); }
+
+	// change the topology of the brain (weights have to be put afterwards)
+	void Configure(const SSimulationConfig &config) { m_ItsBrain.Configure(config); }
 
 	int GetNumberOfWeights() const { return m_ItsBrain.GetNumberOfWeights(); }
 
+	void GetState(SMinesweeperState &state) const;
+	void SetState(const SMinesweeperState &state);
+
+	// closest mine cache statistics
+	unsigned long ClosestMineSearches() const { return m_iClosestMineSearches; }
+	unsigned long ClosestMineCacheHits() const { return m_iClosestMineCacheHits; }
+
+	// control rate statistics
+	unsigned long ControlUpdates() const { return m_iControlUpdates; }
+	unsigned long KinematicUpdates() const { return m_iKinematicUpdates; }
+
 private:
 
+	// updates sensors and the brain output, given the vector to the
+	// closest mine
+	bool UpdateControl(SVector2D vClosestMine, const CMineGrid &grid,
+			const SSimulationConfig &config);
+
 	// the minesweeper's neural net
 	CNeuralNet m_ItsBrain;
 
@@ -79,6 +143,24 @@ private:
 	// index position of closest mine
 	int m_iClosestMine;
 
+	// Closest mine cache. Upon the full search we store the sweeper position,
+	// the distance to the closest mine and the lower bound of the distance
+	// to any other mine. As long as the sweeper has not moved more than half
+	// of the difference between these two, the closest mine is the same.
+	bool m_bClosestMineValid;
+	SVector2D m_vSearchPosition;
+	double m_dClosestMine;
+	double m_dSecondClosestMine;
+
+	unsigned long m_iClosestMineSearches;
+	unsigned long m_iClosestMineCacheHits;
+
+	// ticks left until the next brain update
+	int m_iControlCountdown;
+
+	unsigned long m_iControlUpdates;
+	unsigned long m_iKinematicUpdates;
+
 };
 
 #endif
@@ -8,147 +8,147 @@
 
 #include "CNeuralNet.h"
 
+#include <algorithm>
 #include <cmath>
 
-#include "MainWindow.h"
-#include "utils.h"
+#include "CProfiler.h"
 
 
-// Create a layer of neurons of the required size.
-static vector<vector<double>> createNeuronLayer(int numNeurons, int numInputsPerNeuron) {
-	vector<vector<double>> layer(numNeurons);
-	for (unsigned int i = 0; i < layer.size(); ++i) {
-		// we need an additional weight for the bias hence the +1
-		vector<double> neuron(numInputsPerNeuron + 1);
-		for (unsigned int j = 0; j < neuron.size(); ++j)
-			// set up the weights with an initial random value
-			neuron[j] = RandomClamped();
-		layer[i] = neuron;
-	}
-	return layer;
+// Get the number of neurons and the number of inputs per neuron (without
+// the bias) of the given layer.
+static void layerShape(const SSimulationConfig &config, int layer, int &neurons, int &inputs) {
+	neurons = layer < config.iNumHiddenLayers ? config.iNeuronsPerHiddenLayer : config.iNumOutputs;
+	inputs = layer == 0 ? config.iNumInputs : config.iNeuronsPerHiddenLayer;
 }
 
-// Create an Artificial Neural Net.
-CNeuralNet::CNeuralNet() :
-		m_NumInputs(MainWindow::s.iNumInputs),
-		m_NumOutputs(MainWindow::s.iNumOutputs),
-		m_NumHiddenLayers(MainWindow::s.iNumHiddenLayers),
-		m_NeuronsPerHiddenLyr(MainWindow::s.iNeuronsPerHiddenLayer) {
+// Create an Artificial Neural Net. Weights are not randomized here, because
+// the brain is always initialized with a genome taken from the GA.
+CNeuralNet::CNeuralNet(const SSimulationConfig &config) {
+	Configure(config);
+}
 
-	// the weights are all initially set to random values -1 < w < 1
+void CNeuralNet::Configure(const SSimulationConfig &config) {
+	m_NumInputs = config.iNumInputs;
+	m_NumOutputs = config.iNumOutputs;
+	m_NumHiddenLayers = config.iNumHiddenLayers;
+	m_NeuronsPerHiddenLyr = config.iNeuronsPerHiddenLayer;
+	m_vecWeights.resize(NumberOfWeights(config));
+}
 
-	// create the layers of the network
-	if (m_NumHiddenLayers > 0) {
+int CNeuralNet::NumberOfWeights(const SSimulationConfig &config) {
+	int weights = 0;
+	for (int i = 0; i < config.iNumHiddenLayers + 1; ++i) {
+		int neurons, inputs;
+		layerShape(config, i, neurons, inputs);
+		// we need an additional weight for the bias hence the +1
+		weights += neurons * (inputs + 1);
+	}
+	return weights;
+}
 
-		// create first hidden layer
-		m_vecLayers.push_back(createNeuronLayer(m_NeuronsPerHiddenLyr, m_NumInputs));
+// Hidden layers are matched by their index, and the output layer is always
+// matched with the output layer. Within the layer, neurons and their inputs
+// are matched by their index as well.
+void CNeuralNet::ResizeWeights(const vector<double> &weights, const SSimulationConfig &from,
+		const SSimulationConfig &to, CRandom &random, vector<double> &result) {
+
+	// offsets of layers in the source weights block
+	vector<int> offsets(from.iNumHiddenLayers + 2, 0);
+	for (int i = 0; i < from.iNumHiddenLayers + 1; ++i) {
+		int neurons, inputs;
+		layerShape(from, i, neurons, inputs);
+		offsets[i + 1] = offsets[i] + neurons * (inputs + 1);
+	}
 
-		for (int i = 0; i < m_NumHiddenLayers - 1; ++i)
-			m_vecLayers.push_back(createNeuronLayer(m_NeuronsPerHiddenLyr, m_NeuronsPerHiddenLyr));
+	result.clear();
+	result.reserve(NumberOfWeights(to));
 
-		// create output layer
-		m_vecLayers.push_back(createNeuronLayer(m_NumOutputs, m_NeuronsPerHiddenLyr));
+	for (int i = 0; i < to.iNumHiddenLayers + 1; ++i) {
 
-	}
-	else {
-		// create output layer
-		m_vecLayers.push_back(createNeuronLayer(m_NumOutputs, m_NumInputs));
-	}
+		int neurons, inputs;
+		layerShape(to, i, neurons, inputs);
 
-}
+		int source = -1;
+		if (i == to.iNumHiddenLayers)
+			source = from.iNumHiddenLayers;
+		else if (i < from.iNumHiddenLayers)
+			source = i;
 
+		int sourceNeurons = 0, sourceInputs = 0;
+		if (source != -1)
+			layerShape(from, source, sourceNeurons, sourceInputs);
 
-// Return a vector containing the weights.
-vector<double> CNeuralNet::GetWeights() const {
+		for (int j = 0; j < neurons; ++j) {
 
-	vector<double> weights;
+			if (j >= sourceNeurons) {
+				// completely new neuron
+				for (int k = 0; k < inputs + 1; ++k)
+					result.push_back(random.RandomClamped());
+				continue;
+			}
 
-	// for each layer
-	for (int i = 0; i < m_NumHiddenLayers + 1; ++i)
-		// for each neuron
-		for (unsigned int j = 0; j < m_vecLayers[i].size(); ++j)
-			// for each weight
-			for (unsigned int k = 0; k < m_vecLayers[i][j].size(); ++k)
-				weights.push_back(m_vecLayers[i][j][k]);
+			const double *neuron = &weights[offsets[source] + j * (sourceInputs + 1)];
+			for (int k = 0; k < inputs; ++k)
+				result.push_back(k < sourceInputs ? neuron[k] : 0);
+			// the bias weight is always the last one
+			result.push_back(neuron[sourceInputs]);
+
+		}
+	}
 
-	return weights;
 }
 
 // Given a vector of doubles this function replaces the weights in the NN
 // with the new values.
-void CNeuralNet::PutWeights(vector<double> &weights) {
-
-	int cWeight = 0;
-
-	// for each layer
-	for (int i = 0; i < m_NumHiddenLayers + 1; ++i)
-		// for each neuron
-		for (unsigned int j = 0; j < m_vecLayers[i].size(); ++j)
-			// for each weight
-			for (unsigned int k = 0; k < m_vecLayers[i][j].size(); ++k)
-				m_vecLayers[i][j][k] = weights[cWeight++];
-
+void CNeuralNet::PutWeights(const vector<double> &weights) {
+	std::copy(weights.begin(), weights.begin() + m_vecWeights.size(), m_vecWeights.begin());
 }
 
-// Return the total number of weights needed for the net.
-int CNeuralNet::GetNumberOfWeights() const {
-
-	int weights = 0;
-
-	// for each layer
-	for (int i = 0; i < m_NumHiddenLayers + 1; ++i)
-		// for each neuron
-		for (unsigned int j = 0; j < m_vecLayers[i].size(); ++j)
-			// for each weight
-			for (unsigned int k = 0; k < m_vecLayers[i][j].size(); ++k)
-				weights++;
+// Given an input vector this function calculates the output vector.
+vector<double> CNeuralNet::Update(vector<double> &inputs, const SSimulationConfig &config) {
 
-	return weights;
-}
+	CProfileScope profile(ProfileNeuralNet);
 
-// Given an input vector this function calculates the output vector.
-vector<double> CNeuralNet::Update(vector<double> &inputs) {
+	const double bias = config.dBias;
+	const double response = config.dActivationResponse;
 
 	vector<double> outputs;
 
-	int cWeight = 0;
-
 	// first check that we have the correct amount of inputs
 	if (inputs.size() != (unsigned)m_NumInputs)
 		// just return an empty vector if incorrect
 		return outputs;
 
+	const double *weight = m_vecWeights.data();
+
 	// for each layer....
-	for (int i=0; i < m_NumHiddenLayers + 1; ++i) {
+	for (int i = 0; i < m_NumHiddenLayers + 1; ++i) {
 
-		if ( i > 0 )
+		if (i > 0)
 			inputs = outputs;
 
 		outputs.clear();
 
-		cWeight = 0;
+		int neurons = i < m_NumHiddenLayers ? m_NeuronsPerHiddenLyr : m_NumOutputs;
 
 		// For each neuron sum the (inputs * corresponding weights). Throw
 		// the total at our sigmoid function to get the output.
-		for (unsigned int j = 0; j < m_vecLayers[i].size(); ++j) {
+		for (int j = 0; j < neurons; ++j) {
 
-			auto numInputs = m_vecLayers[i][j].size();
 			double netinput = 0;
 
 			// for each weight
-			for (unsigned int k = 0; k < numInputs - 1; ++k)
+			for (unsigned int k = 0; k < inputs.size(); ++k)
 				// sum the weights x inputs
-				netinput += m_vecLayers[i][j][k] * inputs[cWeight++];
+				netinput += *weight++ * inputs[k];
 
 			// add in the bias
-			netinput += m_vecLayers[i][j].back() * MainWindow::s.dBias;
+			netinput += *weight++ * bias;
 
 			// We can store the outputs from each layer as we generate them.
 			// The combined activation is first filtered through the sigmoid
 			// function.
-			outputs.push_back(Sigmoid(netinput, MainWindow::s.dActivationResponse));
-
-			cWeight = 0;
+			outputs.push_back(Sigmoid(netinput, response));
 		}
 	}
 
@@ -14,6 +14,9 @@
 
 #include <vector>
 
+#include "SSimulationConfig.h"
+#include "utils.h"
+
 using std::vector;
 
 
@@ -22,19 +25,32 @@ class CNeuralNet {
 
 public:
 
-	CNeuralNet();
+	explicit CNeuralNet(const SSimulationConfig &config);
+
+	// change the topology, the storage is reused if possible
+	void Configure(const SSimulationConfig &config);
+
+	// returns the number of weights in the net of the given topology
+	static int NumberOfWeights(const SSimulationConfig &config);
+
+	// Carry weights over to the net of a different topology. Weights of the
+	// connections existing in both nets are copied and new inputs of the
+	// existing neurons are zero, so these neurons compute the same outputs.
+	// New neurons are initialized randomly.
+	static void ResizeWeights(const vector<double> &weights, const SSimulationConfig &from,
+			const SSimulationConfig &to, CRandom &random, vector<double> &result);
 
 	// gets the weights from the NN
-	vector<double> GetWeights() const;
+	vector<double> GetWeights() const { return m_vecWeights; }
 
 	// returns total number of weights in net
-	int GetNumberOfWeights() const;
+	int GetNumberOfWeights() const { return m_vecWeights.size(); }
 
 	// replaces the weights with new ones
-	void PutWeights(vector<double> &weights);
+	void PutWeights(const vector<double> &weights);
 
 	// calculates the outputs from a set of inputs
-	vector<double> Update(vector<double> &inputs);
+	vector<double> Update(vector<double> &inputs, const SSimulationConfig &config);
 
 	// sigmoid response curve
 	double Sigmoid(double activation, double response);
@@ -46,9 +62,10 @@ private:
 	int m_NumHiddenLayers;
 	int m_NeuronsPerHiddenLyr;
 
-	// Storage for each layer of neurons including the output layer. This
-	// vector should be read as follows: layers->neurons->input_weights
-	vector<vector<vector<double>>> m_vecLayers;
+	// Weights of all layers including the output layer, stored in a single
+	// block. It should be read as follows: layers->neurons->input_weights,
+	// where the last weight of every neuron is the bias weight.
+	vector<double> m_vecWeights;
 
 };
 
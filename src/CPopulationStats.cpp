@@ -0,0 +1,190 @@
+// CPopulationStats.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CPopulationStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "CQuantileSketch.h"
+#include "utils.h"
+
+
+// Number of genomes per chunk. It is fixed, so chunk boundaries (and with
+// them the order of merges and sketch compactions) do not depend on the
+// number of threads, and statistics are reproducible on any machine.
+static const int statsChunkGenomes = 256;
+
+// Partial statistics of a single chunk. Moments are merged with the Chan's
+// parallel algorithm, so the variance is not affected by the cancellation.
+struct SStatsChunk {
+
+	SStatsChunk() :
+			iCount(0), dMean(0), dM2(0),
+			dMin(0), dMax(0),
+			iWeights(0) {  }
+
+	void Add(double value) {
+		if (iCount == 0)
+			dMin = dMax = value;
+		dMin = std::min(dMin, value);
+		dMax = std::max(dMax, value);
+		++iCount;
+		double delta = value - dMean;
+		dMean += delta / iCount;
+		dM2 += delta * (value - dMean);
+		sketch.Add(value);
+	}
+
+	void Merge(const SStatsChunk &other) {
+
+		if (other.iCount == 0)
+			return;
+		if (iCount == 0) {
+			*this = other;
+			return;
+		}
+
+		dMin = std::min(dMin, other.dMin);
+		dMax = std::max(dMax, other.dMax);
+		double n = iCount + other.iCount;
+		double delta = other.dMean - dMean;
+		dMean += delta * other.iCount / n;
+		dM2 += other.dM2 + delta * delta * iCount * other.iCount / n;
+		iCount += other.iCount;
+		sketch.Merge(other.sketch);
+
+		MergeWeights(other);
+	}
+
+	// per-weight moments of sampled genomes
+	void AddWeights(const vector<double> &weights) {
+		if (vecMean.size() < weights.size()) {
+			vecMean.resize(weights.size());
+			vecM2.resize(weights.size());
+		}
+		++iWeights;
+		for (unsigned int i = 0; i < weights.size(); ++i) {
+			double delta = weights[i] - vecMean[i];
+			vecMean[i] += delta / iWeights;
+			vecM2[i] += delta * (weights[i] - vecMean[i]);
+		}
+	}
+
+	void MergeWeights(const SStatsChunk &other) {
+
+		if (other.iWeights == 0)
+			return;
+		if (iWeights == 0) {
+			iWeights = other.iWeights;
+			vecMean = other.vecMean;
+			vecM2 = other.vecM2;
+			return;
+		}
+
+		double n = iWeights + other.iWeights;
+		for (unsigned int i = 0; i < vecMean.size() && i < other.vecMean.size(); ++i) {
+			double delta = other.vecMean[i] - vecMean[i];
+			vecMean[i] += delta * other.iWeights / n;
+			vecM2[i] += other.vecM2[i] + delta * delta * iWeights * other.iWeights / n;
+		}
+		iWeights += other.iWeights;
+	}
+
+	int iCount;
+	double dMean;
+	double dM2;
+	double dMin;
+	double dMax;
+	CQuantileSketch sketch;
+
+	int iWeights;
+	vector<double> vecMean;
+	vector<double> vecM2;
+
+};
+
+
+CPopulationStats::CPopulationStats(int distanceSamples, int weightSamples) :
+		m_iDistanceSamples(distanceSamples),
+		m_iWeightSamples(weightSamples) {
+}
+
+void CPopulationStats::Compute(const vector<SGenome> &population, int generation,
+		CThreadPool &pool, SGenerationStats &stats) const {
+
+	auto start = std::chrono::steady_clock::now();
+
+	const int size = population.size();
+	const int grain = statsChunkGenomes;
+	vector<SStatsChunk> chunks((size + grain - 1) / grain);
+
+	// genomes used for the per-weight statistics are taken with the fixed
+	// stride, so every chunk knows its share of the sample
+	const int stride = std::max(1, (size + m_iWeightSamples - 1) / m_iWeightSamples);
+
+	pool.ParallelFor(0, size, grain, [&](int first, int last) {
+		// the range spans more chunks when the pool does not split it (e.g.
+		// with a single thread)
+		for (int i = first; i < last; ++i) {
+			SStatsChunk &chunk = chunks[i / grain];
+			chunk.Add(population[i].dFitness);
+			if (i % stride == 0)
+				chunk.AddWeights(population[i].vecWeights);
+		}
+	});
+
+	// chunks are merged in order, so the result does not depend on the
+	// thread which has processed a particular chunk
+	SStatsChunk total;
+	for (auto i = chunks.begin(); i != chunks.end(); ++i)
+		total.Merge(*i);
+
+	stats.iGeneration = generation;
+	stats.iPopulation = size;
+	stats.dBestFitness = total.dMax;
+	stats.dWorstFitness = total.dMin;
+	stats.dAverageFitness = total.dMean;
+	stats.dFitnessVariance = total.iCount ? total.dM2 / total.iCount : 0;
+	for (int i = 0; i < GenerationStatsNumPercentiles; ++i)
+		stats.dFitnessPercentiles[i] = total.sketch.Quantile(GenerationStatsPercentiles[i]);
+
+	stats.iWeightSamples = total.iWeights;
+	stats.vecWeightMean = total.vecMean;
+	stats.vecWeightVariance.resize(total.vecM2.size());
+	stats.dWeightDiversity = 0;
+	for (unsigned int i = 0; i < total.vecM2.size(); ++i) {
+		stats.vecWeightVariance[i] = total.vecM2[i] / total.iWeights;
+		stats.dWeightDiversity += sqrt(stats.vecWeightVariance[i]);
+	}
+	if (!total.vecM2.empty())
+		stats.dWeightDiversity /= total.vecM2.size();
+
+	// mean pairwise distance estimated from randomly chosen pairs
+	CRandom random(SplitSeed(generation, 0));
+	double distance = 0;
+	int pairs = size > 1 ? m_iDistanceSamples : 0;
+	for (int i = 0; i < pairs; ++i) {
+		int a = random.RandInt(0, size - 1);
+		int b = random.RandInt(0, size - 2);
+		if (b >= a)
+			++b;
+		const vector<double> &wa = population[a].vecWeights;
+		const vector<double> &wb = population[b].vecWeights;
+		double sum = 0;
+		for (unsigned int j = 0; j < wa.size() && j < wb.size(); ++j)
+			sum += (wa[j] - wb[j]) * (wa[j] - wb[j]);
+		distance += sqrt(sum);
+	}
+	stats.iDistanceSamples = pairs;
+	stats.dGenomeDistance = pairs ? distance / pairs : 0;
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	stats.dComputeTime = elapsed.count();
+
+}
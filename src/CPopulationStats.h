@@ -0,0 +1,89 @@
+// CPopulationStats.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Distribution and diversity statistics of the evaluated population. The
+// fitness distribution is gathered in a single pass, which is split into
+// chunks processed by the thread pool and merged afterwards. Genome-level
+// statistics are estimated from a bounded sample of genomes, so their cost
+// does not depend on the population size.
+
+#ifndef SMARTSWEEPERSQT_CPOPULATIONSTATS_H_
+#define SMARTSWEEPERSQT_CPOPULATIONSTATS_H_
+
+#include <vector>
+
+#include "CGenAlg.h"
+#include "CThreadPool.h"
+
+using std::vector;
+
+
+// fitness percentiles reported in the generation statistics
+const double GenerationStatsPercentiles[] = { 0.1, 0.25, 0.5, 0.75, 0.9 };
+const int GenerationStatsNumPercentiles = 5;
+
+struct SGenerationStats {
+
+	SGenerationStats() :
+			iGeneration(0),
+			iPopulation(0),
+			dBestFitness(0), dWorstFitness(0),
+			dAverageFitness(0), dFitnessVariance(0),
+			dFitnessPercentiles(),
+			dGenomeDistance(0), dWeightDiversity(0),
+			iDistanceSamples(0), iWeightSamples(0),
+			dComputeTime(0) {  }
+
+	int iGeneration;
+	int iPopulation;
+
+	double dBestFitness;
+	double dWorstFitness;
+	double dAverageFitness;
+	double dFitnessVariance;
+	double dFitnessPercentiles[GenerationStatsNumPercentiles];
+
+	// mean Euclidean distance between two genomes (estimated from sampled
+	// pairs), and the mean standard deviation of a single weight
+	double dGenomeDistance;
+	double dWeightDiversity;
+
+	// per-weight mean and variance
+	vector<double> vecWeightMean;
+	vector<double> vecWeightVariance;
+
+	int iDistanceSamples;
+	int iWeightSamples;
+
+	// time spent on computing these statistics (in seconds)
+	double dComputeTime;
+
+};
+
+
+class CPopulationStats {
+
+public:
+
+	// maximal number of sampled genome pairs and of genomes used for the
+	// per-weight statistics
+	CPopulationStats(int distanceSamples = 256, int weightSamples = 1024);
+
+	// The sample is chosen by the generator seeded with the generation, so
+	// the simulation random sequence is not affected.
+	void Compute(const vector<SGenome> &population, int generation,
+			CThreadPool &pool, SGenerationStats &stats) const;
+
+private:
+
+	int m_iDistanceSamples;
+	int m_iWeightSamples;
+
+};
+
+#endif
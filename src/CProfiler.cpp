@@ -0,0 +1,246 @@
+// CProfiler.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CProfiler.h"
+
+#include <cstdio>
+#include <mutex>
+
+
+// Phases called many times per tick are cheaper than reading the clock, so
+// only every 2^n-th call of such a phase is timed. Time of the phase is
+// extrapolated from timed calls.
+static const int profilerSampling[ProfilePhases] = { 0, 4, 4, 4, 0, 0 };
+
+// Accumulators of a single thread. Only the owning thread writes them, so
+// plain loads and stores are used instead of atomic additions. Values from
+// before the last reset are cleared by the owner upon the next write, until
+// then they are ignored by the capture.
+struct SProfileSlot {
+
+	SProfileSlot() : iEpoch(0), bExited(false) {
+		Clear(0);
+	}
+
+	void Clear(unsigned int epoch) {
+		for (int i = 0; i < ProfilePhases; ++i) {
+			iCalls[i].store(0, std::memory_order_relaxed);
+			iSamples[i].store(0, std::memory_order_relaxed);
+			iTime[i].store(0, std::memory_order_relaxed);
+		}
+		for (int i = 0; i < ProfileCounters; ++i)
+			iCounters[i].store(0, std::memory_order_relaxed);
+		iEpoch.store(epoch, std::memory_order_release);
+	}
+
+	static void Increase(std::atomic<int64_t> &value, int64_t delta) {
+		value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+	}
+
+	std::string sName;
+	std::atomic<int64_t> iCalls[ProfilePhases];
+	// number of timed calls and their total time
+	std::atomic<int64_t> iSamples[ProfilePhases];
+	std::atomic<int64_t> iTime[ProfilePhases];
+	std::atomic<int64_t> iCounters[ProfileCounters];
+	std::atomic<unsigned int> iEpoch;
+	std::atomic<bool> bExited;
+
+};
+
+// Slot of the thread is marked when the thread exits, so it can be dropped
+// upon the next reset. Until then its values are still reported.
+struct SProfileSlotHolder {
+	SProfileSlotHolder() : slot(nullptr) {  }
+	~SProfileSlotHolder() { if (slot) slot->bExited = true; }
+	SProfileSlot *slot;
+};
+
+static std::mutex profilerMutex;
+static vector<SProfileSlot *> profilerSlots;
+static std::chrono::steady_clock::time_point profilerStart = std::chrono::steady_clock::now();
+static std::atomic<unsigned int> profilerEpoch(0);
+static thread_local SProfileSlotHolder profilerThread;
+
+std::atomic<bool> CProfiler::s_bEnabled(false);
+
+
+SProfileReport SProfileReport::Since(const SProfileReport &previous) const {
+
+	if (dWallTime < previous.dWallTime || vecThreads.size() < previous.vecThreads.size())
+		return *this;
+
+	SProfileReport report(*this);
+	report.dWallTime -= previous.dWallTime;
+	for (int i = 0; i < ProfileCounters; ++i)
+		report.iCounters[i] -= previous.iCounters[i];
+	for (int i = 0; i < ProfilePhases; ++i) {
+		report.iCalls[i] -= previous.iCalls[i];
+		report.dTime[i] -= previous.dTime[i];
+	}
+	for (unsigned int i = 0; i < previous.vecThreads.size(); ++i)
+		for (int j = 0; j < ProfilePhases; ++j) {
+			report.vecThreads[i].iCalls[j] -= previous.vecThreads[i].iCalls[j];
+			report.vecThreads[i].dTime[j] -= previous.vecThreads[i].dTime[j];
+		}
+
+	return report;
+}
+
+
+void CProfiler::Reset() {
+
+	std::lock_guard<std::mutex> lock(profilerMutex);
+
+	vector<SProfileSlot *> alive;
+	for (auto i = profilerSlots.begin(); i != profilerSlots.end(); ++i) {
+		if ((*i)->bExited)
+			delete *i;
+		else
+			alive.push_back(*i);
+	}
+
+	profilerSlots.swap(alive);
+	profilerEpoch.fetch_add(1, std::memory_order_relaxed);
+	profilerStart = std::chrono::steady_clock::now();
+
+}
+
+void CProfiler::SetThreadName(const std::string &name) {
+	SProfileSlot *slot = Slot();
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	slot->sName = name;
+}
+
+void CProfiler::Count(int counter, int64_t count) {
+	if (Enabled())
+		SProfileSlot::Increase(Slot()->iCounters[counter], count);
+}
+
+bool CProfiler::Enter(int phase) {
+	SProfileSlot *slot = Slot();
+	const int64_t calls = slot->iCalls[phase].load(std::memory_order_relaxed);
+	slot->iCalls[phase].store(calls + 1, std::memory_order_relaxed);
+	return (calls & ((1 << profilerSampling[phase]) - 1)) == 0;
+}
+
+void CProfiler::Add(int phase, int64_t nanoseconds) {
+	SProfileSlot *slot = Slot();
+	SProfileSlot::Increase(slot->iSamples[phase], 1);
+	SProfileSlot::Increase(slot->iTime[phase], nanoseconds);
+}
+
+void CProfiler::Capture(SProfileReport &report) {
+
+	std::lock_guard<std::mutex> lock(profilerMutex);
+
+	std::chrono::duration<double> wall = std::chrono::steady_clock::now() - profilerStart;
+	const unsigned int epoch = profilerEpoch.load(std::memory_order_relaxed);
+	report = SProfileReport();
+	report.dWallTime = wall.count();
+	report.vecThreads.resize(profilerSlots.size());
+
+	for (unsigned int i = 0; i < profilerSlots.size(); ++i) {
+		const SProfileSlot *slot = profilerSlots[i];
+		SProfileThread &thread = report.vecThreads[i];
+		thread.sName = slot->sName;
+		if (slot->iEpoch.load(std::memory_order_acquire) != epoch)
+			continue;
+		for (int j = 0; j < ProfilePhases; ++j) {
+			const int64_t samples = slot->iSamples[j].load(std::memory_order_relaxed);
+			thread.iCalls[j] = slot->iCalls[j].load(std::memory_order_relaxed);
+			thread.dTime[j] = samples ? slot->iTime[j].load(std::memory_order_relaxed) * 1e-9 *
+					thread.iCalls[j] / samples : 0;
+			report.iCalls[j] += thread.iCalls[j];
+			report.dTime[j] += thread.dTime[j];
+		}
+		for (int j = 0; j < ProfileCounters; ++j)
+			report.iCounters[j] += slot->iCounters[j].load(std::memory_order_relaxed);
+	}
+
+}
+
+// Thread names are the only strings which may need escaping.
+static void jsonString(FILE *file, const std::string &value) {
+	fputc('"', file);
+	for (auto i = value.begin(); i != value.end(); ++i) {
+		if (*i == '"' || *i == '\\')
+			fputc('\\', file);
+		if ((unsigned char)*i >= 0x20)
+			fputc(*i, file);
+	}
+	fputc('"', file);
+}
+
+bool CProfiler::WriteJSON(const SProfileReport &report, const std::string &path) {
+
+	FILE *file = fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+
+	const double wall = report.dWallTime;
+	fprintf(file, "{\n  \"wall_time\": %.6f,\n  \"counters\": {", wall);
+	for (int i = 0; i < ProfileCounters; ++i)
+		fprintf(file, "%s\n    \"%s\": { \"count\": %lld, \"per_second\": %.3f }", i ? "," : "",
+				CounterName(i), (long long)report.iCounters[i], wall ? report.iCounters[i] / wall : 0);
+	fprintf(file, "\n  },\n  \"phases\": {");
+
+	for (int i = 0; i < ProfilePhases; ++i) {
+		fprintf(file, "%s\n    \"%s\": {\n", i ? "," : "", PhaseName(i));
+		fprintf(file, "      \"calls\": %lld,\n      \"time\": %.9f,\n      \"mean\": %.9f,\n      \"share\": %.6f,\n",
+				(long long)report.iCalls[i], report.dTime[i],
+				report.iCalls[i] ? report.dTime[i] / report.iCalls[i] : 0,
+				wall ? report.dTime[i] / wall : 0);
+		fprintf(file, "      \"threads\": [");
+		bool first = true;
+		for (auto j = report.vecThreads.begin(); j != report.vecThreads.end(); ++j) {
+			if (!j->iCalls[i])
+				continue;
+			fprintf(file, "%s\n        { \"thread\": ", first ? "" : ",");
+			jsonString(file, j->sName);
+			fprintf(file, ", \"calls\": %lld, \"time\": %.9f }", (long long)j->iCalls[i], j->dTime[i]);
+			first = false;
+		}
+		fprintf(file, "%s]\n    }", first ? "" : "\n      ");
+	}
+
+	fprintf(file, "\n  }\n}\n");
+	const bool error = ferror(file) != 0;
+	return fclose(file) == 0 && !error;
+}
+
+const char *CProfiler::PhaseName(int phase) {
+	static const char *names[ProfilePhases] = {
+		"tick", "neural_net", "closest_mine", "check_for_mine", "epoch", "scene" };
+	return names[phase];
+}
+
+const char *CProfiler::CounterName(int counter) {
+	static const char *names[ProfileCounters] = { "ticks", "generations", "frames" };
+	return names[counter];
+}
+
+// The slot is registered with the first use in the thread, and cleared
+// with the first use after the reset.
+SProfileSlot *CProfiler::Slot() {
+
+	SProfileSlot *slot = profilerThread.slot;
+	if (slot) {
+		const unsigned int epoch = profilerEpoch.load(std::memory_order_relaxed);
+		if (slot->iEpoch.load(std::memory_order_relaxed) != epoch)
+			slot->Clear(epoch);
+		return slot;
+	}
+
+	slot = new SProfileSlot;
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	slot->Clear(profilerEpoch.load(std::memory_order_relaxed));
+	slot->sName = "thread " + std::to_string(profilerSlots.size());
+	profilerSlots.push_back(slot);
+	profilerThread.slot = slot;
+	return slot;
+}
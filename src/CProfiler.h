@@ -0,0 +1,144 @@
+// CProfiler.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Process-wide profiler of the simulation phases. Scoped timers add the
+// time spent in the phase into the accumulator of the current thread, so
+// threads never contend. Accumulators are summed up only when the report
+// is captured. Phases called for every sweeper are sampled, so the clock
+// is not read more often than the measured code runs. The profiler is
+// always compiled in - when it is disabled, the scoped timer costs a single
+// relaxed load of the enabled flag.
+
+#ifndef SMARTSWEEPERSQT_CPROFILER_H_
+#define SMARTSWEEPERSQT_CPROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::vector;
+
+
+struct SProfileSlot;
+
+enum ProfilePhase {
+	// the whole simulation cycle
+	ProfileTick,
+	ProfileNeuralNet,
+	ProfileClosestMine,
+	ProfileCheckForMine,
+	ProfileEpoch,
+	// update of the rendered scene
+	ProfileScene,
+	ProfilePhases,
+};
+
+enum ProfileCounter {
+	ProfileTicks,
+	ProfileGenerations,
+	ProfileFrames,
+	ProfileCounters,
+};
+
+struct SProfileThread {
+	std::string sName;
+	// number of calls and the time spent (in seconds) in every phase
+	int64_t iCalls[ProfilePhases];
+	double dTime[ProfilePhases];
+};
+
+struct SProfileReport {
+
+	SProfileReport() :
+			dWallTime(0),
+			iCounters(),
+			iCalls(),
+			dTime() {  }
+
+	// time since the profiler has been reset (in seconds)
+	double dWallTime;
+
+	int64_t iCounters[ProfileCounters];
+	int64_t iCalls[ProfilePhases];
+	double dTime[ProfilePhases];
+
+	vector<SProfileThread> vecThreads;
+
+	// Activity between the given (earlier) report and this one. If the
+	// profiler has been reset in the meantime, this report is returned.
+	SProfileReport Since(const SProfileReport &previous) const;
+
+};
+
+
+class CProfiler {
+
+public:
+
+	// enabling the profiler does not reset accumulated values
+	static void Enable(bool enable) { s_bEnabled.store(enable, std::memory_order_relaxed); }
+	static bool Enabled() { return s_bEnabled.load(std::memory_order_relaxed); }
+
+	// Zero all accumulators, and forget threads which have exited.
+	static void Reset();
+
+	// name of the calling thread shown in reports
+	static void SetThreadName(const std::string &name);
+
+	static void Count(int counter, int64_t count = 1);
+	// count the call of the phase, returns true if the call shall be timed
+	static bool Enter(int phase);
+	static void Add(int phase, int64_t nanoseconds);
+
+	static void Capture(SProfileReport &report);
+	// write the report as JSON, returns false upon failure
+	static bool WriteJSON(const SProfileReport &report, const std::string &path);
+
+	static const char *PhaseName(int phase);
+	static const char *CounterName(int counter);
+
+private:
+
+	static SProfileSlot *Slot();
+
+	static std::atomic<bool> s_bEnabled;
+
+};
+
+
+// Measure the time till the end of the scope, if the profiler is enabled
+// and the call is sampled.
+class CProfileScope {
+
+public:
+
+	explicit CProfileScope(int phase) :
+			m_iPhase(CProfiler::Enabled() && CProfiler::Enter(phase) ? phase : -1) {
+		if (m_iPhase != -1)
+			m_Start = std::chrono::steady_clock::now();
+	}
+
+	~CProfileScope() {
+		if (m_iPhase != -1)
+			CProfiler::Add(m_iPhase, std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - m_Start).count());
+	}
+
+private:
+
+	int m_iPhase;
+	std::chrono::steady_clock::time_point m_Start;
+
+	CProfileScope(const CProfileScope &);
+	CProfileScope &operator=(const CProfileScope &);
+
+};
+
+#endif
@@ -0,0 +1,100 @@
+// CQuantileSketch.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CQuantileSketch.h"
+
+#include <algorithm>
+#include <utility>
+
+
+CQuantileSketch::CQuantileSketch(int k) :
+		m_iK(std::max(2, k)),
+		m_iCount(0),
+		m_vecLevels(1),
+		m_iCompactions(0) {
+	m_vecLevels[0].reserve(m_iK);
+}
+
+void CQuantileSketch::Add(double value) {
+	m_vecLevels[0].push_back(value);
+	++m_iCount;
+	if (m_vecLevels[0].size() >= m_iK)
+		Compact(0);
+}
+
+void CQuantileSketch::Merge(const CQuantileSketch &other) {
+
+	if (other.m_vecLevels.size() > m_vecLevels.size())
+		m_vecLevels.resize(other.m_vecLevels.size());
+
+	for (unsigned int i = 0; i < other.m_vecLevels.size(); ++i)
+		m_vecLevels[i].insert(m_vecLevels[i].end(),
+				other.m_vecLevels[i].begin(), other.m_vecLevels[i].end());
+	m_iCount += other.m_iCount;
+
+	// compaction might overfill the next level, hence the size check
+	for (unsigned int i = 0; i < m_vecLevels.size(); ++i)
+		if (m_vecLevels[i].size() >= m_iK)
+			Compact(i);
+
+}
+
+// Weighted rank query over all levels.
+double CQuantileSketch::Quantile(double q) const {
+
+	if (m_iCount == 0)
+		return 0;
+
+	vector<std::pair<double, uint64_t>> items;
+	uint64_t total = 0;
+	for (unsigned int i = 0; i < m_vecLevels.size(); ++i)
+		for (auto v = m_vecLevels[i].begin(); v != m_vecLevels[i].end(); ++v) {
+			items.push_back(std::make_pair(*v, (uint64_t)1 << i));
+			total += (uint64_t)1 << i;
+		}
+
+	std::sort(items.begin(), items.end());
+
+	const double rank = std::max(0.0, std::min(1.0, q)) * total;
+	uint64_t cumulative = 0;
+	for (auto i = items.begin(); i != items.end(); ++i) {
+		cumulative += i->second;
+		if (cumulative >= rank)
+			return i->first;
+	}
+
+	return items.back().first;
+}
+
+void CQuantileSketch::Compact(unsigned int level) {
+
+	if (level + 1 == m_vecLevels.size())
+		m_vecLevels.push_back(vector<double>());
+
+	vector<double> &values = m_vecLevels[level];
+	std::sort(values.begin(), values.end());
+
+	// with the odd number of values, the largest one stays in the level
+	double rest = 0;
+	const bool odd = values.size() % 2;
+	if (odd) {
+		rest = values.back();
+		values.pop_back();
+	}
+
+	vector<double> &next = m_vecLevels[level + 1];
+	for (unsigned int i = m_iCompactions++ % 2; i < values.size(); i += 2)
+		next.push_back(values[i]);
+
+	values.clear();
+	if (odd)
+		values.push_back(rest);
+
+	if (next.size() >= m_iK)
+		Compact(level + 1);
+
+}
@@ -0,0 +1,55 @@
+// CQuantileSketch.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Mergeable quantile sketch (KLL-like compactor hierarchy). Values are kept
+// in levels, where every value of the level h stands for 2^h inputs. When
+// a level is full, it is sorted and every other value is promoted to the
+// next level, so the memory is O(k log(n/k)) and the rank error is
+// O(log(n/k) / k). Up to k values are kept exactly.
+
+#ifndef SMARTSWEEPERSQT_CQUANTILESKETCH_H_
+#define SMARTSWEEPERSQT_CQUANTILESKETCH_H_
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+
+class CQuantileSketch {
+
+public:
+
+	explicit CQuantileSketch(int k = 128);
+
+	void Add(double value);
+
+	// merge the other sketch into this one
+	void Merge(const CQuantileSketch &other);
+
+	// value of the given quantile [0, 1], zero for the empty sketch
+	double Quantile(double q) const;
+
+	uint64_t Count() const { return m_iCount; }
+
+private:
+
+	void Compact(unsigned int level);
+
+	unsigned int m_iK;
+	uint64_t m_iCount;
+
+	vector<vector<double>> m_vecLevels;
+
+	// Compaction keeps odd or even values in turns, so the sketch is not
+	// biased in either way and it stays deterministic.
+	unsigned int m_iCompactions;
+
+};
+
+#endif
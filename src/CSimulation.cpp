@@ -0,0 +1,1092 @@
+// CSimulation.cpp
+// Copyright (c) 2014-2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#define _USE_MATH_DEFINES
+#include "CSimulation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "CProfiler.h"
+
+
+#ifndef M_PI
+// if you want something done, do it yourself...
+#define M_PI (4 * atan(1))
+#endif
+
+
+// Statistics of sweepers summed up by chunks processed in parallel.
+struct SSweeperTotals {
+
+	SSweeperTotals() : searches(0), cacheHits(0), controlUpdates(0), kinematicUpdates(0) {}
+
+	std::atomic<unsigned long> searches;
+	std::atomic<unsigned long> cacheHits;
+	std::atomic<unsigned long> controlUpdates;
+	std::atomic<unsigned long> kinematicUpdates;
+
+	void Store(SRenderSnapshot &snapshot) const {
+		snapshot.iClosestMineSearches = searches;
+		snapshot.iClosestMineCacheHits = cacheHits;
+		snapshot.iControlUpdates = controlUpdates;
+		snapshot.iKinematicUpdates = kinematicUpdates;
+	}
+
+};
+
+// Store the render state of sweepers [first, last) in the snapshot and add
+// their statistics to the totals. It is called for chunks which have just
+// been processed, so the sweepers state is still in the CPU cache.
+static void collectSweepers(const CMinesweeper *sweepers, int first, int last,
+		int threshold, SRenderSweeper *states, SSweeperTotals &totals) {
+
+	unsigned long searches = 0, cacheHits = 0;
+	unsigned long controlUpdates = 0, kinematicUpdates = 0;
+
+	for (int i = first; i < last; ++i) {
+		const CMinesweeper &sweeper = sweepers[i];
+		const SVector2D position = sweeper.Position();
+		states[i].x = position.x;
+		states[i].y = position.y;
+		states[i].rotation = sweeper.Rotation();
+		states[i].elite = sweeper.Fitness() >= threshold;
+		searches += sweeper.ClosestMineSearches();
+		cacheHits += sweeper.ClosestMineCacheHits();
+		controlUpdates += sweeper.ControlUpdates();
+		kinematicUpdates += sweeper.KinematicUpdates();
+	}
+
+	totals.searches += searches;
+	totals.cacheHits += cacheHits;
+	totals.controlUpdates += controlUpdates;
+	totals.kinematicUpdates += kinematicUpdates;
+
+}
+
+
+// Create an empty simulation. The population is not created until the
+// Reset() is called, so the engine can be constructed cheaply in any thread.
+CSimulation::CSimulation(const SSimulationConfig &config, int width, int height) :
+		m_Config(config),
+		m_bConfigPending(false),
+		m_iConfigVersion(1),
+		m_iEliteThreshold(0),
+		m_iEliteCount(0),
+		m_iRecordInterval(1),
+		m_dRecordingTime(0),
+		m_dRecordedTicksTime(0),
+		m_iRecordedTicks(0),
+		m_bLineageValid(false),
+		m_iCheckpointInterval(0),
+		m_dCheckpointTime(0),
+		m_iHallOfFameSeedShare(0),
+		m_iSeededGenomes(0),
+		m_bHallOfFameError(false),
+		m_dEpisodesPerSecond(0),
+		m_dStartupTime(0),
+		m_bStartupPending(false),
+		m_iWidth(width),
+		m_iHeight(height),
+		m_pGA(nullptr),
+		m_bInternalError(false),
+		m_iTicks(0),
+		m_iGenerations(0) {
+}
+
+CSimulation::~CSimulation() {
+	delete m_pGA;
+}
+
+// Limits are the widest ones allowed by the preferences and the C API, so
+// every configuration set by them is valid. NaN values fail comparisons.
+bool CSimulation::ValidConfig(const SSimulationConfig &config) {
+
+	auto within = [](double value, double min, double max) {
+		return value >= min && value <= max;
+	};
+
+	return within(config.iNumHiddenLayers, 0, 100) &&
+		within(config.iNeuronsPerHiddenLayer, 0, 10000) &&
+		within(config.iNumOutputs, 2, 10000) &&
+		within(config.dActivationResponse, 0, 1e6) &&
+		within(config.dBias, -1e6, 1e6) &&
+		within(config.dMaxTurnRate, 0, 1e6) &&
+		within(config.dMaxSpeed, 0, 1e6) &&
+		within(config.dSweeperScale, 0, 1e6) &&
+		within(config.dMineScale, 0, 1e6) &&
+		within(config.iNumSweepers, 0, 1000000) &&
+		within(config.iNumMines, 0, 1000000) &&
+		within(config.iNumTicks, 1, 1000000000) &&
+		within(config.iControlInterval, 1, 1000000) &&
+		within(config.iNumRays, 0, 1000) &&
+		config.iNumInputs == CMinesweeper::NumberOfInputs(config.iNumRays) &&
+		within(config.dRayRange, 0, 1e6) &&
+		within(config.dRayFieldOfView, 0, 2 * M_PI) &&
+		within(config.dCrossoverRate, 0, 1e6) &&
+		within(config.dMutationRate, 0, 1e6) &&
+		within(config.dMaxPerturbation, 0, 1e6) &&
+		within(config.iNumElite, 0, 1000000) &&
+		within(config.iNumCopiesElite, 0, 1000000) &&
+		(int64_t)config.iNumElite * config.iNumCopiesElite <= config.iNumSweepers &&
+		within(config.iNumEpisodes, 1, 10000) &&
+		within(config.iEpisodeStatistic, EpisodeStatisticMean, EpisodeStatisticMinimum);
+}
+
+// Mines outside of the new bounds are wrapped into the world, otherwise
+// they would be out of reach for good.
+void CSimulation::SetWorldSize(int width, int height) {
+
+	if (width == m_iWidth && height == m_iHeight)
+		return;
+
+	m_iWidth = width;
+	m_iHeight = height;
+	WrapMines();
+
+	// positions are recorded relative to the world size
+	if (m_Recorder.IsRecording())
+		m_Recorder.EndGeneration();
+
+}
+
+// Initialize the population of genomes, the sweepers with their brains and
+// the mines. Buffers of the previous run are reused. Genomes and sweepers
+// are initialized by the thread pool, each one with its own generator
+// derived from the seed, so the outcome does not depend on the number of
+// threads.
+void CSimulation::Reset(uint64_t seed) {
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (m_Recorder.IsRecording())
+		m_Recorder.EndGeneration();
+
+	// new run takes the whole pending configuration
+	ApplyConfig(true);
+
+	const int count = m_Config.iNumSweepers;
+
+	// brains are created without random weights, so this is cheap
+	const CMinesweeper prototype(m_Config);
+	const int weights = prototype.GetNumberOfWeights();
+
+	m_vecSweepers.resize(count, prototype);
+	m_vecThePopulation.resize(count);
+
+	delete m_pGA;
+	m_pGA = new CGenAlg(count, weights, m_Config);
+
+	m_Random.Seed(seed);
+	const uint64_t genomesSeed = m_Random.Next();
+	const uint64_t sweepersSeed = m_Random.Next();
+	m_pGA->Seed(m_Random.Next());
+
+	// The first genomes are replaced by champions, the fittest first. Random
+	// genomes are created anyway, so the rest of the population is the same
+	// as in the run which is not seeded.
+	const int seeded = std::min(m_HallOfFame.Champions(m_Config),
+			count * m_iHallOfFameSeedShare / 100);
+
+	m_Pool.ParallelFor(0, count, Grain(count), [&](int first, int last) {
+		m_pGA->CreateChromos(m_vecThePopulation, first, last, genomesSeed);
+		for (int i = first; i < last; ++i) {
+			if (i < seeded)
+				m_vecThePopulation[i].vecWeights = m_HallOfFame.Weights(m_Config, i);
+			CRandom random(SplitSeed(sweepersSeed, i));
+			// the assignment reuses the storage of the previous brain
+			m_vecSweepers[i] = prototype;
+			m_vecSweepers[i].Respawn(SVector2D(random.RandFloat() * m_iWidth,
+						random.RandFloat() * m_iHeight), random.RandFloat() * 2 * M_PI);
+			m_vecSweepers[i].PutWeights(m_vecThePopulation[i].vecWeights);
+		}
+	});
+
+	// initial population of mines
+	m_vecMines.clear();
+	SetNumMines(m_Config.iNumMines);
+
+	ResetEliteThreshold();
+
+	m_dEpisodesPerSecond = 0;
+	m_bInternalError = false;
+	m_iTicks = 0;
+	m_iGenerations = 0;
+	m_iSeededGenomes = seeded;
+	m_bLineageValid = false;
+	m_GenerationStats = SGenerationStats();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	m_dStartupTime = elapsed.count();
+	m_bStartupPending = true;
+
+}
+
+void CSimulation::SetConfig(const SSimulationConfig &config) {
+	m_PendingConfig = config;
+	m_bConfigPending = true;
+}
+
+// Apply the pending configuration. Within the run, the number of mines is
+// changed directly by the SetNumMines().
+void CSimulation::ApplyConfig(bool reset) {
+
+	if (!m_bConfigPending)
+		return;
+
+	SSimulationConfig config = m_PendingConfig;
+
+	if (!reset)
+		config.iNumMines = m_Config.iNumMines;
+
+	m_Config = config;
+	if (m_pGA)
+		m_pGA->SetConfig(m_Config);
+
+	m_bConfigPending = false;
+	++m_iConfigVersion;
+
+}
+
+// Set the number of threads used for processing sweepers. Value 0 selects
+// one thread per CPU. This function shall be called from the thread which
+// runs the simulation, because that thread becomes a part of the pool.
+void CSimulation::SetThreads(int threads, bool pin) {
+	if (threads <= 0)
+		threads = std::thread::hardware_concurrency();
+	m_Pool.Resize(threads, pin);
+}
+
+// Synchronize the number of mine objects with the given value.
+void CSimulation::SetNumMines(int number) {
+
+	m_Config.iNumMines = number;
+
+	// the number of mines is fixed within the recorded generation, so the
+	// recording of this one ends here
+	if (m_Recorder.IsRecording() && number != (int)m_vecMines.size())
+		m_Recorder.EndGeneration();
+
+	int diff = number - m_vecMines.size();
+
+	if (diff > 0) {
+		// initialize mines in random positions within the world
+		for (int i = diff; i; --i)
+			m_vecMines.push_back(SVector2D(m_Random.RandFloat() * m_iWidth,
+						m_Random.RandFloat() * m_iHeight));
+	}
+	else if (diff < 0)
+		m_vecMines.resize(number);
+
+	WrapMines();
+
+}
+
+// Wrap mines around the current world. The mines layout has changed, so
+// cached closest mines are not valid anymore.
+void CSimulation::WrapMines() {
+
+	for (auto i = m_vecMines.begin(); i < m_vecMines.end(); ++i) {
+		i->x = fmod(i->x, m_iWidth);
+		i->y = fmod(i->y, m_iHeight);
+	}
+
+	m_vecRelocatedMines.clear();
+	for (auto i = m_vecSweepers.begin(); i < m_vecSweepers.end(); ++i)
+		i->ResetClosestMineCache();
+
+}
+
+// Run a single simulation cycle. The first cycle after the reset is timed,
+// so together with the reset itself it gives the time-to-first-tick.
+bool CSimulation::Update(SRenderSnapshot *snapshot) {
+
+	CProfileScope profile(ProfileTick);
+	CProfiler::Count(ProfileTicks);
+
+	if (!m_bStartupPending)
+		return Cycle(snapshot);
+
+	auto start = std::chrono::steady_clock::now();
+	bool ok = Cycle(snapshot);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	m_dStartupTime += elapsed.count();
+	m_bStartupPending = false;
+
+	return ok;
+}
+
+// This is the main workhorse. The entire simulation is controlled from here.
+// The comments should explain what is going on adequately. If requested, the
+// render snapshot is filled in by the parallel loops over sweepers.
+bool CSimulation::Cycle(SRenderSnapshot *snapshot) {
+
+	if (m_bInternalError)
+		// something goes terribly wrong
+		return false;
+
+	// In the multi-episode mode the whole generation is evaluated at once,
+	// independently of the shared mine field.
+	if (m_Config.iNumEpisodes > 1) {
+		EvaluateEpisodes();
+		if (m_bInternalError)
+			return false;
+		Epoch(snapshot);
+		return true;
+	}
+
+	// Run the sweepers through iNumTicks amount of cycles. During this loop
+	// each sweepers NN is constantly updated with the appropriate information
+	// from its surroundings. The output from the NN is obtained and the sweeper
+	// is moved. If it encounters a mine its fitness is updated appropriately.
+	if (m_iTicks++ < m_Config.iNumTicks) {
+
+		if (m_iTicks == 1 && m_Recorder.IsOpen() && m_iGenerations % m_iRecordInterval == 0)
+			m_Recorder.BeginGeneration(m_iGenerations, m_vecSweepers.size(), m_vecMines.size(),
+					m_iWidth, m_iHeight, m_Config);
+
+		const bool recording = m_Recorder.IsRecording();
+		auto start = std::chrono::steady_clock::now();
+
+		// sweepers are reading the mines snapshot taken at the tick start
+		auto mines = m_vecMines;
+
+		// ray sensors of the whole population share a single grid, which
+		// is built once per tick
+		if (m_Config.iNumRays > 0)
+			m_Grid.Build(mines, m_iWidth, m_iHeight, m_Config.dMineScale);
+
+		// The tick is split into two phases. During the first one every
+		// sweeper is moved and its mine hit candidate is recorded - there is
+		// no shared state modified, so this phase can be run in parallel.
+		// The second phase resolves all hits in the sweepers order, hence
+		// the result is the same regardless of the number of threads used.
+		bool ok = UpdateSweepers(mines, snapshot);
+
+		if (!ok) {
+			// error in processing the neural net
+			m_bInternalError = true;
+			return false;
+		}
+
+		if (recording)
+			RecordFrame();
+
+		ResolveMineHits();
+
+		if (recording) {
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			m_dRecordedTicksTime += elapsed.count();
+			++m_iRecordedTicks;
+		}
+
+		if (snapshot)
+			FillSnapshotSummary(*snapshot);
+
+	}
+	// Another generation has been completed.
+	// Time to run the GA and update the sweepers with their new NNs
+	else
+		Epoch(snapshot);
+
+	return true;
+}
+
+// The first phase of the simulation tick. Update sweepers' NN and position,
+// and check whether they have found a mine. Every sweeper writes only to its
+// own state and hit slot, so chunks of sweepers are processed by the thread
+// pool without any synchronization. Returns false upon NN error.
+bool CSimulation::UpdateSweepers(vector<SVector2D> &mines, SRenderSnapshot *snapshot) {
+
+	m_vecMineHits.resize(m_vecSweepers.size());
+	CMinesweeper *sweepers = m_vecSweepers.data();
+	int *hits = m_vecMineHits.data();
+	const SSimulationConfig &config = m_Config;
+	const double mineScale = m_Config.dMineScale;
+	std::atomic<bool> error(false);
+
+	// elite classification is based on the fitness at the tick start
+	SRenderSweeper *states = nullptr;
+	SSweeperTotals totals;
+	int threshold = 0;
+	if (snapshot) {
+		snapshot->vecSweepers.resize(m_vecSweepers.size());
+		snapshot->iEliteThreshold = threshold = m_iEliteThreshold;
+		states = snapshot->vecSweepers.data();
+	}
+
+	m_Pool.ParallelFor(0, m_vecSweepers.size(), Grain(m_vecSweepers.size()),
+			[&](int first, int last) {
+		for (int i = first; i < last; ++i) {
+
+			// update the NN and position
+			if (!sweepers[i].Update(mines, m_vecRelocatedMines, m_Grid, config)) {
+				error = true;
+				return;
+			}
+
+			// keep minesweepers in our world
+			sweepers[i].WarpWorld(0, 0, m_iWidth, m_iHeight);
+
+			// see if it's found a mine
+			hits[i] = sweepers[i].CheckForMine(mines, mineScale);
+		}
+		if (states)
+			collectSweepers(sweepers, first, last, threshold, states, totals);
+	});
+
+	if (snapshot)
+		totals.Store(*snapshot);
+
+	return !error;
+}
+
+// The second phase of the simulation tick. Hits are resolved in the sweepers
+// order, so when more than one sweeper has found the same mine, the one with
+// the lowest index collects it.
+void CSimulation::ResolveMineHits() {
+
+	m_vecMineClaims.assign(m_vecMines.size(), 0);
+	m_vecRelocatedMines.clear();
+
+	for (unsigned int i = 0; i < m_vecSweepers.size(); ++i) {
+
+		int grabHit = m_vecMineHits[i];
+
+		if (grabHit != -1 && !m_vecMineClaims[grabHit]) {
+			m_vecMineClaims[grabHit] = 1;
+			// mine found so replace the mine with another at a random position
+			m_vecMines[grabHit] = SVector2D(m_Random.RandFloat() * m_iWidth,
+					m_Random.RandFloat() * m_iHeight);
+			m_vecRelocatedMines.push_back(grabHit);
+			if (m_Recorder.IsRecording())
+				m_Recorder.AddEvent(i, grabHit, m_vecMines[grabHit]);
+			// we have discovered a mine so increase fitness
+			IncrementFitness(i);
+		}
+
+		// update the chromos fitness score
+		m_vecThePopulation[i].dFitness = m_vecSweepers[i].Fitness();
+	}
+
+}
+
+// Record poses of sweepers after they have been moved. Poses are encoded by
+// the thread pool, and the file is written by the calling thread.
+void CSimulation::RecordFrame() {
+
+	auto start = std::chrono::steady_clock::now();
+
+	m_Recorder.BeginFrame(m_vecSweepers, m_vecMines);
+
+	const CMinesweeper *sweepers = m_vecSweepers.data();
+	m_Pool.ParallelFor(0, m_vecSweepers.size(), Grain(m_vecSweepers.size()),
+			[&](int first, int last) {
+		m_Recorder.EncodePoses(sweepers, first, last);
+	});
+
+	m_Recorder.EndFrame();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	m_dRecordingTime += elapsed.count();
+
+}
+
+bool CSimulation::StartRecording(const std::string &path, int interval) {
+
+	StopRecording();
+
+	m_iRecordInterval = std::max(1, interval);
+	m_dRecordingTime = 0;
+	m_dRecordedTicksTime = 0;
+	m_iRecordedTicks = 0;
+
+	return m_Recorder.Open(path);
+}
+
+void CSimulation::StopRecording() {
+	m_Recorder.Close();
+}
+
+bool CSimulation::StartExport(const SExportConfig &config) {
+	return m_Exporter.Open(config);
+}
+
+void CSimulation::StopExport() {
+	m_Exporter.Close();
+}
+
+void CSimulation::SetCheckpoints(const std::string &path, int interval) {
+	m_sCheckpointPath = path;
+	m_iCheckpointInterval = std::max(0, interval);
+}
+
+// The state is copied into the image (genomes and sweepers by the pool), so
+// the simulation waits for the memory copy only, and not for the disk.
+void CSimulation::SaveCheckpoint(const std::string &path) {
+
+	// there is nothing to save before the first reset
+	if (!m_pGA)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+
+	SCheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(&header.config, &m_Config, sizeof(m_Config));
+	m_pGA->GetState(header.ga);
+	header.random = m_Random.State();
+	header.width = m_iWidth;
+	header.height = m_iHeight;
+	header.ticks = m_iTicks;
+	header.generations = m_iGenerations;
+	header.eliteThreshold = m_iEliteThreshold;
+	header.eliteCount = m_iEliteCount;
+	header.sweepers = m_vecSweepers.size();
+	header.weights = CNeuralNet::NumberOfWeights(m_Config);
+	header.mines = m_vecMines.size();
+	header.relocated = m_vecRelocatedMines.size();
+	header.histogram = m_vecFitnessHistogram.size();
+	CheckpointLayout(header);
+
+	// The buffer is reused, so the padding has to be cleared: the header area
+	// and the last cache line of every section (before sections are written).
+	m_vecCheckpoint.resize(header.size);
+	unsigned char *data = m_vecCheckpoint.data();
+	memset(data, 0, header.fitnessOffset);
+	memcpy(data, &header, sizeof(header));
+	memset(data + header.weightsOffset - CheckpointAlignment, 0, CheckpointAlignment);
+	memset(data + header.sweepersOffset - CheckpointAlignment, 0, CheckpointAlignment);
+	memset(data + header.minesOffset - CheckpointAlignment, 0, header.histogramOffset - header.minesOffset + CheckpointAlignment);
+
+	const uint64_t weightsSize = header.weights * sizeof(double);
+	m_Pool.ParallelFor(0, header.sweepers, Grain(header.sweepers), [&](int first, int last) {
+		for (int i = first; i < last; ++i) {
+			const SGenome &genome = m_vecThePopulation[i];
+			memcpy(data + header.fitnessOffset + i * sizeof(double), &genome.dFitness, sizeof(double));
+			memcpy(data + header.weightsOffset + i * weightsSize, genome.vecWeights.data(), weightsSize);
+			SMinesweeperState state;
+			m_vecSweepers[i].GetState(state);
+			memcpy(data + header.sweepersOffset + i * sizeof(state), &state, sizeof(state));
+		}
+	});
+
+	for (unsigned int i = 0; i < header.mines; ++i) {
+		const double position[2] = { m_vecMines[i].x, m_vecMines[i].y };
+		memcpy(data + header.minesOffset + i * sizeof(position), position, sizeof(position));
+	}
+	for (unsigned int i = 0; i < header.relocated; ++i) {
+		const int32_t mine = m_vecRelocatedMines[i];
+		memcpy(data + header.relocatedOffset + i * sizeof(mine), &mine, sizeof(mine));
+	}
+	for (unsigned int i = 0; i < header.histogram; ++i) {
+		const int32_t count = m_vecFitnessHistogram[i];
+		memcpy(data + header.histogramOffset + i * sizeof(count), &count, sizeof(count));
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	m_dCheckpointTime = elapsed.count();
+
+	m_Checkpoints.Write(path, m_vecCheckpoint);
+
+}
+
+// Records are validated before anything is changed, so the restore either
+// succeeds or leaves the simulation intact. Sections are copied directly
+// into place, the only per-record work is unpacking the sweeper state.
+bool CSimulation::RestoreCheckpoint(const unsigned char *data, uint64_t size) {
+
+	auto start = std::chrono::steady_clock::now();
+
+	SCheckpointHeader header;
+	if (size < sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (!CheckpointValid(header, size))
+		return false;
+
+	SSimulationConfig config;
+	memcpy(&config, &header.config, sizeof(config));
+	if (!ValidConfig(config) || header.width <= 0 || header.height <= 0 ||
+			header.sweepers != (uint32_t)config.iNumSweepers ||
+			header.mines != (uint32_t)config.iNumMines ||
+			header.weights != (uint32_t)CNeuralNet::NumberOfWeights(config) ||
+			header.eliteThreshold < 0 || header.eliteThreshold > (int)header.histogram)
+		return false;
+
+	const int count = header.sweepers;
+	for (int i = 0; i < count; ++i) {
+		SMinesweeperState state;
+		memcpy(&state, data + header.sweepersOffset + i * sizeof(state), sizeof(state));
+		if (state.fitness < 0 || state.fitness >= (int)header.histogram ||
+				state.closestMine < 0 || (state.closestMine >= (int)header.mines && header.mines))
+			return false;
+	}
+	for (unsigned int i = 0; i < header.relocated; ++i) {
+		int32_t mine;
+		memcpy(&mine, data + header.relocatedOffset + i * sizeof(mine), sizeof(mine));
+		if (mine < 0 || mine >= (int)header.mines)
+			return false;
+	}
+
+	if (m_Recorder.IsRecording())
+		m_Recorder.EndGeneration();
+
+	m_Config = config;
+	m_bConfigPending = false;
+	++m_iConfigVersion;
+	m_iWidth = header.width;
+	m_iHeight = header.height;
+
+	const CMinesweeper prototype(m_Config);
+	m_vecSweepers.resize(count, prototype);
+	m_vecThePopulation.resize(count);
+
+	delete m_pGA;
+	m_pGA = new CGenAlg(count, header.weights, m_Config);
+	m_pGA->SetState(header.ga);
+
+	const uint64_t weightsSize = header.weights * sizeof(double);
+	m_Pool.ParallelFor(0, count, Grain(count), [&](int first, int last) {
+		for (int i = first; i < last; ++i) {
+			SGenome &genome = m_vecThePopulation[i];
+			memcpy(&genome.dFitness, data + header.fitnessOffset + i * sizeof(double), sizeof(double));
+			genome.vecWeights.resize(header.weights);
+			memcpy(genome.vecWeights.data(), data + header.weightsOffset + i * weightsSize, weightsSize);
+			SMinesweeperState state;
+			memcpy(&state, data + header.sweepersOffset + i * sizeof(state), sizeof(state));
+			// the state covers everything but the brain, which is reshaped
+			m_vecSweepers[i].Configure(m_Config);
+			m_vecSweepers[i].PutWeights(genome.vecWeights);
+			m_vecSweepers[i].SetState(state);
+		}
+	});
+
+	m_vecMines.resize(header.mines);
+	for (unsigned int i = 0; i < header.mines; ++i) {
+		double position[2];
+		memcpy(position, data + header.minesOffset + i * sizeof(position), sizeof(position));
+		m_vecMines[i] = SVector2D(position[0], position[1]);
+	}
+	m_vecRelocatedMines.resize(header.relocated);
+	for (unsigned int i = 0; i < header.relocated; ++i) {
+		int32_t mine;
+		memcpy(&mine, data + header.relocatedOffset + i * sizeof(mine), sizeof(mine));
+		m_vecRelocatedMines[i] = mine;
+	}
+	m_vecFitnessHistogram.resize(header.histogram);
+	for (unsigned int i = 0; i < header.histogram; ++i) {
+		int32_t sweepers;
+		memcpy(&sweepers, data + header.histogramOffset + i * sizeof(sweepers), sizeof(sweepers));
+		m_vecFitnessHistogram[i] = sweepers;
+	}
+
+	m_iEliteThreshold = header.eliteThreshold;
+	m_iEliteCount = header.eliteCount;
+	m_Random.Seed(header.random);
+	m_iTicks = header.ticks;
+	m_iGenerations = header.generations;
+	m_iSeededGenomes = 0;
+	m_bLineageValid = false;
+
+	m_dEpisodesPerSecond = 0;
+	m_bInternalError = false;
+	m_GenerationStats = SGenerationStats();
+
+	// the restore is accounted as the startup of the run
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	m_dStartupTime = elapsed.count();
+	m_bStartupPending = true;
+
+	return true;
+}
+
+// The file is loaded only when the path changes, the pending write of the
+// previous file is finished first.
+bool CSimulation::SetHallOfFame(const std::string &path, int capacity, int seedShare) {
+
+	m_iHallOfFameSeedShare = std::min(std::max(0, seedShare), 100);
+	m_HallOfFame.SetCapacity(capacity);
+
+	if (path == m_sHallOfFamePath)
+		return !m_bHallOfFameError;
+
+	m_HallOfFameWriter.Wait();
+	m_sHallOfFamePath = path;
+	m_bHallOfFameError = false;
+	if (path.empty())
+		return true;
+
+	m_bHallOfFameError = !m_HallOfFame.Load(path);
+	m_HallOfFame.SetCapacity(capacity);
+	return !m_bHallOfFameError;
+}
+
+// Evaluate every genome over a number of independent episodes, and use the
+// selected statistic of their results as the genome fitness. All genomes of
+// a generation are evaluated in the same set of layouts (different for every
+// generation), so the selection compares them in equal conditions. Episodes
+// do not share any state, so they are run concurrently.
+void CSimulation::EvaluateEpisodes() {
+
+	const int episodes = m_Config.iNumEpisodes;
+	const int count = m_vecSweepers.size() * episodes;
+	const CMinesweeper *sweepers = m_vecSweepers.data();
+	vector<int> results(count);
+	int *fitness = results.data();
+
+	vector<uint64_t> seeds(episodes);
+	for (int i = 0; i < episodes; ++i)
+		seeds[i] = m_Random.Next();
+
+	auto start = std::chrono::steady_clock::now();
+
+	// every episode is long enough to be a separate task
+	m_Pool.ParallelFor(0, count, 1, [&](int first, int last) {
+		for (int i = first; i < last; ++i)
+			fitness[i] = RunEpisode(sweepers[i / episodes], seeds[i % episodes]);
+	});
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	if (elapsed.count() > 0)
+		m_dEpisodesPerSecond = count / elapsed.count();
+
+	for (unsigned int i = 0; i < m_vecSweepers.size(); ++i) {
+
+		int *first = fitness + i * episodes;
+		int *last = first + episodes;
+
+		if (std::find(first, last, -1) != last) {
+			// error in processing the neural net
+			m_bInternalError = true;
+			return;
+		}
+
+		double value = 0;
+		switch (m_Config.iEpisodeStatistic) {
+		case EpisodeStatisticMean:
+			for (int *j = first; j < last; ++j)
+				value += *j;
+			value /= episodes;
+			break;
+		case EpisodeStatisticMedian:
+			std::sort(first, last);
+			value = episodes % 2 ? first[episodes / 2] :
+				(first[episodes / 2 - 1] + first[episodes / 2]) / 2.0;
+			break;
+		case EpisodeStatisticMinimum:
+			value = *std::min_element(first, last);
+			break;
+		}
+
+		m_vecThePopulation[i].dFitness = value;
+	}
+
+}
+
+// Run a single sweeper through iNumTicks cycles in its own mine field. The
+// layout of mines and the sweeper start pose are determined by the seed.
+// Returns collected mines or -1 upon NN error.
+int CSimulation::RunEpisode(const CMinesweeper &sweeper, uint64_t seed) const {
+
+	CRandom random(seed);
+
+	vector<SVector2D> mines(m_Config.iNumMines);
+	for (auto i = mines.begin(); i < mines.end(); ++i)
+		*i = SVector2D(random.RandFloat() * m_iWidth, random.RandFloat() * m_iHeight);
+
+	CMinesweeper episodeSweeper(sweeper);
+	episodeSweeper.Respawn(SVector2D(random.RandFloat() * m_iWidth,
+				random.RandFloat() * m_iHeight), random.RandFloat() * 2 * M_PI);
+
+	const bool rays = m_Config.iNumRays > 0;
+	CMineGrid grid;
+	if (rays)
+		grid.Build(mines, m_iWidth, m_iHeight, m_Config.dMineScale);
+
+	vector<int> relocated;
+	for (int tick = 0; tick < m_Config.iNumTicks; ++tick) {
+
+		if (!episodeSweeper.Update(mines, relocated, grid, m_Config))
+			return -1;
+
+		episodeSweeper.WarpWorld(0, 0, m_iWidth, m_iHeight);
+
+		relocated.clear();
+		int grabHit;
+		if ((grabHit = episodeSweeper.CheckForMine(mines, m_Config.dMineScale)) != -1) {
+			mines[grabHit] = SVector2D(random.RandFloat() * m_iWidth,
+					random.RandFloat() * m_iHeight);
+			relocated.push_back(grabHit);
+			episodeSweeper.IncrementFitness();
+			if (rays)
+				grid.Build(mines, m_iWidth, m_iHeight, m_Config.dMineScale);
+		}
+	}
+
+	return episodeSweeper.Fitness();
+}
+
+// Run the GA to create a new population and insert new brains into the
+// sweepers. If requested, the render snapshot is filled in with the state of
+// the new generation.
+void CSimulation::Epoch(SRenderSnapshot *snapshot) {
+
+	CProfileScope profile(ProfileEpoch);
+	CProfiler::Count(ProfileGenerations);
+
+	if (m_Recorder.IsRecording())
+		m_Recorder.EndGeneration();
+
+	// the population is evaluated, so gather its statistics before it is
+	// reshaped and replaced by the GA
+	m_PopulationStats.Compute(m_vecThePopulation, m_iGenerations, m_Pool, m_GenerationStats);
+	if (m_Exporter.IsOpen())
+		m_Exporter.Push(m_GenerationStats, m_vecThePopulation,
+				m_bLineageValid ? &m_Lineage : nullptr);
+	if (m_GenerationObserver)
+		m_GenerationObserver(m_GenerationStats, m_vecThePopulation);
+
+	// The file is rewritten only when some champion has been replaced. The
+	// file which could not be loaded is never overwritten.
+	if (m_HallOfFame.Offer(m_Config, m_vecThePopulation) &&
+			!m_sHallOfFamePath.empty() && !m_bHallOfFameError) {
+		m_HallOfFame.Store(m_vecHallOfFame);
+		m_HallOfFameWriter.Write(m_sHallOfFamePath, m_vecHallOfFame);
+	}
+
+	// the generation boundary is the only place where the configuration
+	// can be changed within the run
+	const SSimulationConfig previous = m_Config;
+	ApplyConfig(false);
+	const bool reshaped = Reshape(previous);
+
+	// Run the GA to create a new population. The lineage refers to the
+	// exported population, so it is not valid if that has been reshaped.
+	SGenomeLineage *lineage = m_Exporter.WantsLineage() ? &m_Lineage : nullptr;
+	m_vecThePopulation = m_pGA->Epoch(m_vecThePopulation, m_Pool, lineage);
+	m_bLineageValid = lineage && !reshaped;
+
+	// nobody has collected anything in the new generation yet
+	ResetEliteThreshold();
+
+	SRenderSweeper *states = nullptr;
+	SSweeperTotals totals;
+	if (snapshot) {
+		snapshot->vecSweepers.resize(m_vecSweepers.size());
+		states = snapshot->vecSweepers.data();
+	}
+
+	// insert the new (hopefully) improved brains back into the sweepers
+	m_Pool.ParallelFor(0, m_vecSweepers.size(), Grain(m_vecSweepers.size()),
+			[&](int first, int last) {
+		for (int i = first; i < last; ++i) {
+			m_vecSweepers[i].PutWeights(m_vecThePopulation[i].vecWeights);
+			m_vecSweepers[i].Respawn();
+		}
+		if (states)
+			collectSweepers(m_vecSweepers.data(), first, last, m_iEliteThreshold, states, totals);
+	});
+
+	// increment the generation counter
+	++m_iGenerations;
+
+	// reset cycles
+	m_iTicks = 0;
+
+	if (m_iCheckpointInterval && m_iGenerations % m_iCheckpointInterval == 0)
+		SaveCheckpoint(m_sCheckpointPath);
+
+	if (snapshot) {
+		totals.Store(*snapshot);
+		snapshot->iEliteThreshold = m_iEliteThreshold;
+		FillSnapshotSummary(*snapshot);
+	}
+
+}
+
+// Adjust the population size and the NN topology to the current config. When
+// the population shrinks, the fittest genomes survive, and when it grows, new
+// random genomes and sweepers are added. Weights of the evolved genomes are
+// carried over to the new topology, and brains are reshaped in place. This
+// has to be called before the GA epoch, because the GA is recreated. Returns
+// true if the population has been changed.
+bool CSimulation::Reshape(const SSimulationConfig &previous) {
+
+	const int count = m_Config.iNumSweepers;
+	const bool resize = count != previous.iNumSweepers;
+	const bool topology = CNeuralNet::NumberOfWeights(m_Config) != CNeuralNet::NumberOfWeights(previous) ||
+		m_Config.iNumInputs != previous.iNumInputs ||
+		m_Config.iNumHiddenLayers != previous.iNumHiddenLayers ||
+		m_Config.iNeuronsPerHiddenLayer != previous.iNeuronsPerHiddenLayer ||
+		m_Config.iNumOutputs != previous.iNumOutputs;
+
+	if (!resize && !topology)
+		return false;
+
+	// fittest genomes first (stable, so the outcome is deterministic)
+	if (count < (int)m_vecThePopulation.size())
+		std::stable_sort(m_vecThePopulation.begin(), m_vecThePopulation.end(),
+				[](const SGenome &a, const SGenome &b) { return a.dFitness > b.dFitness; });
+
+	const int genomes = std::min<int>(m_vecThePopulation.size(), count);
+	const int sweepers = std::min<int>(m_vecSweepers.size(), count);
+	const CMinesweeper prototype(m_Config);
+	m_vecThePopulation.resize(count);
+	m_vecSweepers.resize(count, prototype);
+
+	delete m_pGA;
+	m_pGA = new CGenAlg(count, prototype.GetNumberOfWeights(), m_Config);
+
+	const uint64_t seed = m_Random.Next();
+	m_pGA->Seed(SplitSeed(seed, count));
+
+	m_Pool.ParallelFor(0, count, Grain(count), [&](int first, int last) {
+
+		vector<double> weights;
+		for (int i = first; i < last; ++i) {
+
+			CRandom random(SplitSeed(seed, i));
+
+			if (i >= genomes)
+				m_pGA->CreateChromos(m_vecThePopulation, i, i + 1, random.Next());
+			else if (topology) {
+				CNeuralNet::ResizeWeights(m_vecThePopulation[i].vecWeights,
+						previous, m_Config, random, weights);
+				m_vecThePopulation[i].vecWeights.assign(weights.begin(), weights.end());
+			}
+
+			if (i >= sweepers)
+				m_vecSweepers[i].Respawn(SVector2D(random.RandFloat() * m_iWidth,
+							random.RandFloat() * m_iHeight), random.RandFloat() * 2 * M_PI);
+			else if (topology)
+				m_vecSweepers[i].Configure(m_Config);
+
+		}
+
+	});
+
+	return true;
+}
+
+// Get the chunk size for distributing sweepers among threads. Several chunks
+// per thread allow stealing, when some sweepers take longer to process.
+int CSimulation::Grain(int count) const {
+	return std::max(1, count / (m_Pool.Threads() * 4));
+}
+
+// Start the elite classification with all sweepers having zero fitness.
+void CSimulation::ResetEliteThreshold() {
+
+	m_vecFitnessHistogram.assign(1, m_vecSweepers.size());
+	m_iEliteThreshold = 0;
+	m_iEliteCount = m_vecSweepers.size();
+
+	// there might be more sweepers than the elite size
+	while (m_iEliteCount > m_Config.iNumElite) {
+		m_iEliteCount -= m_vecFitnessHistogram[m_iEliteThreshold];
+		++m_iEliteThreshold;
+	}
+
+}
+
+// Increase the fitness of the given sweeper and update the elite threshold.
+// Because the fitness never decreases, neither does the threshold, so the
+// cost is amortized O(1) per mine pickup.
+void CSimulation::IncrementFitness(int sweeper) {
+
+	const int fitness = m_vecSweepers[sweeper].Fitness();
+	m_vecSweepers[sweeper].IncrementFitness();
+
+	if (fitness + 1 == (int)m_vecFitnessHistogram.size())
+		m_vecFitnessHistogram.push_back(0);
+	--m_vecFitnessHistogram[fitness];
+	++m_vecFitnessHistogram[fitness + 1];
+
+	if (fitness + 1 == m_iEliteThreshold)
+		++m_iEliteCount;
+
+	// raise the threshold until the elite fits within its size again
+	while (m_iEliteCount > m_Config.iNumElite) {
+		m_iEliteCount -= m_vecFitnessHistogram[m_iEliteThreshold];
+		++m_iEliteThreshold;
+	}
+
+}
+
+// Fill in the whole render snapshot outside of the simulation cycle, e.g.
+// after the reset or when the simulation is paused.
+void CSimulation::FillSnapshot(SRenderSnapshot &snapshot) const {
+
+	snapshot.vecSweepers.resize(m_vecSweepers.size());
+	snapshot.iEliteThreshold = m_iEliteThreshold;
+
+	const CMinesweeper *sweepers = m_vecSweepers.data();
+	SRenderSweeper *states = snapshot.vecSweepers.data();
+	const int threshold = snapshot.iEliteThreshold;
+	SSweeperTotals totals;
+
+	m_Pool.ParallelFor(0, m_vecSweepers.size(), Grain(m_vecSweepers.size()),
+			[&](int first, int last) {
+		collectSweepers(sweepers, first, last, threshold, states, totals);
+	});
+
+	totals.Store(snapshot);
+	FillSnapshotSummary(snapshot);
+
+}
+
+// Fill in the part of the render snapshot which does not depend on the state
+// of particular sweepers.
+void CSimulation::FillSnapshotSummary(SRenderSnapshot &snapshot) const {
+
+	snapshot.vecMines.resize(m_vecMines.size());
+	for (unsigned int i = 0; i < m_vecMines.size(); ++i) {
+		snapshot.vecMines[i].x = m_vecMines[i].x;
+		snapshot.vecMines[i].y = m_vecMines[i].y;
+	}
+
+	snapshot.config = m_Config;
+	snapshot.iConfigVersion = m_iConfigVersion;
+	snapshot.bConfigPending = m_bConfigPending;
+	snapshot.iGeneration = m_iGenerations;
+	snapshot.iTicksLeft = m_Config.iNumTicks - m_iTicks;
+	snapshot.dBestFitness = m_pGA->BestFitness();
+	snapshot.dAverageFitness = m_pGA->AverageFitness();
+	snapshot.dEpisodesPerSecond = m_dEpisodesPerSecond;
+	snapshot.dStartupTime = m_dStartupTime;
+	snapshot.vecThreadUtilization = m_Pool.Utilization();
+	snapshot.bRecording = m_Recorder.IsOpen();
+	snapshot.iRecordedGenerations = m_Recorder.RecordedGenerations();
+	snapshot.dRecordingTime = m_iRecordedTicks ? m_dRecordingTime / m_iRecordedTicks : 0;
+	snapshot.dRecordingOverhead = m_dRecordedTicksTime ? m_dRecordingTime / m_dRecordedTicksTime : 0;
+	snapshot.dStatisticsTime = m_GenerationStats.dComputeTime;
+	snapshot.iCheckpoints = m_Checkpoints.Written();
+	snapshot.bCheckpointError = m_Checkpoints.Error();
+	snapshot.dCheckpointTime = m_dCheckpointTime;
+	snapshot.dCheckpointWriteTime = m_Checkpoints.WriteTime();
+	snapshot.iHallOfFameChampions = m_HallOfFame.Champions(m_Config);
+	snapshot.dHallOfFameBest = snapshot.iHallOfFameChampions ? m_HallOfFame.Fitness(m_Config, 0) : 0;
+	snapshot.iSeededGenomes = m_iSeededGenomes;
+	snapshot.bHallOfFameError = m_bHallOfFameError || m_HallOfFameWriter.Error();
+	snapshot.bExporting = m_Exporter.IsOpen();
+	if (snapshot.bExporting) {
+		snapshot.bExportError = m_Exporter.Error();
+		snapshot.iExportedGenerations = m_Exporter.ExportedGenerations();
+		snapshot.iExportDropped = m_Exporter.DroppedGenerations();
+		snapshot.iExportQueue = m_Exporter.QueuedGenerations();
+		snapshot.iExportQueueBytes = m_Exporter.QueuedBytes();
+		snapshot.dExportThroughput = m_Exporter.Throughput();
+		snapshot.dExportCompression = m_Exporter.HistoryCompression();
+		snapshot.dExportEncodeTime = m_Exporter.HistoryEncodeTime();
+	}
+	snapshot.bError = m_bInternalError;
+
+}
@@ -0,0 +1,377 @@
+// CSimulation.h
+// Copyright (c) 2014-2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// The 'Smart Sweepers' simulation engine. It holds the population of
+// genomes, minesweepers and mines, and it runs the simulation cycles.
+// This class does not depend on the GUI, so it can be run in any thread.
+
+#ifndef SMARTSWEEPERSQT_CSIMULATION_H_
+#define SMARTSWEEPERSQT_CSIMULATION_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CCheckpoint.h"
+#include "CExportWriter.h"
+#include "CGenAlg.h"
+#include "CHallOfFame.h"
+#include "CMineGrid.h"
+#include "CMinesweeper.h"
+#include "CPopulationStats.h"
+#include "CThreadPool.h"
+#include "CTrajectory.h"
+#include "SSimulationConfig.h"
+#include "SVector2D.h"
+#include "utils.h"
+
+using std::vector;
+
+
+// statistic used for combining the fitness of multiple episodes
+enum EpisodeStatistic {
+	EpisodeStatisticMean,
+	EpisodeStatisticMedian,
+	EpisodeStatisticMinimum,
+};
+
+
+// Compact state of a single sweeper required for rendering.
+struct SRenderSweeper {
+	float x, y;
+	float rotation;
+	// member of the fittest group
+	bool elite;
+};
+
+
+// Simulation state required for rendering a single frame. The engine fills
+// it in (during the tick, if possible), and afterwards it is handed over to
+// the renderer as a whole.
+struct SRenderSnapshot {
+
+	SRenderSnapshot() :
+			config(), iConfigVersion(0), bConfigPending(false),
+			iGeneration(0), iTicksLeft(0),
+			dBestFitness(0), dAverageFitness(0),
+			iEliteThreshold(0),
+			dEpisodesPerSecond(0),
+			dStartupTime(0),
+			iClosestMineSearches(0), iClosestMineCacheHits(0),
+			iControlUpdates(0), iKinematicUpdates(0),
+			bRecording(false), iRecordedGenerations(0),
+			dRecordingTime(0), dRecordingOverhead(0),
+			bReplay(false),
+			dStatisticsTime(0),
+			bExporting(false), bExportError(false),
+			iExportedGenerations(0), iExportDropped(0),
+			iExportQueue(0), iExportQueueBytes(0),
+			dExportThroughput(0),
+			dExportCompression(0), dExportEncodeTime(0),
+			iCheckpoints(0), bCheckpointError(false),
+			dCheckpointTime(0), dCheckpointWriteTime(0),
+			iHallOfFameChampions(0), dHallOfFameBest(0),
+			iSeededGenomes(0), bHallOfFameError(false),
+			bError(false) {  }
+
+	vector<SPoint> vecMines;
+	vector<SRenderSweeper> vecSweepers;
+
+	// configuration of the simulated generation, its version and whether
+	// there is a newer one waiting for the generation boundary
+	SSimulationConfig config;
+	int iConfigVersion;
+	bool bConfigPending;
+
+	int iGeneration;
+	int iTicksLeft;
+	double dBestFitness;
+	double dAverageFitness;
+	int iEliteThreshold;
+
+	// multi-episode evaluation throughput
+	double dEpisodesPerSecond;
+
+	// time from the start of the reset till the end of the first tick
+	double dStartupTime;
+
+	// closest mine cache statistics
+	unsigned long iClosestMineSearches;
+	unsigned long iClosestMineCacheHits;
+
+	// control rate statistics
+	unsigned long iControlUpdates;
+	unsigned long iKinematicUpdates;
+
+	// per-thread utilization of the simulation thread pool
+	vector<double> vecThreadUtilization;
+
+	// trajectory recording state, time spent on recording per tick and its
+	// share of the tick time
+	bool bRecording;
+	int iRecordedGenerations;
+	double dRecordingTime;
+	double dRecordingOverhead;
+
+	// the snapshot comes from the recording
+	bool bReplay;
+
+	// time spent on the statistics of the last finished generation
+	double dStatisticsTime;
+
+	// export state, the writer queue depth and its throughput (bytes per
+	// second of writing)
+	bool bExporting;
+	bool bExportError;
+	int iExportedGenerations;
+	int iExportDropped;
+	int iExportQueue;
+	size_t iExportQueueBytes;
+	double dExportThroughput;
+	// compression ratio of the genome history and time of encoding a
+	// generation (0 if the history is not exported)
+	double dExportCompression;
+	double dExportEncodeTime;
+
+	// number of written checkpoints, time of capturing the last one (the
+	// simulation is stopped meanwhile) and time of writing it
+	int iCheckpoints;
+	bool bCheckpointError;
+	double dCheckpointTime;
+	double dCheckpointWriteTime;
+
+	// number of champions for the current topology and the fittest one, and
+	// the number of genomes of the current run taken from champions
+	int iHallOfFameChampions;
+	double dHallOfFameBest;
+	int iSeededGenomes;
+	bool bHallOfFameError;
+
+	// indicates NN processing error
+	bool bError;
+
+};
+
+
+class CSimulation {
+
+public:
+
+	CSimulation(const SSimulationConfig &config, int width, int height);
+	~CSimulation();
+
+	// Post a new configuration. It is applied at the next generation boundary
+	// (or upon the reset), so the configuration is constant during the whole
+	// generation. Changes of the population size and the NN topology keep
+	// the evolved genomes (see Reshape()).
+	void SetConfig(const SSimulationConfig &config);
+
+	// Check whether the engine can run with the given configuration: counts
+	// and values are within their limits, the number of inputs matches ray
+	// sensors and copies of the elite fit into the population.
+	static bool ValidConfig(const SSimulationConfig &config);
+
+	const SSimulationConfig &Config() const { return m_Config; }
+	int ConfigVersion() const { return m_iConfigVersion; }
+
+	// (re)create the population for a new run, it has to be called before
+	// the first update
+	void Reset(uint64_t seed);
+
+	// set the dimensions of the world, mines are wrapped into it
+	void SetWorldSize(int width, int height);
+
+	// synchronize the number of mines with the given value
+	void SetNumMines(int number);
+
+	// set the number of simulation threads (0 - one per CPU)
+	void SetThreads(int threads, bool pin);
+
+	// Record trajectories of every interval-th generation into the given
+	// file (see CTrajectory.h), returns false if the file can not be created.
+	// Recording starts with the next generation. Generations evaluated in
+	// the multi-episode mode are not recorded.
+	bool StartRecording(const std::string &path, int interval);
+	void StopRecording();
+
+	// Export statistics (and genomes) of every finished generation (see
+	// CExportWriter.h), returns false if files can not be created. Stopping
+	// the export waits until everything queued has been written.
+	bool StartExport(const SExportConfig &config);
+	void StopExport();
+
+	// Write the checkpoint of every interval-th generation into the given
+	// file (see CCheckpoint.h), zero interval disables checkpoints.
+	void SetCheckpoints(const std::string &path, int interval);
+	// Capture the whole simulation state and write it in the background.
+	void SaveCheckpoint(const std::string &path);
+	// Continue the simulation saved in the checkpoint (the configuration and
+	// the world size are taken from the checkpoint as well). Returns false
+	// if the checkpoint is not valid, the simulation is not changed then.
+	bool RestoreCheckpoint(const unsigned char *data, uint64_t size);
+
+	// Collect champions of every generation in the hall of fame kept in the
+	// given file (see CHallOfFame.h), empty path keeps it in memory only. The
+	// given share (in percents) of the initial population of the next run is
+	// taken from champions. Returns false if the file is not valid.
+	bool SetHallOfFame(const std::string &path, int capacity, int seedShare);
+
+	// Run a single simulation cycle, returns false upon NN error. If the
+	// snapshot is given, it is filled in with the state after the cycle.
+	bool Update(SRenderSnapshot *snapshot = nullptr);
+
+	// fill in the render snapshot with the current simulation state
+	void FillSnapshot(SRenderSnapshot &snapshot) const;
+
+	int Generation() const { return m_iGenerations; }
+	double BestFitness() const { return m_pGA->BestFitness(); }
+	double AverageFitness() const { return m_pGA->AverageFitness(); }
+	bool Error() const { return m_bInternalError; }
+
+	// Sweepers with the fitness equal or greater than the threshold are the
+	// elite. It is the lowest fitness reached by at most iNumElite sweepers.
+	int EliteThreshold() const { return m_iEliteThreshold; }
+
+	// distribution statistics of the last finished generation
+	const SGenerationStats &GenerationStats() const { return m_GenerationStats; }
+
+	// The observer is called with every evaluated generation before it is
+	// replaced by the GA (in the thread running the update). Sweepers hold
+	// their final state at that moment.
+	void SetGenerationObserver(const std::function<void(const SGenerationStats &,
+			const vector<SGenome> &)> &observer) { m_GenerationObserver = observer; }
+
+	const vector<CMinesweeper> &Sweepers() const { return m_vecSweepers; }
+	const vector<SVector2D> &Mines() const { return m_vecMines; }
+	// ticks elapsed in the current generation
+	int Ticks() const { return m_iTicks; }
+
+private:
+
+	void ApplyConfig(bool reset);
+	bool Reshape(const SSimulationConfig &previous);
+	bool Cycle(SRenderSnapshot *snapshot);
+	bool UpdateSweepers(vector<SVector2D> &mines, SRenderSnapshot *snapshot);
+	void ResolveMineHits();
+	void WrapMines();
+	void RecordFrame();
+	void EvaluateEpisodes();
+	int RunEpisode(const CMinesweeper &sweeper, uint64_t seed) const;
+	void Epoch(SRenderSnapshot *snapshot);
+	void ResetEliteThreshold();
+	void IncrementFitness(int sweeper);
+	void FillSnapshotSummary(SRenderSnapshot &snapshot) const;
+	int Grain(int count) const;
+
+	// active configuration and the one waiting for the generation boundary
+	SSimulationConfig m_Config;
+	SSimulationConfig m_PendingConfig;
+	bool m_bConfigPending;
+	int m_iConfigVersion;
+
+	// storage for the population of genomes, minesweepers and mines
+	vector<SGenome> m_vecThePopulation;
+	vector<CMinesweeper> m_vecSweepers;
+	vector<SVector2D> m_vecMines;
+
+	// Histogram of sweepers fitness (number of sweepers with the given
+	// score), and the number of sweepers at or above the elite threshold.
+	// Fitness only grows by one upon a mine pickup, so the threshold can be
+	// maintained incrementally.
+	vector<int> m_vecFitnessHistogram;
+	int m_iEliteThreshold;
+	int m_iEliteCount;
+
+	// mine hit candidates (one per sweeper) gathered during the first phase
+	// of the simulation tick, and the per-mine claim markers used during the
+	// resolve phase
+	vector<int> m_vecMineHits;
+	vector<int> m_vecMineClaims;
+
+	// indexes of mines relocated during the last resolve phase
+	vector<int> m_vecRelocatedMines;
+
+	// trajectory recorder, and the time spent on recording compared to the
+	// time of recorded ticks
+	CTrajectoryRecorder m_Recorder;
+	int m_iRecordInterval;
+	double m_dRecordingTime;
+	double m_dRecordedTicksTime;
+	int m_iRecordedTicks;
+
+	// statistics of the last finished generation
+	CPopulationStats m_PopulationStats;
+	SGenerationStats m_GenerationStats;
+	std::function<void(const SGenerationStats &, const vector<SGenome> &)> m_GenerationObserver;
+
+	// background writer of finished generations, and the origin of genomes
+	// of the current generation (if it is exported as the history)
+	CExportWriter m_Exporter;
+	SGenomeLineage m_Lineage;
+	bool m_bLineageValid;
+
+	// periodic checkpoints, the buffer for the checkpoint image and the time
+	// spent on capturing the last one
+	CCheckpointWriter m_Checkpoints;
+	std::string m_sCheckpointPath;
+	int m_iCheckpointInterval;
+	vector<unsigned char> m_vecCheckpoint;
+	double m_dCheckpointTime;
+
+	// champions of all runs, the file they are kept in (it is written in
+	// the background the same way as checkpoints), the share of the initial
+	// population seeded from champions and the number of seeded genomes
+	CHallOfFame m_HallOfFame;
+	CCheckpointWriter m_HallOfFameWriter;
+	std::string m_sHallOfFamePath;
+	vector<unsigned char> m_vecHallOfFame;
+	int m_iHallOfFameSeedShare;
+	int m_iSeededGenomes;
+	bool m_bHallOfFameError;
+
+	// grid over the mines snapshot used by ray sensors
+	CMineGrid m_Grid;
+
+	// generator used for mines relocation, so the simulation outcome does
+	// not depend on the threads scheduling
+	CRandom m_Random;
+
+	// multi-episode evaluation throughput
+	double m_dEpisodesPerSecond;
+
+	// time-to-first-tick measurement
+	double m_dStartupTime;
+	bool m_bStartupPending;
+
+	// pool used for processing sweepers in parallel (mutable, because the
+	// utilization accounting is updated while taking the snapshot)
+	mutable CThreadPool m_Pool;
+
+	// world dimensions
+	int m_iWidth;
+	int m_iHeight;
+
+	// pointer to the GA
+	CGenAlg *m_pGA;
+
+	// indicates NN processing error
+	bool m_bInternalError;
+
+	// cycles per generation
+	int m_iTicks;
+
+	// generation counter
+	int m_iGenerations;
+
+	CSimulation(const CSimulation &);
+	CSimulation &operator=(const CSimulation &);
+
+};
+
+#endif
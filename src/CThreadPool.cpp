@@ -0,0 +1,255 @@
+// CThreadPool.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CThreadPool.h"
+
+#include <algorithm>
+#include <string>
+
+#if defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+#include "CProfiler.h"
+
+using std::chrono::steady_clock;
+
+
+CThreadPool::CThreadPool(int threads, bool pin) :
+		m_iQueued(0),
+		m_bQuit(false),
+		m_bPin(pin) {
+	// The calling thread is not pinned here, because the pool might be
+	// created in a different thread than the one which is going to use it.
+	Start(threads < 1 ? 1 : threads);
+}
+
+CThreadPool::~CThreadPool() {
+	Stop();
+}
+
+void CThreadPool::Resize(int threads, bool pin) {
+
+	if (threads < 1)
+		threads = 1;
+	if (threads == Threads() && pin == m_bPin)
+		return;
+
+	Stop();
+
+	// bind the calling thread or revert it to all CPUs
+	if (pin || m_bPin)
+		PinThread(pin ? 0 : -1);
+
+	m_bPin = pin;
+	Start(threads);
+
+}
+
+void CThreadPool::ParallelFor(int begin, int end, int grain,
+		const std::function<void(int first, int last)> &body) {
+
+	if (end <= begin)
+		return;
+	if (grain < 1)
+		grain = 1;
+
+	const int threads = Threads();
+
+	// there is no point in distributing a single chunk
+	if (threads == 1 || end - begin <= grain) {
+		auto start = steady_clock::now();
+		body(begin, end);
+		m_vecWorkers[0]->busy += (steady_clock::now() - start).count();
+		return;
+	}
+
+	const int chunks = (end - begin + grain - 1) / grain;
+
+	SBatch batch;
+	batch.body = &body;
+	batch.pending = chunks;
+
+	// Give every thread a contiguous block of chunks, so neighboring data is
+	// processed by the same thread unless the work has to be stolen.
+	for (int i = 0; i < threads; ++i) {
+		SWorker *worker = m_vecWorkers[i];
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		for (int j = i * chunks / threads; j < (i + 1) * chunks / threads; ++j) {
+			STask task = { &batch, begin + j * grain, std::min(end, begin + (j + 1) * grain) };
+			worker->tasks.push_back(task);
+		}
+	}
+
+	m_iQueued += chunks;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+	}
+	m_Condition.notify_all();
+
+	// help with the processing until all chunks are done
+	while (batch.pending.load(std::memory_order_acquire) > 0)
+		if (!RunTask(0))
+			std::this_thread::yield();
+
+}
+
+vector<double> CThreadPool::Utilization() {
+
+	auto now = steady_clock::now();
+	double wall = (now - m_UtilizationStart).count();
+	m_UtilizationStart = now;
+
+	vector<double> utilization(Threads());
+	for (int i = 0; i < Threads(); ++i) {
+		int64_t busy = m_vecWorkers[i]->busy;
+		utilization[i] = wall > 0 ? (busy - m_vecUtilizationBusy[i]) / wall : 0;
+		m_vecUtilizationBusy[i] = busy;
+	}
+
+	return utilization;
+}
+
+void CThreadPool::Start(int threads) {
+
+	m_bQuit = false;
+	m_vecWorkers.assign(threads, nullptr);
+	m_vecWorkers[0] = new SWorker;
+
+	for (int i = 1; i < threads; ++i)
+		m_vecThreads.push_back(std::thread(&CThreadPool::WorkerMain, this, i));
+
+	// wait for workers to allocate their data
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Condition.wait(lock, [this]() { return Ready(); });
+
+	m_UtilizationStart = steady_clock::now();
+	m_vecUtilizationBusy.assign(threads, 0);
+
+}
+
+void CThreadPool::Stop() {
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bQuit = true;
+	}
+	m_Condition.notify_all();
+
+	for (auto i = m_vecThreads.begin(); i != m_vecThreads.end(); ++i)
+		i->join();
+	m_vecThreads.clear();
+
+	for (auto i = m_vecWorkers.begin(); i != m_vecWorkers.end(); ++i)
+		delete *i;
+	m_vecWorkers.clear();
+
+}
+
+void CThreadPool::WorkerMain(int index) {
+
+	if (m_bPin)
+		PinThread(index);
+	CProfiler::SetThreadName("worker " + std::to_string(index));
+
+	{
+		// allocate per-thread data after the thread has been pinned
+		SWorker *worker = new SWorker;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_vecWorkers[index] = worker;
+		m_Condition.notify_all();
+		// wait for other threads, before we will try to steal their work
+		m_Condition.wait(lock, [this]() { return Ready(); });
+	}
+
+	for (;;) {
+
+		if (RunTask(index))
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Condition.wait(lock, [this]() { return m_bQuit || m_iQueued > 0; });
+		if (m_bQuit)
+			return;
+
+	}
+
+}
+
+// Check whether all threads have allocated their data.
+bool CThreadPool::Ready() const {
+	for (auto i = m_vecWorkers.begin(); i != m_vecWorkers.end(); ++i)
+		if (*i == nullptr)
+			return false;
+	return true;
+}
+
+// Process a single task. Returns false if there was nothing to do.
+bool CThreadPool::RunTask(int index) {
+
+	STask task;
+	if (!PopTask(index, task))
+		return false;
+
+	auto start = steady_clock::now();
+	(*task.batch->body)(task.first, task.last);
+	m_vecWorkers[index]->busy += (steady_clock::now() - start).count();
+
+	task.batch->pending.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+// Take the task from the back of our own deque, or steal one from the front
+// of the other thread deque.
+bool CThreadPool::PopTask(int index, STask &task) {
+
+	const int threads = Threads();
+
+	for (int i = 0; i < threads; ++i) {
+
+		SWorker *worker = m_vecWorkers[(index + i) % threads];
+		std::lock_guard<std::mutex> lock(worker->mutex);
+
+		if (worker->tasks.empty())
+			continue;
+
+		if (i == 0) {
+			task = worker->tasks.back();
+			worker->tasks.pop_back();
+		}
+		else {
+			task = worker->tasks.front();
+			worker->tasks.pop_front();
+		}
+
+		--m_iQueued;
+		return true;
+	}
+
+	return false;
+}
+
+// Bind the calling thread to the given CPU. Negative value allows the thread
+// to run on any CPU. Pinning is supported on Linux only.
+void CThreadPool::PinThread(int cpu) {
+#if defined(__linux__)
+	const int cpus = std::thread::hardware_concurrency();
+	if (cpus <= 0)
+		return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (cpu < 0)
+		for (int i = 0; i < cpus; ++i)
+			CPU_SET(i, &set);
+	else
+		CPU_SET(cpu % cpus, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+	(void)cpu;
+#endif
+}
@@ -0,0 +1,107 @@
+// CThreadPool.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Persistent work-stealing thread pool. Ranges are split into chunks, which
+// are distributed among per-thread task deques. Every thread processes its
+// own deque first, and then steals chunks from the other ones. The calling
+// thread takes part in the processing, so a pool with one thread does not
+// start any worker at all.
+
+#ifndef SMARTSWEEPERSQT_CTHREADPOOL_H_
+#define SMARTSWEEPERSQT_CTHREADPOOL_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+
+class CThreadPool {
+
+public:
+
+	CThreadPool(int threads = 1, bool pin = false);
+	~CThreadPool();
+
+	// Change the number of threads (including the calling one). If pin is
+	// true, threads are bound to consecutive CPUs.
+	void Resize(int threads, bool pin);
+
+	int Threads() const { return m_vecWorkers.size(); }
+	bool Pinned() const { return m_bPin; }
+
+	// Call body(first, last) for chunks of the [begin, end) range, which are
+	// not longer than the grain. Returns when all chunks are processed.
+	void ParallelFor(int begin, int end, int grain,
+			const std::function<void(int first, int last)> &body);
+
+	// Fraction of the time every thread has spent processing chunks since
+	// the last call of this function. Index 0 is the calling thread.
+	vector<double> Utilization();
+
+private:
+
+	struct SBatch;
+
+	struct STask {
+		SBatch *batch;
+		int first;
+		int last;
+	};
+
+	struct SBatch {
+		const std::function<void(int, int)> *body;
+		std::atomic<int> pending;
+	};
+
+	// Per-thread data. It is allocated by the owning thread itself, so with
+	// the first-touch policy it is placed in the memory of the local NUMA
+	// node (if threads are pinned).
+	struct SWorker {
+		SWorker() : busy(0) {  }
+		std::mutex mutex;
+		std::deque<STask> tasks;
+		std::atomic<int64_t> busy;
+	};
+
+	void Start(int threads);
+	void Stop();
+
+	bool Ready() const;
+	void WorkerMain(int index);
+	bool RunTask(int index);
+	bool PopTask(int index, STask &task);
+
+	static void PinThread(int cpu);
+
+	vector<std::thread> m_vecThreads;
+	vector<SWorker *> m_vecWorkers;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::atomic<int> m_iQueued;
+	bool m_bQuit;
+	bool m_bPin;
+
+	// utilization accounting
+	std::chrono::steady_clock::time_point m_UtilizationStart;
+	vector<int64_t> m_vecUtilizationBusy;
+
+	CThreadPool(const CThreadPool &);
+	CThreadPool &operator=(const CThreadPool &);
+
+};
+
+#endif
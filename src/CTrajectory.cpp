@@ -0,0 +1,246 @@
+// CTrajectory.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CTrajectory.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+// format version, increment upon any incompatible change
+static const uint32_t trajectoryVersion = 1;
+
+
+// Get the difference between two positions in the wrapped world, so moving
+// across the world edge is a small step.
+static double wrappedDifference(double to, double from, double size) {
+	double diff = to - from;
+	if (diff > size / 2)
+		diff -= size;
+	else if (diff < -size / 2)
+		diff += size;
+	return diff;
+}
+
+
+CTrajectoryRecorder::CTrajectoryRecorder() :
+		m_pFile(nullptr),
+		m_bRecording(false),
+		m_iGenerations(0),
+		m_Header(),
+		m_HeaderPosition(),
+		m_iBlockSize(0),
+		m_iTick(0) {
+}
+
+CTrajectoryRecorder::~CTrajectoryRecorder() {
+	Close();
+}
+
+bool CTrajectoryRecorder::Open(const std::string &path) {
+
+	Close();
+
+	if ((m_pFile = fopen(path.c_str(), "wb")) == nullptr)
+		return false;
+
+	STrajectoryHeader header;
+	memcpy(header.magic, "SSTR", 4);
+	header.version = trajectoryVersion;
+
+	if (fwrite(&header, sizeof(header), 1, m_pFile) != 1) {
+		Close();
+		return false;
+	}
+
+	m_iGenerations = 0;
+	return true;
+}
+
+// The generation which is being recorded is finished, so the file contains
+// everything recorded so far.
+void CTrajectoryRecorder::Close() {
+
+	if (!m_pFile)
+		return;
+
+	if (m_bRecording)
+		EndGeneration();
+
+	if (m_pFile)
+		fclose(m_pFile);
+	m_pFile = nullptr;
+
+}
+
+void CTrajectoryRecorder::BeginGeneration(int generation, int sweepers, int mines,
+		double width, double height, const SSimulationConfig &config) {
+
+	if (m_bRecording)
+		EndGeneration();
+
+	m_Header = STrajectoryGeneration();
+	m_Header.generation = generation;
+	m_Header.sweepers = sweepers;
+	m_Header.mines = mines;
+	m_Header.keyInterval = TrajectoryKeyInterval;
+	m_Header.numElite = config.iNumElite;
+	m_Header.width = width;
+	m_Header.height = height;
+	m_Header.positionStep = TrajectoryPositionStep;
+	m_Header.sweeperScale = config.dSweeperScale;
+	m_Header.mineScale = config.dMineScale;
+
+	// the header is written again (with offsets filled in) at the end
+	fgetpos(m_pFile, &m_HeaderPosition);
+	m_iBlockSize = 0;
+	if (!Write(&m_Header, sizeof(m_Header)))
+		return;
+
+	m_iTick = 0;
+	m_vecDecoded.resize(sweepers);
+	m_vecKeys.clear();
+	m_vecEvents.clear();
+
+	m_bRecording = true;
+
+}
+
+bool CTrajectoryRecorder::EndGeneration() {
+
+	if (!m_bRecording)
+		return false;
+	m_bRecording = false;
+
+	m_Header.ticks = m_iTick;
+	m_Header.events = m_vecEvents.size();
+	m_Header.keysOffset = m_iBlockSize;
+	m_Header.eventsOffset = m_iBlockSize + m_vecKeys.size();
+
+	if (!Write(m_vecKeys.data(), m_vecKeys.size()) ||
+			!Write(m_vecEvents.data(), m_vecEvents.size() * sizeof(STrajectoryEvent)))
+		return false;
+
+	m_Header.size = m_iBlockSize;
+
+	fpos_t end;
+	if (fgetpos(m_pFile, &end) != 0 ||
+			fsetpos(m_pFile, &m_HeaderPosition) != 0 ||
+			fwrite(&m_Header, sizeof(m_Header), 1, m_pFile) != 1 ||
+			fsetpos(m_pFile, &end) != 0 ||
+			fflush(m_pFile) != 0) {
+		fclose(m_pFile);
+		m_pFile = nullptr;
+		return false;
+	}
+
+	++m_iGenerations;
+	return true;
+}
+
+void CTrajectoryRecorder::BeginFrame(const vector<CMinesweeper> &sweepers, const vector<SVector2D> &mines) {
+
+	const bool key = m_iTick % m_Header.keyInterval == 0;
+	m_vecFrame.resize(m_Header.sweepers * (key ? TrajectoryKeyPoseSize : TrajectoryDeltaPoseSize));
+
+	if (!key)
+		return;
+
+	// fitness and mines at the key frame tick, followed by the index of the
+	// first pickup event of this tick
+	size_t offset = m_vecKeys.size();
+	m_vecKeys.resize(offset + TrajectoryKeySize(m_Header));
+	unsigned char *data = m_vecKeys.data() + offset;
+
+	for (unsigned int i = 0; i < m_Header.sweepers; ++i, data += 2) {
+		uint16_t fitness = std::min(sweepers[i].Fitness(), 0xFFFF);
+		memcpy(data, &fitness, 2);
+	}
+
+	for (unsigned int i = 0; i < m_Header.mines; ++i, data += 4) {
+		uint16_t position[2] = {
+			TrajectoryQuantize(mines[i].x, m_Header.width),
+			TrajectoryQuantize(mines[i].y, m_Header.height) };
+		memcpy(data, position, 4);
+	}
+
+	uint32_t event = m_vecEvents.size();
+	memcpy(data, &event, 4);
+
+}
+
+// Key frames store absolute poses. Other frames store the difference between
+// the actual position and the one reconstructed by the decoder, so the error
+// is bounded by the half of the quantization step.
+void CTrajectoryRecorder::EncodePoses(const CMinesweeper *sweepers, int first, int last) {
+
+	const double width = m_Header.width;
+	const double height = m_Header.height;
+	const double step = m_Header.positionStep;
+
+	if (m_iTick % m_Header.keyInterval == 0) {
+		unsigned char *data = m_vecFrame.data() + first * TrajectoryKeyPoseSize;
+		for (int i = first; i < last; ++i, data += TrajectoryKeyPoseSize) {
+			const SVector2D position = sweepers[i].Position();
+			uint16_t x = TrajectoryQuantize(position.x, width);
+			uint16_t y = TrajectoryQuantize(position.y, height);
+			memcpy(data, &x, 2);
+			memcpy(data + 2, &y, 2);
+			data[4] = TrajectoryQuantizeAngle(sweepers[i].Rotation());
+			m_vecDecoded[i] = SVector2D(TrajectoryDequantize(x, width), TrajectoryDequantize(y, height));
+		}
+		return;
+	}
+
+	unsigned char *data = m_vecFrame.data() + first * TrajectoryDeltaPoseSize;
+	for (int i = first; i < last; ++i, data += TrajectoryDeltaPoseSize) {
+		const SVector2D position = sweepers[i].Position();
+		SVector2D &decoded = m_vecDecoded[i];
+		int dx = lround(wrappedDifference(position.x, decoded.x, width) / step);
+		int dy = lround(wrappedDifference(position.y, decoded.y, height) / step);
+		dx = std::max(-127, std::min(127, dx));
+		dy = std::max(-127, std::min(127, dy));
+		data[0] = (int8_t)dx;
+		data[1] = (int8_t)dy;
+		data[2] = TrajectoryQuantizeAngle(sweepers[i].Rotation());
+		decoded.x = TrajectoryApplyDelta(decoded.x, dx, step, width);
+		decoded.y = TrajectoryApplyDelta(decoded.y, dy, step, height);
+	}
+
+}
+
+bool CTrajectoryRecorder::EndFrame() {
+	if (!Write(m_vecFrame.data(), m_vecFrame.size()))
+		return false;
+	++m_iTick;
+	return true;
+}
+
+void CTrajectoryRecorder::AddEvent(int sweeper, int mine, const SVector2D &position) {
+	STrajectoryEvent event;
+	// the frame of the current tick has been written already
+	event.tick = m_iTick - 1;
+	event.sweeper = sweeper;
+	event.mine = mine;
+	event.x = TrajectoryQuantize(position.x, m_Header.width);
+	event.y = TrajectoryQuantize(position.y, m_Header.height);
+	m_vecEvents.push_back(event);
+}
+
+// Upon write error the file is closed, so the recording stops.
+bool CTrajectoryRecorder::Write(const void *data, size_t size) {
+
+	if (size && fwrite(data, size, 1, m_pFile) != 1) {
+		fclose(m_pFile);
+		m_pFile = nullptr;
+		m_bRecording = false;
+		return false;
+	}
+
+	m_iBlockSize += size;
+	return true;
+}
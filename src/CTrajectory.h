@@ -0,0 +1,185 @@
+// CTrajectory.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Compact recording of sweepers trajectories. Every recorded generation is
+// stored as a block of fixed-size frames (one per tick) with quantized
+// poses. Every keyInterval-th frame holds absolute poses, the rest holds
+// deltas, so the offset of any frame can be computed and any tick can be
+// reconstructed by decoding at most keyInterval frames. Key tables (fitness
+// and mines) and mine pickup events follow the frames.
+
+#ifndef SMARTSWEEPERSQT_CTRAJECTORY_H_
+#define SMARTSWEEPERSQT_CTRAJECTORY_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "CMinesweeper.h"
+#include "SSimulationConfig.h"
+#include "SVector2D.h"
+
+using std::vector;
+
+
+// File header, followed by blocks of recorded generations. All values are
+// stored in the native byte order.
+struct STrajectoryHeader {
+	char magic[4];
+	uint32_t version;
+};
+
+// Header of a recorded generation block. Offsets are relative to the start
+// of the block. Block which has not been finished has zero size.
+struct STrajectoryGeneration {
+	uint64_t size;
+	uint64_t keysOffset;
+	uint64_t eventsOffset;
+	uint32_t generation;
+	uint32_t ticks;
+	uint32_t sweepers;
+	uint32_t mines;
+	uint32_t keyInterval;
+	uint32_t events;
+	uint32_t numElite;
+	float width;
+	float height;
+	// quantization step of position deltas
+	float positionStep;
+	float sweeperScale;
+	float mineScale;
+};
+
+// Mine pickup: the sweeper has collected the mine, which has been moved to
+// the new (quantized) position.
+struct STrajectoryEvent {
+	uint32_t tick;
+	uint32_t sweeper;
+	uint32_t mine;
+	uint16_t x;
+	uint16_t y;
+};
+
+// Key pose: 16-bit position relative to the world size and 8-bit angle.
+// Delta pose: 8-bit position delta in positionStep units and 8-bit angle.
+const int TrajectoryKeyPoseSize = 5;
+const int TrajectoryDeltaPoseSize = 3;
+
+// Sweepers move by at most 2 units per tick (the speed is the sum of two
+// sigmoid outputs), so deltas fit into 8 bits with some margin.
+const double TrajectoryPositionStep = 2.0 / 120;
+
+const int TrajectoryKeyInterval = 32;
+
+
+inline uint16_t TrajectoryQuantize(double value, double size) {
+	return (uint32_t)lround(value / size * 65536) & 0xFFFF;
+}
+
+inline double TrajectoryDequantize(uint16_t value, double size) {
+	return value * size / 65536;
+}
+
+inline uint8_t TrajectoryQuantizeAngle(double angle) {
+	return (uint32_t)lround(angle / (2 * 3.14159265358979323846) * 256) & 0xFF;
+}
+
+inline double TrajectoryDequantizeAngle(uint8_t angle) {
+	return angle * (2 * 3.14159265358979323846) / 256;
+}
+
+// Apply the position delta in the wrapped world. The encoder uses the very
+// same function to track the decoded position, so errors do not accumulate.
+inline double TrajectoryApplyDelta(double value, int delta, double step, double size) {
+	value += delta * step;
+	if (value < 0)
+		value += size;
+	else if (value >= size)
+		value -= size;
+	return value;
+}
+
+// offset of the frame with the given tick relative to the block start
+inline uint64_t TrajectoryFrameOffset(const STrajectoryGeneration &g, int tick) {
+	const uint64_t key = (uint64_t)g.sweepers * TrajectoryKeyPoseSize;
+	const uint64_t delta = (uint64_t)g.sweepers * TrajectoryDeltaPoseSize;
+	const int k = tick / g.keyInterval;
+	const int t = tick % g.keyInterval;
+	uint64_t offset = sizeof(STrajectoryGeneration) + k * (key + (g.keyInterval - 1) * delta);
+	if (t)
+		offset += key + (t - 1) * delta;
+	return offset;
+}
+
+// size of the key table: fitness, mines and the index of the first event
+inline uint64_t TrajectoryKeySize(const STrajectoryGeneration &g) {
+	return (uint64_t)g.sweepers * 2 + (uint64_t)g.mines * 4 + 4;
+}
+
+
+class CTrajectoryRecorder {
+
+public:
+
+	CTrajectoryRecorder();
+	~CTrajectoryRecorder();
+
+	// create the recording file, returns false upon failure
+	bool Open(const std::string &path);
+	void Close();
+
+	bool IsOpen() const { return m_pFile != nullptr; }
+	// whether a generation is being recorded
+	bool IsRecording() const { return m_bRecording; }
+
+	int RecordedGenerations() const { return m_iGenerations; }
+
+	void BeginGeneration(int generation, int sweepers, int mines,
+			double width, double height, const SSimulationConfig &config);
+	// finish the generation block, returns false upon write error
+	bool EndGeneration();
+
+	// Recording of a single tick. Poses are encoded after all sweepers have
+	// been moved, chunks of sweepers can be encoded concurrently. The key
+	// table (when due) is taken before mine pickups of the tick are added.
+	void BeginFrame(const vector<CMinesweeper> &sweepers, const vector<SVector2D> &mines);
+	void EncodePoses(const CMinesweeper *sweepers, int first, int last);
+	bool EndFrame();
+
+	// record the mine pickup of the current tick
+	void AddEvent(int sweeper, int mine, const SVector2D &position);
+
+private:
+
+	bool Write(const void *data, size_t size);
+
+	FILE *m_pFile;
+	bool m_bRecording;
+	int m_iGenerations;
+
+	// header of the current block, its position in the file and the number
+	// of bytes written so far
+	STrajectoryGeneration m_Header;
+	fpos_t m_HeaderPosition;
+	uint64_t m_iBlockSize;
+
+	// current tick and its encoded frame
+	int m_iTick;
+	vector<unsigned char> m_vecFrame;
+
+	// positions as seen by the decoder
+	vector<SVector2D> m_vecDecoded;
+
+	vector<unsigned char> m_vecKeys;
+	vector<STrajectoryEvent> m_vecEvents;
+
+};
+
+#endif
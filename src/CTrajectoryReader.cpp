@@ -0,0 +1,234 @@
+// CTrajectoryReader.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "CTrajectoryReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+CTrajectoryReader::CTrajectoryReader() :
+		m_pData(nullptr),
+		m_iIndex(-1),
+		m_iTick(-1),
+		m_iEvent(0),
+		m_iEliteThreshold(0) {
+}
+
+// Blocks are validated up front, so decoding does not have to check any
+// offsets. Parsing stops at the first unfinished (or damaged) block, hence
+// the recording which has not been closed properly can be replayed too.
+bool CTrajectoryReader::Open(const unsigned char *data, uint64_t size) {
+
+	m_pData = data;
+	m_vecGenerations.clear();
+	m_vecOffsets.clear();
+	m_iIndex = m_iTick = -1;
+
+	STrajectoryHeader header;
+	if (size < sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, "SSTR", 4) != 0 || header.version != 1)
+		return false;
+
+	uint64_t offset = sizeof(header);
+	while (size - offset >= sizeof(STrajectoryGeneration)) {
+
+		STrajectoryGeneration g;
+		memcpy(&g, data + offset, sizeof(g));
+
+		if (g.size == 0 || g.size > size - offset || g.ticks == 0 ||
+				g.keyInterval == 0 || g.width <= 0 || g.height <= 0)
+			break;
+
+		const uint64_t keys = (g.ticks + g.keyInterval - 1) / g.keyInterval;
+		if (TrajectoryFrameOffset(g, g.ticks) > g.keysOffset ||
+				g.keysOffset + keys * TrajectoryKeySize(g) > g.eventsOffset ||
+				g.eventsOffset + (uint64_t)g.events * sizeof(STrajectoryEvent) > g.size)
+			break;
+
+		m_vecGenerations.push_back(g);
+		m_vecOffsets.push_back(offset);
+		offset += g.size;
+	}
+
+	return true;
+}
+
+bool CTrajectoryReader::Seek(int index, int tick) {
+
+	if (index < 0 || index >= (int)m_vecGenerations.size() ||
+			tick < 0 || tick >= (int)m_vecGenerations[index].ticks)
+		return false;
+
+	const int interval = m_vecGenerations[index].keyInterval;
+
+	// playback goes frame by frame, so there is no need to start from the
+	// last key frame
+	if (index == m_iIndex && tick == m_iTick + 1 && tick % interval)
+		DecodeDelta(tick);
+	else {
+		m_iIndex = index;
+		const int key = tick - tick % interval;
+		DecodeKey(key);
+		for (int t = key + 1; t <= tick; ++t) {
+			ApplyEvents(t - 1);
+			DecodeDelta(t);
+		}
+	}
+
+	// the simulation classifies elite sweepers before mine pickups
+	ClassifyElite();
+	ApplyEvents(tick);
+
+	m_iTick = tick;
+	return true;
+}
+
+void CTrajectoryReader::DecodeKey(int tick) {
+
+	const STrajectoryGeneration &g = m_vecGenerations[m_iIndex];
+	const unsigned char *block = m_pData + m_vecOffsets[m_iIndex];
+	const unsigned char *data = block + TrajectoryFrameOffset(g, tick);
+
+	m_vecPositions.resize(g.sweepers);
+	m_vecAngles.resize(g.sweepers);
+	for (unsigned int i = 0; i < g.sweepers; ++i, data += TrajectoryKeyPoseSize) {
+		uint16_t x, y;
+		memcpy(&x, data, 2);
+		memcpy(&y, data + 2, 2);
+		m_vecPositions[i] = SVector2D(TrajectoryDequantize(x, g.width), TrajectoryDequantize(y, g.height));
+		m_vecAngles[i] = data[4];
+	}
+
+	// fitness and mines are taken from the key table
+	data = block + g.keysOffset + tick / g.keyInterval * TrajectoryKeySize(g);
+
+	m_vecFitness.resize(g.sweepers);
+	for (unsigned int i = 0; i < g.sweepers; ++i, data += 2) {
+		uint16_t fitness;
+		memcpy(&fitness, data, 2);
+		m_vecFitness[i] = fitness;
+	}
+
+	m_vecMines.resize(g.mines);
+	for (unsigned int i = 0; i < g.mines; ++i, data += 4) {
+		uint16_t position[2];
+		memcpy(position, data, 4);
+		m_vecMines[i] = SVector2D(TrajectoryDequantize(position[0], g.width),
+				TrajectoryDequantize(position[1], g.height));
+	}
+
+	memcpy(&m_iEvent, data, 4);
+
+}
+
+void CTrajectoryReader::DecodeDelta(int tick) {
+
+	const STrajectoryGeneration &g = m_vecGenerations[m_iIndex];
+	const unsigned char *data = m_pData + m_vecOffsets[m_iIndex] + TrajectoryFrameOffset(g, tick);
+
+	for (unsigned int i = 0; i < g.sweepers; ++i, data += TrajectoryDeltaPoseSize) {
+		SVector2D &position = m_vecPositions[i];
+		position.x = TrajectoryApplyDelta(position.x, (int8_t)data[0], g.positionStep, g.width);
+		position.y = TrajectoryApplyDelta(position.y, (int8_t)data[1], g.positionStep, g.height);
+		m_vecAngles[i] = data[2];
+	}
+
+}
+
+// apply mine pickups which have happened up to the given tick (inclusive)
+void CTrajectoryReader::ApplyEvents(int tick) {
+
+	const STrajectoryGeneration &g = m_vecGenerations[m_iIndex];
+	const unsigned char *data = m_pData + m_vecOffsets[m_iIndex] + g.eventsOffset;
+
+	for (; m_iEvent < g.events; ++m_iEvent) {
+
+		STrajectoryEvent event;
+		memcpy(&event, data + m_iEvent * sizeof(event), sizeof(event));
+		if ((int)event.tick > tick)
+			break;
+
+		if (event.sweeper < g.sweepers)
+			++m_vecFitness[event.sweeper];
+		if (event.mine < g.mines)
+			m_vecMines[event.mine] = SVector2D(TrajectoryDequantize(event.x, g.width),
+					TrajectoryDequantize(event.y, g.height));
+	}
+
+}
+
+// The elite threshold is the lowest fitness reached by at most iNumElite
+// sweepers (the same as in the simulation), both the threshold and the
+// fitness are taken at the tick start.
+void CTrajectoryReader::ClassifyElite() {
+
+	const STrajectoryGeneration &g = m_vecGenerations[m_iIndex];
+
+	int best = 0;
+	for (unsigned int i = 0; i < g.sweepers; ++i)
+		best = std::max(best, m_vecFitness[i]);
+
+	m_vecHistogram.assign(best + 2, 0);
+	for (unsigned int i = 0; i < g.sweepers; ++i)
+		++m_vecHistogram[m_vecFitness[i]];
+
+	m_iEliteThreshold = 0;
+	int elite = g.sweepers;
+	while (elite > (int)g.numElite)
+		elite -= m_vecHistogram[m_iEliteThreshold++];
+
+	m_vecElite.resize(g.sweepers);
+	for (unsigned int i = 0; i < g.sweepers; ++i)
+		m_vecElite[i] = m_vecFitness[i] >= m_iEliteThreshold;
+
+}
+
+void CTrajectoryReader::FillSnapshot(SRenderSnapshot &snapshot) const {
+
+	const STrajectoryGeneration &g = m_vecGenerations[m_iIndex];
+	int best = 0;
+	double total = 0;
+	for (unsigned int i = 0; i < g.sweepers; ++i) {
+		best = std::max(best, m_vecFitness[i]);
+		total += m_vecFitness[i];
+	}
+
+	snapshot.vecSweepers.resize(g.sweepers);
+	for (unsigned int i = 0; i < g.sweepers; ++i) {
+		snapshot.vecSweepers[i].x = m_vecPositions[i].x;
+		snapshot.vecSweepers[i].y = m_vecPositions[i].y;
+		snapshot.vecSweepers[i].rotation = TrajectoryDequantizeAngle(m_vecAngles[i]);
+		snapshot.vecSweepers[i].elite = m_vecElite[i];
+	}
+
+	snapshot.vecMines.resize(g.mines);
+	for (unsigned int i = 0; i < g.mines; ++i)
+		snapshot.vecMines[i] = SPoint(m_vecMines[i].x, m_vecMines[i].y);
+
+	snapshot.config = SSimulationConfig();
+	snapshot.config.dSweeperScale = g.sweeperScale;
+	snapshot.config.dMineScale = g.mineScale;
+	snapshot.config.iNumSweepers = g.sweepers;
+	snapshot.config.iNumMines = g.mines;
+	snapshot.config.iNumTicks = g.ticks;
+	snapshot.config.iNumElite = g.numElite;
+	snapshot.config.iControlInterval = 1;
+	snapshot.config.iNumEpisodes = 1;
+
+	snapshot.iGeneration = g.generation;
+	snapshot.iTicksLeft = g.ticks - m_iTick - 1;
+	// fitness statistics of the replayed generation so far
+	snapshot.dBestFitness = best;
+	snapshot.dAverageFitness = g.sweepers ? total / g.sweepers : 0;
+	snapshot.iEliteThreshold = m_iEliteThreshold;
+	snapshot.vecThreadUtilization.clear();
+	snapshot.bError = false;
+
+}
@@ -0,0 +1,70 @@
+// CTrajectoryReader.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Decoder of the recorded trajectories (see CTrajectory.h). It works on the
+// recording held in the memory (e.g. memory-mapped file), and reconstructs
+// the render snapshot of any recorded tick without running the simulation.
+
+#ifndef SMARTSWEEPERSQT_CTRAJECTORYREADER_H_
+#define SMARTSWEEPERSQT_CTRAJECTORYREADER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "CSimulation.h"
+#include "CTrajectory.h"
+
+using std::vector;
+
+
+class CTrajectoryReader {
+
+public:
+
+	CTrajectoryReader();
+
+	// Parse the recording, returns false if it is not valid. The memory has
+	// to stay valid as long as the reader is used.
+	bool Open(const unsigned char *data, uint64_t size);
+
+	int Generations() const { return m_vecGenerations.size(); }
+	const STrajectoryGeneration &Generation(int index) const { return m_vecGenerations[index]; }
+
+	// Reconstruct the state after the given tick of the recorded generation.
+	// Seeking to the next tick decodes a single frame only.
+	bool Seek(int index, int tick);
+
+	void FillSnapshot(SRenderSnapshot &snapshot) const;
+
+private:
+
+	void DecodeKey(int tick);
+	void DecodeDelta(int tick);
+	void ApplyEvents(int tick);
+	void ClassifyElite();
+
+	const unsigned char *m_pData;
+	vector<STrajectoryGeneration> m_vecGenerations;
+	vector<uint64_t> m_vecOffsets;
+
+	// current position and the decoded state
+	int m_iIndex;
+	int m_iTick;
+	uint32_t m_iEvent;
+	vector<SVector2D> m_vecPositions;
+	vector<uint8_t> m_vecAngles;
+	vector<int> m_vecFitness;
+	vector<SVector2D> m_vecMines;
+
+	int m_iEliteThreshold;
+	vector<int> m_vecHistogram;
+	vector<uint8_t> m_vecElite;
+
+};
+
+#endif
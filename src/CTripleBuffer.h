@@ -0,0 +1,67 @@
+// CTripleBuffer.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Lock-free triple buffer for handing over data from a single producer to
+// a single consumer. The producer always has a buffer to write into, and
+// the consumer always reads the most recently published one. Neither side
+// ever waits for the other one.
+
+#ifndef SMARTSWEEPERSQT_CTRIPLEBUFFER_H_
+#define SMARTSWEEPERSQT_CTRIPLEBUFFER_H_
+
+#include <atomic>
+
+
+template <typename T>
+class CTripleBuffer {
+
+public:
+
+	CTripleBuffer() :
+			m_iBack(0),
+			m_iMiddle(1),
+			m_iFront(2) {  }
+
+	// buffer owned by the producer
+	T &Back() { return m_Buffers[m_iBack]; }
+
+	// buffer owned by the consumer
+	const T &Front() const { return m_Buffers[m_iFront]; }
+
+	// Make the back buffer available for the consumer. The previously
+	// published buffer (if not consumed yet) becomes the new back buffer.
+	void Publish() {
+		m_iBack = m_iMiddle.exchange(m_iBack | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Take the most recently published buffer. Returns false if nothing
+	// new has been published since the last call.
+	bool Consume() {
+		if (!(m_iMiddle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		m_iFront = m_iMiddle.exchange(m_iFront, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+private:
+
+	enum { INDEX = 0x03, FRESH = 0x04 };
+
+	T m_Buffers[3];
+
+	// indexes of buffers (middle one is shared, hence atomic)
+	int m_iBack;
+	std::atomic<int> m_iMiddle;
+	int m_iFront;
+
+	CTripleBuffer(const CTripleBuffer &);
+	CTripleBuffer &operator=(const CTripleBuffer &);
+
+};
+
+#endif
@@ -0,0 +1,80 @@
+// FramePacer.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "FramePacer.h"
+
+
+// length of the statistics window
+static const qint64 windowLength = 1000000000;
+
+
+FramePacer::FramePacer(double budget) :
+		budget(budget),
+		cost(0),
+		nextFrame(0),
+		windowStart(0),
+		windowBusy(0),
+		windowFrames(0),
+		windowDropped(0),
+		fps(0),
+		share(0),
+		dropped(0) {
+	clock.start();
+}
+
+void FramePacer::setBudget(double share) {
+	budget = share;
+}
+
+bool FramePacer::frameDue() {
+
+	qint64 now = clock.nsecsElapsed();
+	updateWindow(now);
+
+	if (now < nextFrame) {
+		++windowDropped;
+		return false;
+	}
+
+	return true;
+}
+
+// In order to keep rendering within the budget, the time between starts of
+// two consecutive frames has to be at least cost / budget. The cost is
+// smoothed, so a single slow frame does not stall the rendering.
+void FramePacer::frameRendered(qint64 nsecs) {
+
+	qint64 now = clock.nsecsElapsed();
+
+	cost = cost ? 0.8 * cost + 0.2 * nsecs : nsecs;
+	if (budget > 0 && budget < 1)
+		nextFrame = now + (qint64)(cost * (1 / budget - 1));
+	else
+		nextFrame = now;
+
+	windowBusy += nsecs;
+	++windowFrames;
+
+	updateWindow(now);
+}
+
+void FramePacer::updateWindow(qint64 now) {
+
+	qint64 elapsed = now - windowStart;
+	if (elapsed < windowLength)
+		return;
+
+	fps = 1e9 * windowFrames / elapsed;
+	share = (double)windowBusy / elapsed;
+	dropped = windowDropped;
+
+	windowStart = now;
+	windowBusy = 0;
+	windowFrames = 0;
+	windowDropped = 0;
+
+}
@@ -0,0 +1,64 @@
+// FramePacer.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Adaptive frame pacing. The cost of every rendered frame is measured, and
+// frames are dropped when rendering would take more than the given share
+// of the time, so the rest is left for the simulation.
+
+#ifndef SMARTSWEEPERSQT_FRAMEPACER_H_
+#define SMARTSWEEPERSQT_FRAMEPACER_H_
+
+#include <QElapsedTimer>
+
+
+class FramePacer {
+
+public:
+
+	explicit FramePacer(double budget = 0.1);
+
+	// maximal share of the time spent on rendering (0, 1]
+	void setBudget(double share);
+
+	// check whether the frame can be rendered now, if not it is dropped
+	bool frameDue();
+
+	// record the cost of the frame which has just been rendered
+	void frameRendered(qint64 nsecs);
+
+	// statistics of the last measurement window
+	double framesPerSecond() const { return fps; }
+	double renderShare() const { return share; }
+	double frameCost() const { return cost / 1e9; }
+	int droppedFrames() const { return dropped; }
+
+private:
+
+	void updateWindow(qint64 now);
+
+	double budget;
+	QElapsedTimer clock;
+
+	// smoothed cost of a single frame and the earliest start of the next
+	// one (both in nanoseconds)
+	double cost;
+	qint64 nextFrame;
+
+	// current measurement window
+	qint64 windowStart;
+	qint64 windowBusy;
+	int windowFrames;
+	int windowDropped;
+
+	double fps;
+	double share;
+	int dropped;
+
+};
+
+#endif
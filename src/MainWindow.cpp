@@ -5,15 +5,31 @@
 //
 // This project is licensed under the terms of the MIT license.
 
+#define _USE_MATH_DEFINES
 #include "MainWindow.h"
 #include "ui_MainWindow.h"
 #include "ui_PreferencesDialog.h"
 #include "ui_StatisticsDialog.h"
 
 #include <QClipboard>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QScrollBar>
 #include <QSettings>
+#include <QThread>
+#include <QWheelEvent>
 
+#include "CCheckpoint.h"
+#include "CMinesweeper.h"
+#include "CProfiler.h"
 #include "SceneController.h"
+#include "StatisticsModel.h"
+
+#ifndef M_PI
+// if you want something done, do it yourself...
+#define M_PI (4 * atan(1))
+#endif
 
 
 // initialize static settings storage
@@ -25,56 +41,89 @@ MainWindow::MainWindow(QApplication &app, QWidget *parent) :
 		app(&app),
 		started(false),
 		paused(false),
-		simulation_timerid(0),
 		render_timerid(0),
-		controller(nullptr) {
+		controller(nullptr),
+		statistics(new StatisticsModel(this)) {
 
 	ui->setupUi(this);
 
 	dlgstats = new StatisticsDialog(this);
-	connect(this, SIGNAL(statisticsUpdated()), dlgstats, SLOT(appendNewData()));
 
 	connect(ui->actionStart, SIGNAL(triggered()), this, SLOT(startSimulation()));
 	connect(ui->actionStop, SIGNAL(triggered()), this, SLOT(stopSimulation()));
 	connect(ui->actionPause, SIGNAL(triggered()), this, SLOT(pauseSimulation()));
+	connect(ui->actionRecord, SIGNAL(toggled(bool)), this, SLOT(recordTrajectories(bool)));
+	connect(ui->actionReplay, SIGNAL(triggered()), this, SLOT(openReplay()));
+	connect(ui->actionResume, SIGNAL(triggered()), this, SLOT(resumeCheckpoint()));
+	connect(ui->actionExport, SIGNAL(toggled(bool)), this, SLOT(exportResults(bool)));
 	connect(ui->actionStatistics, SIGNAL(triggered()), this, SLOT(showStatistics()));
 	connect(ui->actionPreferences, SIGNAL(triggered()), this, SLOT(showPreferences()));
 	connect(ui->actionAboutQt, SIGNAL(triggered()), &app, SLOT(aboutQt()));
 
+	// mouse wheel zooms the world view
+	ui->graphicsView->viewport()->installEventFilter(this);
+
 	stopSimulation();
 	resetSettings();
 	loadSettings();
+	updateStatistics();
+	updateProfiler();
 
 }
 
+// The state of the running simulation is saved upon exit, so it can be
+// resumed later. The engine waits for the checkpoint to be written. The
+// profile is captured after the engine has stopped.
 MainWindow::~MainWindow() {
 	saveSettings();
+	if (controller && started && !controller->isReplaying() && s.iCheckpointInterval)
+		controller->saveCheckpoint(dataFile(s.sCheckpointFile, "checkpoint.sscp"));
 	delete controller;
+	if (s.bProfile) {
+		SProfileReport report;
+		CProfiler::Capture(report);
+		CProfiler::WriteJSON(report, QFile::encodeName(dataFile(s.sProfileFile, "profile.json")).toStdString());
+	}
 	delete dlgstats;
 	delete ui;
 }
 
 void MainWindow::startSimulation() {
+	runSimulation(QString());
+}
+
+void MainWindow::runSimulation(const QString &checkpoint) {
 	ui->actionStart->setVisible(false);
 	ui->actionStop->setVisible(true);
 	ui->actionPause->setEnabled(true);
 	started = true;
 	paused = false;
 
-	// reinitialize controller (allow NN reconfiguration)
-
-	delete controller;
-	statistics.clear();
-	dlgstats->clearData();
-
-	QSize size = ui->graphicsView->size();
-	controller = new SceneController(size.width(), size.height());
-	ui->graphicsView->setScene(controller->scene());
-
-	connect(controller, SIGNAL(generationStats(int, double, double)),
-			this, SLOT(updateStats(int, double, double)));
-
-	startSimulationTimer();
+	statistics->clear();
+	// the profile covers the current run only
+	CProfiler::Reset();
+
+	createController();
+	stopReplay();
+
+	ui->graphicsView->fitInView(controller->scene()->sceneRect(), Qt::KeepAspectRatio);
+
+	// threads have to be set up before the population is created
+	controller->setConfig(s);
+	controller->setCyclesPerSecond(s.iCyclesPerSecond);
+	controller->setFramesPerSecond(s.iFramesPerSecond);
+	controller->setRenderBudget(s.iRenderBudget / 100.0);
+	controller->setThreads(s.iNumThreads, s.bPinThreads);
+	controller->setCheckpoints(dataFile(s.sCheckpointFile, "checkpoint.sscp"), s.iCheckpointInterval);
+	// champions are loaded before the population is created
+	updateHallOfFame();
+	if (checkpoint.isEmpty())
+		controller->resetSimulation();
+	else {
+		controller->setWorldSize(s.iWorldWidth, s.iWorldHeight);
+		controller->restoreCheckpoint(checkpoint);
+	}
+	controller->startSimulation();
 	startRenderTimer();
 
 }
@@ -85,7 +134,11 @@ void MainWindow::stopSimulation() {
 	ui->actionPause->setEnabled(false);
 	ui->actionPause->setChecked(false);
 	started = paused = false;
-	stopSimulationTimer();
+	if (controller)
+		controller->pauseSimulation();
+	// the export is stopped, so exported files are complete
+	ui->actionExport->setChecked(false);
+	stopReplay();
 	stopRenderTimer();
 }
 
@@ -93,20 +146,140 @@ void MainWindow::pauseSimulation() {
 	if (started) {
 		paused ^= true;
 		if (paused) {
-			stopSimulationTimer();
+			controller->pauseSimulation();
 			stopRenderTimer();
 		}
 		else {
-			startSimulationTimer();
+			controller->startSimulation();
 			startRenderTimer();
 		}
 	}
 }
 
+// The recording starts with the next generation of the running simulation.
+void MainWindow::recordTrajectories(bool record) {
+
+	if (!record) {
+		if (controller)
+			controller->setRecording(QString(), 0);
+		return;
+	}
+
+	QString filename = QFileDialog::getSaveFileName(this, "Record Trajectories",
+			QString(), "Trajectories (*.sstr);;All Files (*)");
+	if (filename.isEmpty()) {
+		ui->actionRecord->setChecked(false);
+		return;
+	}
+
+	createController();
+	controller->setRecording(filename, s.iRecordInterval);
+
+}
+
+// Statistics of every finished generation (and genomes, if configured) are
+// written into files named after the selected CSV file.
+void MainWindow::exportResults(bool start) {
+
+	if (!start) {
+		if (controller)
+			controller->setExport(QString(), 0, 0, 0);
+		return;
+	}
+
+	QString filename = QFileDialog::getSaveFileName(this, "Export Results",
+			QString(), "CSV Files (*.csv);;All Files (*)");
+	if (filename.isEmpty()) {
+		ui->actionExport->setChecked(false);
+		return;
+	}
+
+	if (filename.endsWith(".csv"))
+		filename.chop(4);
+
+	createController();
+	controller->setExport(filename, s.iExportGenomes, s.iExportTopGenomes,
+			s.iExportKeyframeInterval);
+
+}
+
+// Only the header of the checkpoint is read here - the configuration stored
+// in it replaces current settings, so the restored run is not reconfigured
+// at the next generation. The rest is restored by the engine.
+void MainWindow::resumeCheckpoint() {
+
+	QString filename = QFileDialog::getOpenFileName(this, "Resume from Checkpoint",
+			dataFile(s.sCheckpointFile, "checkpoint.sscp"), "Checkpoints (*.sscp);;All Files (*)");
+	if (filename.isEmpty())
+		return;
+
+	SCheckpointHeader header;
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly) ||
+			file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header) ||
+			!CheckpointValid(header, file.size())) {
+		QMessageBox::warning(this, "Resume from Checkpoint",
+				QString("Unable to resume the simulation from %1").arg(filename));
+		return;
+	}
+
+	static_cast<SSimulationConfig &>(s) = header.config;
+	s.iWorldWidth = header.width;
+	s.iWorldHeight = header.height;
+
+	stopSimulation();
+	runSimulation(filename);
+
+}
+
+void MainWindow::checkpointRestored(bool ok) {
+	if (!ok)
+		QMessageBox::warning(this, "Resume from Checkpoint",
+				"Unable to restore the checkpoint, new simulation has been started");
+}
+
+// The replay is controlled the same way as the simulation, and the slider
+// below the view shows (and sets) the replayed tick.
+void MainWindow::openReplay() {
+
+	QString filename = QFileDialog::getOpenFileName(this, "Open Replay",
+			QString(), "Trajectories (*.sstr);;All Files (*)");
+	if (filename.isEmpty())
+		return;
+
+	stopSimulation();
+	createController();
+
+	if (!controller->startReplay(filename)) {
+		QMessageBox::warning(this, "Open Replay",
+				QString("Unable to replay trajectories from %1").arg(filename));
+		return;
+	}
+
+	ui->replaySlider->setRange(0, controller->replayLength() - 1);
+	ui->replaySlider->setValue(0);
+	ui->replaySlider->setVisible(true);
+
+	ui->actionStart->setVisible(false);
+	ui->actionStop->setVisible(true);
+	ui->actionPause->setEnabled(true);
+	started = true;
+	paused = false;
+
+	ui->graphicsView->fitInView(controller->scene()->sceneRect(), Qt::KeepAspectRatio);
+	controller->setCyclesPerSecond(s.iCyclesPerSecond);
+	controller->setFramesPerSecond(s.iFramesPerSecond);
+	controller->setRenderBudget(s.iRenderBudget / 100.0);
+	controller->startSimulation();
+	startRenderTimer();
+
+}
+
 void MainWindow::updateTimers() {
-	if (simulation_timerid) {
-		stopSimulationTimer();
-		startSimulationTimer();
+	if (controller) {
+		controller->setCyclesPerSecond(s.iCyclesPerSecond);
+		controller->setFramesPerSecond(s.iFramesPerSecond);
+		controller->setRenderBudget(s.iRenderBudget / 100.0);
 	}
 	if (render_timerid) {
 		stopRenderTimer();
@@ -119,9 +292,49 @@ void MainWindow::updateMines() {
 		controller->updateMineObjects(s.iNumMines);
 }
 
-void MainWindow::updateStats(int generation, double bestFitness, double avgeFitness) {
-	statistics.push_back(StatisticData(generation, bestFitness, avgeFitness));
-	emit statisticsUpdated();
+void MainWindow::updateWorld() {
+	if (controller)
+		controller->setWorldSize(s.iWorldWidth, s.iWorldHeight);
+}
+
+// The engine takes a copy of the settings, which is applied at the next
+// generation boundary.
+void MainWindow::updateConfig() {
+	if (controller)
+		controller->setConfig(s);
+}
+
+void MainWindow::updateThreads() {
+	if (controller)
+		controller->setThreads(s.iNumThreads, s.bPinThreads);
+}
+
+void MainWindow::updateStatistics() {
+	statistics->setCapacity(s.iStatisticsRows);
+	statistics->setSpillFile(s.sStatisticsFile);
+}
+
+void MainWindow::updateCheckpoints() {
+	if (controller)
+		controller->setCheckpoints(dataFile(s.sCheckpointFile, "checkpoint.sscp"), s.iCheckpointInterval);
+}
+
+void MainWindow::updateHallOfFame() {
+	if (controller)
+		controller->setHallOfFame(dataFile(s.sHallOfFameFile, "champions.sshf"),
+				s.iHallOfFameSize, s.iHallOfFameSeeds);
+}
+
+// Accumulated values are dropped when the profiler gets enabled, so they do
+// not include time during which phases were not measured.
+void MainWindow::updateProfiler() {
+	if (s.bProfile && !CProfiler::Enabled())
+		CProfiler::Reset();
+	CProfiler::Enable(s.bProfile);
+}
+
+void MainWindow::updateStats(const SGenerationStats &stats) {
+	statistics->append(stats);
 }
 
 void MainWindow::showStatistics() {
@@ -135,20 +348,48 @@ void MainWindow::showPreferences() {
 	dialog.exec();
 }
 
-void MainWindow::startSimulationTimer() {
-	if (!simulation_timerid) {
-		if (s.iCyclesPerSecond)
-			simulation_timerid = startTimer(1000 / s.iCyclesPerSecond);
-		else
-			simulation_timerid = startTimer(0);
-	}
+// The controller (with its engine thread) is created only once. Restart
+// recreates the population in place (NN reconfiguration included), so
+// buffers and graphic items of the previous run are reused.
+void MainWindow::createController() {
+
+	if (controller)
+		return;
+
+	controller = new SceneController(s, s.iWorldWidth, s.iWorldHeight);
+	ui->graphicsView->setScene(controller->scene());
+	// the controller repaints the view by itself (see renderScene())
+	ui->graphicsView->setViewportUpdateMode(QGraphicsView::NoViewportUpdate);
+
+	// only the visible part of the world is rendered, so the scene has to
+	// be updated when the view is scrolled (e.g. when paused)
+	connect(ui->graphicsView->horizontalScrollBar(), SIGNAL(valueChanged(int)),
+			controller, SLOT(renderScene()));
+	connect(ui->graphicsView->verticalScrollBar(), SIGNAL(valueChanged(int)),
+			controller, SLOT(renderScene()));
+
+	connect(controller, SIGNAL(generationStats(SGenerationStats)),
+			this, SLOT(updateStats(SGenerationStats)));
+	connect(controller, SIGNAL(checkpointRestored(bool)),
+			this, SLOT(checkpointRestored(bool)));
+
+	connect(ui->replaySlider, SIGNAL(valueChanged(int)), controller, SLOT(seekReplay(int)));
+	connect(controller, SIGNAL(replayPositionChanged(int)), ui->replaySlider, SLOT(setValue(int)));
+
 }
 
-void MainWindow::stopSimulationTimer() {
-	if (simulation_timerid) {
-		killTimer(simulation_timerid);
-		simulation_timerid = 0;
-	}
+// Files kept between sessions are placed next to the settings file, unless
+// their location is given explicitly.
+QString MainWindow::dataFile(const QString &filename, const QString &name) const {
+	if (!filename.isEmpty())
+		return filename;
+	return QFileInfo(QSettings().fileName()).absolutePath() + "/" + name;
+}
+
+void MainWindow::stopReplay() {
+	ui->replaySlider->setVisible(false);
+	if (controller)
+		controller->stopReplay();
 }
 
 void MainWindow::startRenderTimer() {
@@ -173,19 +414,20 @@ void MainWindow::closeEvent(QCloseEvent *event) {
 	app->quit();
 }
 
-void MainWindow::resizeEvent(QResizeEvent *event) {
-	Q_UNUSED(event);
-	if (controller) {
-		QSize size = ui->graphicsView->size();
-		controller->setViewport(size.width(), size.height());
+bool MainWindow::eventFilter(QObject *object, QEvent *event) {
+	if (object == ui->graphicsView->viewport() && event->type() == QEvent::Wheel) {
+		double factor = static_cast<QWheelEvent *>(event)->delta() > 0 ? 1.25 : 0.8;
+		ui->graphicsView->scale(factor, factor);
+		if (controller)
+			controller->renderScene();
+		return true;
 	}
+	return QMainWindow::eventFilter(object, event);
 }
 
 void MainWindow::timerEvent(QTimerEvent *event) {
-	if (event->timerId() == simulation_timerid)
-		controller->updateSimulation();
 	if (event->timerId() == render_timerid)
-		controller->updateScene();
+		controller->renderFrame();
 }
 
 void MainWindow::loadSettings() {
@@ -194,18 +436,40 @@ void MainWindow::loadSettings() {
 
 	s.iCyclesPerSecond = settings.value("iCyclesPerSecond", s.iCyclesPerSecond).toInt();
 	s.iFramesPerSecond = settings.value("iFramesPerSecond", s.iFramesPerSecond).toInt();
-	s.bMultithreading = settings.value("bMultithreading", s.bMultithreading).toBool();
+	s.iRenderBudget = settings.value("iRenderBudget", s.iRenderBudget).toInt();
+	s.iNumThreads = settings.value("iNumThreads", s.iNumThreads).toInt();
+	s.bPinThreads = settings.value("bPinThreads", s.bPinThreads).toBool();
+	s.bProfile = settings.value("bProfile", s.bProfile).toBool();
+	s.sProfileFile = settings.value("sProfileFile", s.sProfileFile).toString();
+	s.iRecordInterval = settings.value("iRecordInterval", s.iRecordInterval).toInt();
+	s.iStatisticsRows = settings.value("iStatisticsRows", s.iStatisticsRows).toInt();
+	s.sStatisticsFile = settings.value("sStatisticsFile", s.sStatisticsFile).toString();
+	s.iExportGenomes = settings.value("iExportGenomes", s.iExportGenomes).toInt();
+	s.iExportTopGenomes = settings.value("iExportTopGenomes", s.iExportTopGenomes).toInt();
+	s.iExportKeyframeInterval = settings.value("iExportKeyframeInterval", s.iExportKeyframeInterval).toInt();
+	s.iCheckpointInterval = settings.value("iCheckpointInterval", s.iCheckpointInterval).toInt();
+	s.sCheckpointFile = settings.value("sCheckpointFile", s.sCheckpointFile).toString();
+	s.iHallOfFameSize = settings.value("iHallOfFameSize", s.iHallOfFameSize).toInt();
+	s.iHallOfFameSeeds = settings.value("iHallOfFameSeeds", s.iHallOfFameSeeds).toInt();
+	s.sHallOfFameFile = settings.value("sHallOfFameFile", s.sHallOfFameFile).toString();
 
 	s.iNumSweepers = settings.value("iNumSweepers", s.iNumSweepers).toInt();
 	s.iNumMines = settings.value("iNumMines", s.iNumMines).toInt();
 	s.iNumTicks = settings.value("iNumTicks", s.iNumTicks).toInt();
+	s.iControlInterval = settings.value("iControlInterval", s.iControlInterval).toInt();
+	s.bControlOnMineEvent = settings.value("bControlOnMineEvent", s.bControlOnMineEvent).toBool();
+	s.iNumRays = settings.value("iNumRays", s.iNumRays).toInt();
+	s.dRayRange = settings.value("dRayRange", s.dRayRange).toDouble();
+	s.dRayFieldOfView = settings.value("dRayFieldOfView", s.dRayFieldOfView).toDouble();
 	s.dMaxTurnRate = settings.value("dMaxTurnRate", s.dMaxTurnRate).toDouble();
 	s.dMaxSpeed = settings.value("dMaxSpeed", s.dMaxSpeed).toDouble();
 	s.dSweeperScale = settings.value("dSweeperScale", s.dSweeperScale).toDouble();
 	s.dMineScale = settings.value("dMineScale", s.dMineScale).toDouble();
+	s.iWorldWidth = settings.value("iWorldWidth", s.iWorldWidth).toInt();
+	s.iWorldHeight = settings.value("iWorldHeight", s.iWorldHeight).toInt();
 
 	settings.beginGroup("NeuralNetwork");
-	s.iNumInputs = settings.value("iNumInputs", s.iNumInputs).toInt();
+	s.iNumInputs = CMinesweeper::NumberOfInputs(s.iNumRays);
 	s.iNumHiddenLayers = settings.value("iNumHiddenLayers", s.iNumHiddenLayers).toInt();
 	s.iNeuronsPerHiddenLayer = settings.value("iNeuronsPerHiddenLayer", s.iNeuronsPerHiddenLayer).toInt();
 	s.iNumOutputs = settings.value("iNumOutputs", s.iNumOutputs).toInt();
@@ -219,6 +483,8 @@ void MainWindow::loadSettings() {
 	s.dMaxPerturbation = settings.value("dMaxPerturbation", s.dMaxPerturbation).toDouble();
 	s.iNumElite = settings.value("iNumElite", s.iNumElite).toInt();
 	s.iNumCopiesElite = settings.value("iNumCopiesElite", s.iNumCopiesElite).toInt();
+	s.iNumEpisodes = settings.value("iNumEpisodes", s.iNumEpisodes).toInt();
+	s.iEpisodeStatistic = settings.value("iEpisodeStatistic", s.iEpisodeStatistic).toInt();
 	settings.endGroup();
 
 }
@@ -229,18 +495,39 @@ void MainWindow::saveSettings() {
 
 	settings.setValue("iCyclesPerSecond", s.iCyclesPerSecond);
 	settings.setValue("iFramesPerSecond", s.iFramesPerSecond);
-	settings.setValue("bMultithreading", s.bMultithreading);
+	settings.setValue("iRenderBudget", s.iRenderBudget);
+	settings.setValue("iNumThreads", s.iNumThreads);
+	settings.setValue("bPinThreads", s.bPinThreads);
+	settings.setValue("bProfile", s.bProfile);
+	settings.setValue("sProfileFile", s.sProfileFile);
+	settings.setValue("iRecordInterval", s.iRecordInterval);
+	settings.setValue("iStatisticsRows", s.iStatisticsRows);
+	settings.setValue("sStatisticsFile", s.sStatisticsFile);
+	settings.setValue("iExportGenomes", s.iExportGenomes);
+	settings.setValue("iExportTopGenomes", s.iExportTopGenomes);
+	settings.setValue("iExportKeyframeInterval", s.iExportKeyframeInterval);
+	settings.setValue("iCheckpointInterval", s.iCheckpointInterval);
+	settings.setValue("sCheckpointFile", s.sCheckpointFile);
+	settings.setValue("iHallOfFameSize", s.iHallOfFameSize);
+	settings.setValue("iHallOfFameSeeds", s.iHallOfFameSeeds);
+	settings.setValue("sHallOfFameFile", s.sHallOfFameFile);
 
 	settings.setValue("iNumSweepers", s.iNumSweepers);
 	settings.setValue("iNumMines", s.iNumMines);
 	settings.setValue("iNumTicks", s.iNumTicks);
+	settings.setValue("iControlInterval", s.iControlInterval);
+	settings.setValue("bControlOnMineEvent", s.bControlOnMineEvent);
+	settings.setValue("iNumRays", s.iNumRays);
+	settings.setValue("dRayRange", s.dRayRange);
+	settings.setValue("dRayFieldOfView", s.dRayFieldOfView);
 	settings.setValue("dMaxTurnRate", s.dMaxTurnRate);
 	settings.setValue("dMaxSpeed", s.dMaxSpeed);
 	settings.setValue("dSweeperScale", s.dSweeperScale);
 	settings.setValue("dMineScale", s.dMineScale);
+	settings.setValue("iWorldWidth", s.iWorldWidth);
+	settings.setValue("iWorldHeight", s.iWorldHeight);
 
 	settings.beginGroup("NeuralNetwork");
-	settings.setValue("iNumInputs", s.iNumInputs);
 	settings.setValue("iNumHiddenLayers", s.iNumHiddenLayers);
 	settings.setValue("iNeuronsPerHiddenLayer", s.iNeuronsPerHiddenLayer);
 	settings.setValue("iNumOutputs", s.iNumOutputs);
@@ -254,6 +541,8 @@ void MainWindow::saveSettings() {
 	settings.setValue("dMaxPerturbation", s.dMaxPerturbation);
 	settings.setValue("iNumElite", s.iNumElite);
 	settings.setValue("iNumCopiesElite", s.iNumCopiesElite);
+	settings.setValue("iNumEpisodes", s.iNumEpisodes);
+	settings.setValue("iEpisodeStatistic", s.iEpisodeStatistic);
 	settings.endGroup();
 
 }
@@ -262,17 +551,39 @@ void MainWindow::resetSettings() {
 
 	s.iCyclesPerSecond = 60;
 	s.iFramesPerSecond = 10;
-	s.bMultithreading = false;
+	s.iRenderBudget = 10;
+	s.iNumThreads = 1;
+	s.bPinThreads = false;
+	s.bProfile = false;
+	s.sProfileFile = QString();
+	s.iRecordInterval = 1;
+	s.iStatisticsRows = 100000;
+	s.sStatisticsFile = QString();
+	s.iExportGenomes = ExportGenomesNone;
+	s.iExportTopGenomes = 10;
+	s.iExportKeyframeInterval = 50;
+	s.iCheckpointInterval = 10;
+	s.sCheckpointFile = QString();
+	s.iHallOfFameSize = 20;
+	s.iHallOfFameSeeds = 10;
+	s.sHallOfFameFile = QString();
 
 	s.iNumSweepers = 30;
 	s.iNumMines = 40;
 	s.iNumTicks = 2000;
+	s.iControlInterval = 1;
+	s.bControlOnMineEvent = false;
+	s.iNumRays = 0;
+	s.dRayRange = 100;
+	s.dRayFieldOfView = M_PI;
 	s.dMaxTurnRate = 0.3;
 	s.dMaxSpeed = 2;
 	s.dSweeperScale = 5;
 	s.dMineScale = 2;
+	s.iWorldWidth = 800;
+	s.iWorldHeight = 600;
 
-	s.iNumInputs = 4;
+	s.iNumInputs = CMinesweeper::NumberOfInputs(s.iNumRays);
 	s.iNumHiddenLayers = 1;
 	s.iNeuronsPerHiddenLayer = 6;
 	s.iNumOutputs = 2;
@@ -284,6 +595,8 @@ void MainWindow::resetSettings() {
 	s.dMaxPerturbation = 0.3;
 	s.iNumElite = 4;
 	s.iNumCopiesElite = 1;
+	s.iNumEpisodes = 1;
+	s.iEpisodeStatistic = EpisodeStatisticMean;
 
 }
 
@@ -298,9 +611,11 @@ PreferencesDialog::PreferencesDialog(MainWindow *mainwindow) :
 	connect(ui->buttonBox, SIGNAL(clicked(QAbstractButton *)),
 			this, SLOT(buttonAction(QAbstractButton *)));
 
-#if ! WITH_OPENMP
-	ui->multithreading->hide();
-#endif
+	// the number of NN inputs follows the number of sensors
+	connect(ui->numRays, SIGNAL(valueChanged(int)),
+			this, SLOT(updateNumInputs(int)));
+
+	ui->numThreads->setMaximum(QThread::idealThreadCount() * 4);
 
 	loadSettings();
 
@@ -326,17 +641,39 @@ void PreferencesDialog::applySettings() {
 
 	mainwindow->s.iCyclesPerSecond = ui->cyclesPerSecond->value();
 	mainwindow->s.iFramesPerSecond = ui->framesPerSecond->value();
-	mainwindow->s.bMultithreading = ui->multithreading->isChecked();
+	mainwindow->s.iRenderBudget = ui->renderBudget->value();
+	mainwindow->s.iNumThreads = ui->numThreads->value();
+	mainwindow->s.bPinThreads = ui->pinThreads->isChecked();
+	mainwindow->s.bProfile = ui->profile->isChecked();
+	mainwindow->s.sProfileFile = ui->profileFile->text();
+	mainwindow->s.iRecordInterval = ui->recordInterval->value();
+	mainwindow->s.iStatisticsRows = ui->statisticsRows->value();
+	mainwindow->s.sStatisticsFile = ui->statisticsFile->text();
+	mainwindow->s.iExportGenomes = ui->exportGenomes->currentIndex();
+	mainwindow->s.iExportTopGenomes = ui->exportTopGenomes->value();
+	mainwindow->s.iExportKeyframeInterval = ui->exportKeyframeInterval->value();
+	mainwindow->s.iCheckpointInterval = ui->checkpointInterval->value();
+	mainwindow->s.sCheckpointFile = ui->checkpointFile->text();
+	mainwindow->s.iHallOfFameSize = ui->hallOfFameSize->value();
+	mainwindow->s.iHallOfFameSeeds = ui->hallOfFameSeeds->value();
+	mainwindow->s.sHallOfFameFile = ui->hallOfFameFile->text();
 
 	mainwindow->s.iNumSweepers = ui->numSweepers->value();
 	mainwindow->s.iNumMines = ui->numMines->value();
 	mainwindow->s.iNumTicks = ui->numTicks->value();
+	mainwindow->s.iControlInterval = ui->controlInterval->value();
+	mainwindow->s.bControlOnMineEvent = ui->controlOnMineEvent->isChecked();
+	mainwindow->s.iNumRays = ui->numRays->value();
+	mainwindow->s.dRayRange = ui->rayRange->value();
+	mainwindow->s.dRayFieldOfView = ui->rayFieldOfView->value();
 	mainwindow->s.dMaxTurnRate = ui->maxTurnRate->value();
 	mainwindow->s.dMaxSpeed = ui->maxSpeed->value();
 	mainwindow->s.dSweeperScale = ui->sweeperScale->value();
 	mainwindow->s.dMineScale = ui->mineScale->value();
+	mainwindow->s.iWorldWidth = ui->worldWidth->value();
+	mainwindow->s.iWorldHeight = ui->worldHeight->value();
 
-	mainwindow->s.iNumInputs = ui->numInputs->value();
+	mainwindow->s.iNumInputs = CMinesweeper::NumberOfInputs(ui->numRays->value());
 	mainwindow->s.iNumHiddenLayers = ui->numHiddenLayers->value();
 	mainwindow->s.iNeuronsPerHiddenLayer = ui->neuronsPerHiddenLayer->value();
 	mainwindow->s.iNumOutputs = ui->numOutputs->value();
@@ -348,10 +685,23 @@ void PreferencesDialog::applySettings() {
 	mainwindow->s.dMaxPerturbation = ui->maxPerturbation->value();
 	mainwindow->s.iNumElite = ui->numElite->value();
 	mainwindow->s.iNumCopiesElite = ui->numCopiesElite->value();
+	mainwindow->s.iNumEpisodes = ui->numEpisodes->value();
+	mainwindow->s.iEpisodeStatistic = ui->episodeStatistic->currentIndex();
 
+	mainwindow->updateConfig();
 	mainwindow->updateTimers();
 	mainwindow->updateMines();
+	mainwindow->updateWorld();
+	mainwindow->updateThreads();
+	mainwindow->updateStatistics();
+	mainwindow->updateCheckpoints();
+	mainwindow->updateHallOfFame();
+	mainwindow->updateProfiler();
+
+}
 
+void PreferencesDialog::updateNumInputs(int rays) {
+	ui->numInputs->setValue(CMinesweeper::NumberOfInputs(rays));
 }
 
 void PreferencesDialog::resetSettings() {
@@ -363,15 +713,37 @@ void PreferencesDialog::loadSettings() {
 
 	ui->cyclesPerSecond->setValue(mainwindow->s.iCyclesPerSecond);
 	ui->framesPerSecond->setValue(mainwindow->s.iFramesPerSecond);
-	ui->multithreading->setChecked(mainwindow->s.bMultithreading);
+	ui->renderBudget->setValue(mainwindow->s.iRenderBudget);
+	ui->numThreads->setValue(mainwindow->s.iNumThreads);
+	ui->pinThreads->setChecked(mainwindow->s.bPinThreads);
+	ui->profile->setChecked(mainwindow->s.bProfile);
+	ui->profileFile->setText(mainwindow->s.sProfileFile);
+	ui->recordInterval->setValue(mainwindow->s.iRecordInterval);
+	ui->statisticsRows->setValue(mainwindow->s.iStatisticsRows);
+	ui->statisticsFile->setText(mainwindow->s.sStatisticsFile);
+	ui->exportGenomes->setCurrentIndex(mainwindow->s.iExportGenomes);
+	ui->exportTopGenomes->setValue(mainwindow->s.iExportTopGenomes);
+	ui->exportKeyframeInterval->setValue(mainwindow->s.iExportKeyframeInterval);
+	ui->checkpointInterval->setValue(mainwindow->s.iCheckpointInterval);
+	ui->checkpointFile->setText(mainwindow->s.sCheckpointFile);
+	ui->hallOfFameSize->setValue(mainwindow->s.iHallOfFameSize);
+	ui->hallOfFameSeeds->setValue(mainwindow->s.iHallOfFameSeeds);
+	ui->hallOfFameFile->setText(mainwindow->s.sHallOfFameFile);
 
 	ui->numSweepers->setValue(mainwindow->s.iNumSweepers);
 	ui->numMines->setValue(mainwindow->s.iNumMines);
 	ui->numTicks->setValue(mainwindow->s.iNumTicks);
+	ui->controlInterval->setValue(mainwindow->s.iControlInterval);
+	ui->controlOnMineEvent->setChecked(mainwindow->s.bControlOnMineEvent);
+	ui->numRays->setValue(mainwindow->s.iNumRays);
+	ui->rayRange->setValue(mainwindow->s.dRayRange);
+	ui->rayFieldOfView->setValue(mainwindow->s.dRayFieldOfView);
 	ui->maxTurnRate->setValue(mainwindow->s.dMaxTurnRate);
 	ui->maxSpeed->setValue(mainwindow->s.dMaxSpeed);
 	ui->sweeperScale->setValue(mainwindow->s.dSweeperScale);
 	ui->mineScale->setValue(mainwindow->s.dMineScale);
+	ui->worldWidth->setValue(mainwindow->s.iWorldWidth);
+	ui->worldHeight->setValue(mainwindow->s.iWorldHeight);
 
 	ui->numInputs->setValue(mainwindow->s.iNumInputs);
 	ui->numHiddenLayers->setValue(mainwindow->s.iNumHiddenLayers);
@@ -385,15 +757,19 @@ void PreferencesDialog::loadSettings() {
 	ui->maxPerturbation->setValue(mainwindow->s.dMaxPerturbation);
 	ui->numElite->setValue(mainwindow->s.iNumElite);
 	ui->numCopiesElite->setValue(mainwindow->s.iNumCopiesElite);
+	ui->numEpisodes->setValue(mainwindow->s.iNumEpisodes);
+	ui->episodeStatistic->setCurrentIndex(mainwindow->s.iEpisodeStatistic);
 
 }
 
 
 StatisticsDialog::StatisticsDialog(MainWindow *mainwindow) :
 		ui(new Ui::StatisticsDialog),
-		mainwindow(mainwindow) {
+		mainwindow(mainwindow),
+		performance_timerid(0) {
 
 	ui->setupUi(this);
+	ui->tableView->setModel(mainwindow->getStatistics());
 
 }
 
@@ -401,44 +777,98 @@ StatisticsDialog::~StatisticsDialog() {
 	delete ui;
 }
 
-void StatisticsDialog::appendNewData() {
-	appendData(mainwindow->getStatistics().back());
-}
+// Selection is walked by its ranges, and the text is taken from the model
+// directly, so there is no list of indexes for every selected cell.
+void StatisticsDialog::keyPressEvent(QKeyEvent *event) {
+	if (event->matches(QKeySequence::Copy)) {
 
-void StatisticsDialog::clearData() {
-	ui->tableWidget->setRowCount(0);
-}
+		const StatisticsModel *model = mainwindow->getStatistics();
+		QItemSelection selection = ui->tableView->selectionModel()->selection();
+
+		QString text;
+		for (auto i = selection.begin(); i != selection.end(); ++i)
+			for (int row = i->top(); row <= i->bottom(); ++row) {
+				if (!text.isEmpty())
+					text += '\n';
+				for (int column = i->left(); column <= i->right(); ++column) {
+					if (column != i->left())
+						text += '\t';
+					text += model->text(row, column);
+				}
+			}
 
-void StatisticsDialog::appendData(const StatisticData &data) {
+		mainwindow->getApplication()->clipboard()->setText(text);
+	}
+}
 
-	int row = ui->tableWidget->rowCount();
-	ui->tableWidget->setRowCount(row + 1);
+void StatisticsDialog::showEvent(QShowEvent *event) {
+	QDialog::showEvent(event);
+	if (!performance_timerid)
+		performance_timerid = startTimer(1000);
+	updatePerformance();
+}
 
-	ui->tableWidget->setItem(row, 0, new QTableWidgetItem(QString::number(data.generation)));
-	ui->tableWidget->setItem(row, 1, new QTableWidgetItem(QString::number(data.bestFitness)));
-	ui->tableWidget->setItem(row, 2, new QTableWidgetItem(QString::number(data.avgeFitness)));
+void StatisticsDialog::hideEvent(QHideEvent *event) {
+	QDialog::hideEvent(event);
+	if (performance_timerid)
+		killTimer(performance_timerid);
+	performance_timerid = 0;
+}
 
+void StatisticsDialog::timerEvent(QTimerEvent *event) {
+	if (event->timerId() == performance_timerid)
+		updatePerformance();
 }
 
-void StatisticsDialog::keyPressEvent(QKeyEvent *event) {
-	if (event->matches(QKeySequence::Copy)) {
+// Phases are listed in rows with totals since the profiler has been reset.
+// Per-thread columns show the share of the wall time which the thread has
+// spent in the phase, so an imbalance between workers is easy to spot.
+void StatisticsDialog::updatePerformance() {
 
-		QModelIndexList cells = ui->tableWidget->selectionModel()->selectedIndexes();
-		qSort(cells); // sort cells by (row, column)
+	if (!CProfiler::Enabled()) {
+		ui->performanceSummary->setText("Profiler is disabled, enable it in Preferences.");
+		ui->performanceTable->setRowCount(0);
+		ui->performanceTable->setColumnCount(0);
+		return;
+	}
 
-		QString text;
-		int currentRow = 0;
-		for (auto i = cells.begin(); i < cells.end(); ++i) {
-			if (!text.isEmpty()) {
-				if (currentRow == (*i).row())
-					text += '\t';
-				else
-					text += '\n';
-			}
-			currentRow = (*i).row();
-			text += (*i).data().toString();
+	SProfileReport report;
+	CProfiler::Capture(report);
+	const double wall = report.dWallTime;
+
+	QString summary = QString("Wall time: %1 s").arg(wall, 0, 'f', 1);
+	for (int i = 0; i < ProfileCounters; ++i)
+		summary += QString(", %1 %2/s").arg(wall ? report.iCounters[i] / wall : 0, 0, 'f', 1)
+			.arg(CProfiler::CounterName(i));
+	ui->performanceSummary->setText(summary);
+
+	QStringList labels;
+	labels << "Calls" << "Total [s]" << "Mean [us]" << "Share";
+	for (auto i = report.vecThreads.begin(); i != report.vecThreads.end(); ++i)
+		labels << QString::fromStdString(i->sName);
+
+	QTableWidget *table = ui->performanceTable;
+	table->setRowCount(ProfilePhases);
+	table->setColumnCount(labels.size());
+	table->setHorizontalHeaderLabels(labels);
+
+	for (int i = 0; i < ProfilePhases; ++i) {
+
+		QStringList cells;
+		cells << QString::number(report.iCalls[i])
+			<< QString::number(report.dTime[i], 'f', 3)
+			<< QString::number(report.iCalls[i] ? report.dTime[i] / report.iCalls[i] * 1e6 : 0, 'f', 2)
+			<< QString("%1%").arg(wall ? report.dTime[i] / wall * 100 : 0, 0, 'f', 1);
+		for (auto j = report.vecThreads.begin(); j != report.vecThreads.end(); ++j)
+			cells << QString("%1%").arg(wall ? j->dTime[i] / wall * 100 : 0, 0, 'f', 1);
+
+		table->setVerticalHeaderItem(i, new QTableWidgetItem(CProfiler::PhaseName(i)));
+		for (int j = 0; j < cells.size(); ++j) {
+			QTableWidgetItem *item = new QTableWidgetItem(cells[j]);
+			item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+			table->setItem(i, j, item);
 		}
 
-		mainwindow->getApplication()->clipboard()->setText(text);
 	}
+
 }
@@ -14,9 +14,11 @@
 #include <QGraphicsScene>
 #include <QKeyEvent>
 #include <QMainWindow>
-#include <QResizeEvent>
+#include <QString>
 #include <QTimerEvent>
-#include <QVector>
+
+#include "CPopulationStats.h"
+#include "SSimulationConfig.h"
 
 
 namespace Ui {
@@ -26,22 +28,9 @@ namespace Ui {
 }
 
 
-// storage structure for our statistics
-struct StatisticData {
-
-	// laziness...
-	StatisticData(int generation = 0, double bestFitness = 0, double avgeFitness = 0) :
-			generation(generation), bestFitness(bestFitness), avgeFitness(avgeFitness) {  }
-
-	int generation;
-	double bestFitness;
-	double avgeFitness;
-
-};
-
-
 class SceneController;
 class StatisticsDialog;
+class StatisticsModel;
 class MainWindow : public QMainWindow {
 	Q_OBJECT
 
@@ -51,62 +40,62 @@ public:
 	~MainWindow();
 
 	QApplication *getApplication() { return app; }
-	const QVector<StatisticData> &getStatistics() { return statistics; }
+	StatisticsModel *getStatistics() { return statistics; }
 
-	// Smart Sweepers Settings
-	static struct SmartSweepersSettings {
+	// Smart Sweepers Settings. Parameters of the simulation engine are
+	// inherited from the configuration structure, the rest is used by the
+	// GUI only.
+	static struct SmartSweepersSettings : SSimulationConfig {
 
 		int iCyclesPerSecond;
 		int iFramesPerSecond;
-		bool bMultithreading;
-
-		// --- used for the neural network ---
-
-		int iNumInputs;
-		int iNumHiddenLayers;
-		int iNeuronsPerHiddenLayer;
-		int iNumOutputs;
-
-		// for tweaking the sigmoid function
-		double dActivationResponse;
-		// bias value
-		double dBias;
-
-		// --- used to define the sweepers ---
-
-		// limits how fast the sweepers can turn
-		double dMaxTurnRate;
-
-		double dMaxSpeed;
-
-		// for controlling the size
-		double dSweeperScale;
-		double dMineScale;
-
-		// --- controller parameters ---
 
-		int iNumSweepers;
-		int iNumMines;
-
-		// number of time steps we allow for each generation to live
-		int iNumTicks;
-
-		// --- GA parameters ---
-
-		// probability of chromosones crossing over bits
-		// 0.7 is pretty good
-		double dCrossoverRate;
-
-		// probability that a chromosones bits will mutate
-		// try figures around 0.05 to 0.3
-		double dMutationRate;
-
-		// the maximum amount the GA may mutate each weight by
-		double dMaxPerturbation;
-
-		// used for elitism
-		int iNumElite;
-		int iNumCopiesElite;
+		// maximal share of the time (in percents) spent on rendering, frames
+		// are dropped in order to stay within this limit
+		int iRenderBudget;
+
+		// number of simulation threads (0 for one thread per CPU), and
+		// whether to bind these threads to CPUs
+		int iNumThreads;
+		bool bPinThreads;
+
+		// whether to measure the time spent in simulation phases, and the
+		// JSON report written upon exit (empty for the one next to the
+		// settings file)
+		bool bProfile;
+		QString sProfileFile;
+
+		// every n-th generation is recorded when recording trajectories
+		int iRecordInterval;
+
+		// number of generations kept in the statistics table (0 for no limit), and
+		// the file to which older generations are moved (empty to drop them)
+		int iStatisticsRows;
+		QString sStatisticsFile;
+
+		// genomes exported with statistics (see ExportGenomes), the number of
+		// the fittest genomes and every n-th generation of the history which
+		// is stored as the keyframe
+		int iExportGenomes;
+		int iExportTopGenomes;
+		int iExportKeyframeInterval;
+
+		// every n-th generation is saved into the checkpoint (0 for never), and
+		// the checkpoint file (empty for the one next to the settings file)
+		int iCheckpointInterval;
+		QString sCheckpointFile;
+
+		// number of champions kept for every NN topology (0 disables the hall
+		// of fame), the share (in percents) of the initial population taken
+		// from champions, and the hall of fame file (empty for the one next to
+		// the settings file)
+		int iHallOfFameSize;
+		int iHallOfFameSeeds;
+		QString sHallOfFameFile;
+
+		// dimensions of the world (independent of the viewport)
+		int iWorldWidth;
+		int iWorldHeight;
 
 	} s;
 
@@ -116,9 +105,22 @@ public slots:
 	virtual void stopSimulation();
 	virtual void pauseSimulation();
 
+	virtual void recordTrajectories(bool record);
+	virtual void openReplay();
+	virtual void exportResults(bool start);
+	virtual void resumeCheckpoint();
+	virtual void checkpointRestored(bool ok);
+
 	virtual void updateTimers();
 	virtual void updateMines();
-	virtual void updateStats(int generation, double bestFitness, double avgeFitness);
+	virtual void updateWorld();
+	virtual void updateConfig();
+	virtual void updateThreads();
+	virtual void updateStatistics();
+	virtual void updateCheckpoints();
+	virtual void updateHallOfFame();
+	virtual void updateProfiler();
+	virtual void updateStats(const SGenerationStats &stats);
 
 	virtual void showStatistics();
 	virtual void showPreferences();
@@ -127,20 +129,19 @@ public slots:
 	virtual void saveSettings();
 	virtual void resetSettings();
 
-signals:
-
-	// signalize new data in our stats container
-	void statisticsUpdated();
-
 protected:
 
-	void startSimulationTimer();
-	void stopSimulationTimer();
+	void createController();
+	// start the simulation anew, or from the given checkpoint
+	void runSimulation(const QString &checkpoint);
+	QString dataFile(const QString &filename, const QString &name) const;
+	void stopReplay();
+
 	void startRenderTimer();
 	void stopRenderTimer();
 
 	void closeEvent(QCloseEvent *event);
-	void resizeEvent(QResizeEvent *event);
+	bool eventFilter(QObject *object, QEvent *event);
 	void timerEvent(QTimerEvent *event);
 
 private:
@@ -152,14 +153,13 @@ private:
 	bool started;
 	bool paused;
 
-	int simulation_timerid;
 	int render_timerid;
 
 	// sweepers and mines controller handler
 	SceneController *controller;
 
 	// container for statistics for current simulation
-	QVector<StatisticData> statistics;
+	StatisticsModel *statistics;
 
 };
 
@@ -175,6 +175,7 @@ public slots:
 	virtual void buttonAction(QAbstractButton *button);
 	virtual void applySettings();
 	virtual void resetSettings();
+	virtual void updateNumInputs(int rays);
 
 protected:
 	void loadSettings();
@@ -193,18 +194,21 @@ public:
 	explicit StatisticsDialog(MainWindow *mainwindow);
 	~StatisticsDialog();
 
-public slots:
-	virtual void appendNewData();
-	virtual void clearData();
-
 protected:
-	void appendData(const StatisticData &data);
 	void keyPressEvent(QKeyEvent *event);
+	void showEvent(QShowEvent *event);
+	void hideEvent(QHideEvent *event);
+	void timerEvent(QTimerEvent *event);
 
 private:
 	Ui::StatisticsDialog *ui;
 	MainWindow *mainwindow;
 
+	// refresh timer of the performance tab
+	int performance_timerid;
+
+	void updatePerformance();
+
 };
 
 #endif
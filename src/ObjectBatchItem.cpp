@@ -0,0 +1,183 @@
+// ObjectBatchItem.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "ObjectBatchItem.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QColor>
+#include <QSizeF>
+
+
+ObjectBatchItem::ObjectBatchItem(const QPolygonF &outline, int groups, QGraphicsItem *parent) :
+		QGraphicsItem(parent),
+		outline(outline),
+		simplified(outline),
+		pens(groups),
+		level(DetailOutline),
+		batches(groups),
+		objects(0),
+		densityCell(1),
+		densityWidth(0),
+		densityHeight(0),
+		densityDirty(false) {
+}
+
+void ObjectBatchItem::setPen(int group, const QPen &pen) {
+	pens[group] = pen;
+	densityDirty = true;
+	update();
+}
+
+void ObjectBatchItem::setSimplifiedOutline(const QPolygonF &outline) {
+	simplified = outline;
+}
+
+void ObjectBatchItem::setBounds(const QRectF &rect) {
+	if (rect == bounds)
+		return;
+	prepareGeometryChange();
+	bounds = rect;
+}
+
+void ObjectBatchItem::setDetail(Detail detail, const QRectF &area, double cell) {
+
+	level = detail;
+
+	if (level == DetailDensity) {
+		densityArea = area;
+		densityCell = cell;
+		densityWidth = std::max(1, (int)ceil(area.width() / cell));
+		densityHeight = std::max(1, (int)ceil(area.height() / cell));
+	}
+
+}
+
+int ObjectBatchItem::segments(Detail detail) const {
+	switch (detail) {
+	case DetailOutline:
+		return outline.size();
+	case DetailSimplified:
+		return simplified.size();
+	case DetailPoint:
+		return 1;
+	case DetailDensity:
+		break;
+	}
+	return 0;
+}
+
+void ObjectBatchItem::clear() {
+
+	for (int i = 0; i < batches.size(); ++i)
+		batches[i].resize(0);
+	objects = 0;
+
+	if (level == DetailDensity) {
+		density.fill(0, densityWidth * densityHeight);
+		densityDirty = true;
+	}
+	else if (!density.isEmpty()) {
+		// release the map, it might be quite large
+		density = QVector<int>();
+		densityImage = QImage();
+	}
+
+	update();
+}
+
+// Transform the outline into the scene coordinates the same way as the
+// QGraphicsItem would do it for setPos(), setRotation() and setScale().
+void ObjectBatchItem::addObject(double x, double y, double rotation, double scale, int group) {
+
+	++objects;
+
+	if (level == DetailPoint) {
+		batches[group].push_back(QPointF(x, y));
+		return;
+	}
+
+	if (level == DetailDensity) {
+		int cx = floor((x - densityArea.left()) / densityCell);
+		int cy = floor((y - densityArea.top()) / densityCell);
+		if (cx >= 0 && cx < densityWidth && cy >= 0 && cy < densityHeight)
+			++density[cy * densityWidth + cx];
+		return;
+	}
+
+	const QPolygonF &shape = level == DetailSimplified ? simplified : outline;
+	const double c = scale * cos(rotation);
+	const double s = scale * sin(rotation);
+	const int size = shape.size();
+
+	QVector<QPointF> &batch = batches[group];
+	int offset = batch.size();
+	batch.resize(offset + 2 * size);
+	QPointF *lines = batch.data() + offset;
+
+	for (int i = 0; i < size; ++i) {
+		const QPointF &p = shape[i];
+		QPointF point(x + c * p.x() - s * p.y(), y + s * p.x() + c * p.y());
+		// every vertex ends one segment and begins the next one
+		lines[2 * i] = point;
+		lines[(2 * i + 2 * size - 1) % (2 * size)] = point;
+	}
+
+}
+
+// Cells are painted with the color of the first pen and the opacity which
+// grows with the logarithm of the number of objects in a cell, so sparse
+// areas are still visible next to dense clusters.
+void ObjectBatchItem::updateDensityImage() {
+
+	densityDirty = false;
+
+	if (densityImage.width() != densityWidth || densityImage.height() != densityHeight)
+		densityImage = QImage(densityWidth, densityHeight, QImage::Format_ARGB32);
+
+	int max = 0;
+	for (int i = 0; i < density.size(); ++i)
+		max = std::max(max, density[i]);
+
+	QColor color = pens[0].color();
+	const double norm = max ? 1 / log(1.0 + max) : 0;
+
+	for (int y = 0; y < densityHeight; ++y) {
+		QRgb *line = reinterpret_cast<QRgb *>(densityImage.scanLine(y));
+		const int *cells = density.constData() + y * densityWidth;
+		for (int x = 0; x < densityWidth; ++x) {
+			color.setAlphaF(cells[x] ? 0.2 + 0.8 * log(1.0 + cells[x]) * norm : 0);
+			line[x] = color.rgba();
+		}
+	}
+
+}
+
+void ObjectBatchItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+	Q_UNUSED(option);
+	Q_UNUSED(widget);
+
+	if (level == DetailDensity) {
+		if (densityDirty)
+			updateDensityImage();
+		painter->drawImage(QRectF(densityArea.topLeft(),
+					QSizeF(densityWidth * densityCell, densityHeight * densityCell)), densityImage);
+		return;
+	}
+
+	for (int i = 0; i < batches.size(); ++i) {
+		if (batches[i].isEmpty())
+			continue;
+		painter->setPen(pens[i]);
+		if (level == DetailPoint)
+			painter->drawPoints(batches[i].constData(), batches[i].size());
+		else
+			painter->drawLines(batches[i].constData(), batches[i].size() / 2);
+	}
+
+}
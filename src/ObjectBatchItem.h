@@ -0,0 +1,108 @@
+// ObjectBatchItem.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Graphic item which renders a whole class of objects sharing the same
+// outline. Objects are transformed into the scene coordinates when they are
+// added, and all of them are painted with a single draw call per pen, so the
+// scene does not have to track thousands of separate items. Objects can be
+// rendered with a lower level of detail, when they are small on the screen.
+
+#ifndef SMARTSWEEPERSQT_OBJECTBATCHITEM_H_
+#define SMARTSWEEPERSQT_OBJECTBATCHITEM_H_
+
+#include <QGraphicsItem>
+#include <QImage>
+#include <QPainter>
+#include <QPen>
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+#include <QStyleOptionGraphicsItem>
+#include <QVector>
+
+
+class ObjectBatchItem : public QGraphicsItem {
+
+public:
+
+	enum Detail {
+		// the full outline
+		DetailOutline,
+		// the simplified outline (if set)
+		DetailSimplified,
+		// single point per object
+		DetailPoint,
+		// density map of objects
+		DetailDensity,
+	};
+
+	// objects are split into the given number of groups, each one painted
+	// with its own pen (groups with higher index are painted on top)
+	explicit ObjectBatchItem(const QPolygonF &outline, int groups = 1, QGraphicsItem *parent = 0);
+
+	void setPen(int group, const QPen &pen);
+
+	// outline used for the DetailSimplified level
+	void setSimplifiedOutline(const QPolygonF &outline);
+
+	// rectangle which contains all objects (e.g. the world extended by the
+	// maximal object extent)
+	void setBounds(const QRectF &rect);
+
+	// Set the level of detail for objects added to the batch, it shall be
+	// called before the clear(). The density map covers the given area with
+	// cells of the given size.
+	void setDetail(Detail detail, const QRectF &area = QRectF(), double cell = 1);
+
+	Detail detail() const { return level; }
+
+	// number of segments per object drawn with the given level of detail
+	int segments(Detail detail) const;
+
+	// remove all objects from the batch (memory is kept for the next frame)
+	void clear();
+
+	// add an object with the given position, rotation (in radians) and scale
+	void addObject(double x, double y, double rotation, double scale, int group = 0);
+
+	// number of objects in the batch
+	int count() const { return objects; }
+
+	QRectF boundingRect() const { return bounds; }
+	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
+
+private:
+
+	void updateDensityImage();
+
+	QPolygonF outline;
+	QPolygonF simplified;
+	QRectF bounds;
+	QVector<QPen> pens;
+
+	Detail level;
+
+	// Outline segments of all objects in the scene coordinates, stored as
+	// pairs of points (one vector per group), so they can be passed to the
+	// QPainter::drawLines() directly. With the DetailPoint level there is
+	// one point per object.
+	QVector<QVector<QPointF> > batches;
+	int objects;
+
+	// density map (number of objects per cell) and its rendered image
+	QRectF densityArea;
+	double densityCell;
+	int densityWidth;
+	int densityHeight;
+	QVector<int> density;
+	QImage densityImage;
+	bool densityDirty;
+
+};
+
+#endif
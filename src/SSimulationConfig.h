@@ -0,0 +1,89 @@
+// SSimulationConfig.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Parameters of the simulation engine. The engine works on its own copy of
+// this structure, which is not modified during the generation, so values
+// can be kept in registers across the hot loops, and many simulations with
+// different parameters can be run in one process.
+
+#ifndef SMARTSWEEPERSQT_SSIMULATIONCONFIG_H_
+#define SMARTSWEEPERSQT_SSIMULATIONCONFIG_H_
+
+
+struct SSimulationConfig {
+
+	// --- used for the neural network ---
+
+	// derived from the number of sensors
+	int iNumInputs;
+	int iNumHiddenLayers;
+	int iNeuronsPerHiddenLayer;
+	int iNumOutputs;
+
+	// for tweaking the sigmoid function
+	double dActivationResponse;
+	// bias value
+	double dBias;
+
+	// --- used to define the sweepers ---
+
+	// limits how fast the sweepers can turn
+	double dMaxTurnRate;
+
+	double dMaxSpeed;
+
+	// for controlling the size
+	double dSweeperScale;
+	double dMineScale;
+
+	// --- controller parameters ---
+
+	int iNumSweepers;
+	int iNumMines;
+
+	// number of time steps we allow for each generation to live
+	int iNumTicks;
+
+	// number of ticks between sweepers brain updates, in between the track
+	// forces are held fixed (optionally brain is updated upon mine event)
+	int iControlInterval;
+	bool bControlOnMineEvent;
+
+	// ray sensors: number of rays (0 disables them), their range and the field
+	// of view (in radians) across which rays are spread
+	int iNumRays;
+	double dRayRange;
+	double dRayFieldOfView;
+
+	// --- GA parameters ---
+
+	// probability of chromosones crossing over bits
+	// 0.7 is pretty good
+	double dCrossoverRate;
+
+	// probability that a chromosones bits will mutate
+	// try figures around 0.05 to 0.3
+	double dMutationRate;
+
+	// the maximum amount the GA may mutate each weight by
+	double dMaxPerturbation;
+
+	// used for elitism
+	int iNumElite;
+	int iNumCopiesElite;
+
+	// number of independent episodes each genome is evaluated in, when
+	// set to 1 all genomes share the single (displayed) mine field
+	int iNumEpisodes;
+
+	// statistic of the episodes fitness used as the genome fitness
+	int iEpisodeStatistic;
+
+};
+
+#endif
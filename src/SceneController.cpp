@@ -5,16 +5,16 @@
 //
 // This project is licensed under the terms of the MIT license.
 
-#define _USE_MATH_DEFINES
 #include "SceneController.h"
 
-#include "MainWindow.h"
-#include "utils.h"
+#include <cmath>
+#include <cstdlib>
 
-#ifndef M_PI
-// if you want something done, do it yourself...
-#define M_PI (4 * atan(1))
-#endif
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGraphicsView>
+#include <QImage>
+#include <QPainter>
 
 
 // graphic object templates centered at (0, 0)
@@ -29,22 +29,31 @@ const QPointF objectSweeperPoints[] = {
 	QPointF(-0.4, -0.1), QPointF(-0.4, 1), QPointF(-1, 1),
 	QPointF(-1, -1), QPointF(-0.4, -1), QPointF(-0.4, -0.5),
 };
+// oriented triangle used when sweepers are small on the screen
+const QPointF objectSweeperTrianglePoints[] = {
+	QPointF(-1, -1), QPointF(1, -1), QPointF(0, 1.7),
+};
+
+// Maximal number of line segments (or points) drawn in a single frame for
+// each class of objects. Above that, lower level of detail is used, so the
+// frame cost does not grow with the number of objects.
+const int maxSegmentsPerFrame = 200000;
 
 
-// Initialize the sweepers, their brains and the GA factory.
-SceneController::SceneController(int width, int height, QObject *parent) :
+// Initialize the scene and start the simulation engine thread. Note, that
+// the population is not created until the resetSimulation() is called, and
+// the simulation is not running until the startSimulation() is called.
+SceneController::SceneController(const SSimulationConfig &config, int width, int height, QObject *parent) :
 		QObject(parent),
 		gs(new QGraphicsScene(0, 0, width, height)),
 		gsInfo(new QGraphicsSimpleTextItem),
 		gsDefaultPen(),
 		gsElitePen(Qt::red),
 		gsMinePen(Qt::green),
-		vpWidth(width),
-		vpHeight(height),
-		m_pGA(nullptr),
-		m_bInternalError(false),
-		m_iTicks(0),
-		m_iGenerations(0) {
+		m_pEngine(new SimulationThread(config, width, height)),
+		replayRunning(false),
+		replayCyclesPerSecond(0),
+		replayTicks(0) {
 
 	// MSVC does not support the std::initializer_list, so this is the only way
 	// to create our object templates and be platform independent...
@@ -58,249 +67,532 @@ SceneController::SceneController(int width, int height, QObject *parent) :
 	gsElitePen.setCosmetic(true);
 	gsMinePen.setCosmetic(true);
 
-	gs->addItem(gsInfo);
+	// objects are painted in batches which change upon every frame, so there
+	// is nothing to be gained from the scene index
+	gs->setItemIndexMethod(QGraphicsScene::NoIndex);
 
-	// let's create the minesweepers
-	for (int i = MainWindow::s.iNumSweepers; i; --i)
-		vecSweepers.push_back(CMinesweeper(RandFloat() * vpWidth,
-					RandFloat() * vpHeight, RandFloat() * 2 * M_PI));
+	gsMines = new ObjectBatchItem(objectMine);
+	gsMines->setPen(0, gsMinePen);
+	gs->addItem(gsMines);
 
-	// and initial population of mines
-	updateMineObjects(MainWindow::s.iNumMines);
+	// elite sweepers are painted on top of the rest
+	QPolygonF triangle;
+	for (unsigned int i = 0; i < sizeof(objectSweeperTrianglePoints) / sizeof(*objectSweeperTrianglePoints); ++i)
+		triangle.append(objectSweeperTrianglePoints[i]);
 
-	// get the total number of weights used in the sweepers
-	// NN so we can initialize the GA
-	int m_NumWeightsInNN = vecSweepers[0].GetNumberOfWeights();
+	gsSweepers = new ObjectBatchItem(objectSweeper, 2);
+	gsSweepers->setSimplifiedOutline(triangle);
+	gsSweepers->setPen(0, gsDefaultPen);
+	gsSweepers->setPen(1, gsElitePen);
+	gs->addItem(gsSweepers);
 
-	// initialize the Genetic Algorithm class
-	delete m_pGA;
-	m_pGA = new CGenAlg(vecSweepers.size(), m_NumWeightsInNN);
+	// info text is displayed in the top-left corner of the view
+	gsInfo->setFlag(QGraphicsItem::ItemIgnoresTransformations);
+	gsInfo->setZValue(1);
+	gs->addItem(gsInfo);
 
-	// get the weights from the GA and insert into the sweepers brains
-	vecThePopulation = QVector<SGenome>::fromStdVector(m_pGA->GetChromos());
+	// generation statistics are emitted from within the engine thread
+	connect(m_pEngine, SIGNAL(generationStats(SGenerationStats)),
+			this, SIGNAL(generationStats(SGenerationStats)));
+	connect(m_pEngine, SIGNAL(checkpointRestored(bool)),
+			this, SIGNAL(checkpointRestored(bool)));
 
-	for (int i = 0; i < vecThePopulation.size(); i++)
-		vecSweepers[i].PutWeights(vecThePopulation[i].vecWeights);
+	m_pEngine->start();
 
 }
 
 SceneController::~SceneController() {
-	delete m_pGA;
+	m_pEngine->stop();
+	delete m_pEngine;
 	delete gsInfo;
+	delete gsSweepers;
+	delete gsMines;
 	delete gs;
 }
 
-void SceneController::setViewport(int width, int height) {
-	vpWidth = width;
-	vpHeight = height;
+void SceneController::setConfig(const SSimulationConfig &config) {
+	m_pEngine->setConfig(config);
+}
+
+void SceneController::setWorldSize(int width, int height) {
 	gs->setSceneRect(0, 0, width, height);
+	m_pEngine->setWorldSize(width, height);
 }
 
 // Synchronize the number of mine objects with the given value.
 void SceneController::updateMineObjects(int number) {
+	m_pEngine->setNumMines(number);
+}
+
+void SceneController::setCyclesPerSecond(int cycles) {
+	m_pEngine->setCyclesPerSecond(cycles);
+	replayCyclesPerSecond = cycles;
+}
 
-	int diff = number - vecMines.size();
+void SceneController::setThreads(int threads, bool pin) {
+	m_pEngine->setThreads(threads, pin);
+}
+
+// Snapshots are published by the engine with the rate at which they are
+// consumed by the renderer.
+void SceneController::setFramesPerSecond(int frames) {
+	m_pEngine->setSnapshotInterval(frames ? 1000 / frames : 0);
+}
 
-	if (diff > 0) {
-		// initialize mines in random positions within the viewport
-		for (int i = diff; i; --i)
-			vecMines.push_back(SVector2D(RandFloat() * vpWidth, RandFloat() * vpHeight));
+// Create a new population using the current settings.
+void SceneController::resetSimulation() {
+	m_pEngine->reset(rand());
+}
+
+void SceneController::startSimulation() {
+
+	if (!replay.isOpen()) {
+		m_pEngine->setRunning(true);
+		return;
 	}
-	else if (diff < 0)
-		vecMines.resize(number);
 
-	// wrap mines around the current viewport
-	for (auto i = vecMines.begin(); i < vecMines.end(); ++i) {
-		i->x = fmod(i->x, vpWidth);
-		i->y = fmod(i->y, vpHeight);
+	// playback of the finished replay starts from the beginning
+	if (replay.position() == replay.length() - 1) {
+		replay.seek(0);
+		emit replayPositionChanged(0);
 	}
 
+	replayRunning = true;
+	replayTicks = 0;
+	replayClock.start();
+
 }
 
-// Update our rendering scene. Note, that displaying is separated form
-// the actual simulation process.
-void SceneController::updateScene() {
+void SceneController::pauseSimulation() {
+	if (replay.isOpen())
+		replayRunning = false;
+	else
+		m_pEngine->setRunning(false);
+}
 
-	if (m_bInternalError)
-		// something goes terribly wrong
+bool SceneController::startReplay(const QString &filename) {
+
+	m_pEngine->setRunning(false);
+	replayRunning = false;
+
+	if (!replay.open(filename))
+		return false;
+
+	renderScene();
+	return true;
+}
+
+void SceneController::stopReplay() {
+
+	if (!replay.isOpen())
 		return;
 
-	{ // synchronize scene mines objects with back-end ones
-		int diff = vecMines.size() - gsMines.size();
-		if (diff > 0) {
-			for (int i = diff; i; --i)
-				gsMines.push_back(gs->addPolygon(objectMine));
-		}
-		else if (diff < 0) {
-			for (int i = diff; i; ++i) {
-				delete gsMines.back();
-				gsMines.pop_back();
-			}
-		}
-	}
+	replay.close();
+	replayRunning = false;
 
-	{ // synchronize scene minesweeper objects with back-end ones
-		int diff = vecSweepers.size() - gsSweepers.size();
-		if (diff > 0) {
-			for (int i = diff; i; --i)
-				gsSweepers.push_back(gs->addPolygon(objectSweeper));
-		}
-		else if (diff < 0) {
-		}
-	}
+	// the latest engine snapshot might have been consumed already, so the
+	// next frame has to be rendered regardless
+	gsVisibleRect = QRectF();
 
-	// update mine positions
-	for (auto i = vecMines.size(); i; --i) {
-		auto object = vecMines[i - 1];
-		auto *item = gsMines[i - 1];
-		item->setPos(object.x, object.y);
-		item->setScale(MainWindow::s.dMineScale);
-		item->setPen(gsMinePen);
+}
+
+void SceneController::seekReplay(int position) {
+	if (replay.isOpen() && position != replay.position()) {
+		replay.seek(position);
+		renderScene();
 	}
+}
 
-	// get the fitness score list and sort it in the descending order
-	// in order to get the fitness threshold value for elite classification
-	QVector<int> fitness;
-	for (auto i = vecSweepers.size(); i; --i)
-		fitness.push_back(vecSweepers[i - 1].Fitness());
-	qSort(fitness.begin(), fitness.end(), qGreater<int>());
-	int fitnessThreshold = fitness[MainWindow::s.iNumElite] + 1;
-
-	// update minesweeper positions, rotations and colors
-	for (auto i = vecSweepers.size(); i; --i) {
-		auto object = vecSweepers[i - 1];
-		auto *item = gsSweepers[i - 1];
-		item->setPos(object.Position().x, object.Position().y);
-		item->setRotation(object.Rotation() * 180 / M_PI);
-		item->setScale(MainWindow::s.dSweeperScale);
-
-		// we want the fittest displayed in a different color
-		if (object.Fitness() >= fitnessThreshold)
-			item->setPen(gsElitePen);
-		else
-			item->setPen(gsDefaultPen);
+// Advance the playback by the number of ticks which would have been
+// simulated since the last frame. With unlimited speed, the replay is
+// advanced by a single tick per frame.
+void SceneController::advanceReplay() {
+
+	if (!replayRunning)
+		return;
+
+	qint64 elapsed = replayClock.restart();
+	if (replayCyclesPerSecond)
+		replayTicks += elapsed * replayCyclesPerSecond / 1000.0;
+	else
+		replayTicks += 1;
+
+	int ticks = floor(replayTicks);
+	if (ticks == 0)
+		return;
+	replayTicks -= ticks;
+
+	int position = replay.position() + ticks;
+	if (position >= replay.length() - 1) {
+		position = replay.length() - 1;
+		replayRunning = false;
 	}
 
-	// update info statistics
-	QString textGeneration = QString("Generation: %1 [TTL: %2]\n")
-		.arg(m_iGenerations).arg(MainWindow::s.iNumTicks - m_iTicks);
-	QString textFitness = QString("Fitness: best: %1, avge: %2\n")
-		.arg(m_pGA->BestFitness()).arg(m_pGA->AverageFitness());
-	QString textElite = QString("Elite threshold: %1\n").arg(fitnessThreshold);
-	gsInfo->setText(textGeneration + textFitness + textElite);
+	replay.seek(position);
+	emit replayPositionChanged(position);
 
 }
 
-// This is the main workhorse. The entire simulation is controlled from here.
-// The comments should explain what is going on adequately.
-void SceneController::updateSimulation() {
+void SceneController::setRecording(const QString &filename, int interval) {
+	m_pEngine->setRecording(QFile::encodeName(filename).constData(), interval);
+}
 
-	// Run the sweepers through iNumTicks amount of cycles. During this loop
-	// each sweepers NN is constantly updated with the appropriate information
-	// from its surroundings. The output from the NN is obtained and the sweeper
-	// is moved. If it encounters a mine its fitness is updated appropriately.
-	if (m_iTicks++ < MainWindow::s.iNumTicks) {
+void SceneController::setExport(const QString &basename, int genomes, int topGenomes,
+		int keyframeInterval) {
+	SExportConfig config;
+	config.sPath = QFile::encodeName(basename).constData();
+	config.iGenomes = genomes;
+	config.iTopGenomes = topGenomes;
+	config.iKeyframeInterval = keyframeInterval;
+	m_pEngine->setExport(config);
+}
 
-		if (MainWindow::s.bMultithreading)
-			// For multi-threaded simulation we are using a helper function,
-			// which incorporates OpenMP instructions.
-			updateSimulationOpenMP();
-		else {
+void SceneController::setCheckpoints(const QString &filename, int interval) {
+	m_pEngine->setCheckpoints(QFile::encodeName(filename).constData(), interval);
+}
+
+void SceneController::saveCheckpoint(const QString &filename) {
+	m_pEngine->saveCheckpoint(QFile::encodeName(filename).constData());
+}
+
+void SceneController::restoreCheckpoint(const QString &filename) {
+	m_pEngine->restoreCheckpoint(QFile::encodeName(filename).constData(), rand());
+}
+
+void SceneController::setHallOfFame(const QString &filename, int capacity, int seedShare) {
+	m_pEngine->setHallOfFame(QFile::encodeName(filename).constData(), capacity, seedShare);
+}
 
-			// NN uses STL (it's not ported into the QTL)
-			auto mines = vecMines.toStdVector();
+void SceneController::setRenderBudget(double share) {
+	pacer.setBudget(share);
+}
 
-			for (int i = 0; i < vecSweepers.size(); ++i) {
+void SceneController::renderFrame() {
+	advanceReplay();
+	if (pacer.frameDue())
+		renderScene();
+}
 
-				int grabHit;
+// The frame cost includes both the update of scene items and the repaint
+// of views, which is forced here instead of being scheduled.
+void SceneController::renderScene() {
 
-				// update the NN and position
-				if (!vecSweepers[i].Update(mines)) {
-					// error in processing the neural net
-					gsInfo->setText("ERROR: Wrong amount of NN inputs!");
-					m_bInternalError = true;
-					return;
-				}
+	QElapsedTimer timer;
+	timer.start();
 
-				// keep minesweepers in our viewport
-				vecSweepers[i].WarpWorld(0, 0, vpWidth, vpHeight);
+	if (!updateScene())
+		return;
 
-				// see if it's found a mine
-				if ((grabHit = vecSweepers[i].CheckForMine(mines, MainWindow::s.dMineScale)) != -1) {
-					// mine found so replace the mine with another at a random position
-					vecMines[grabHit] = SVector2D(RandFloat() * vpWidth, RandFloat() * vpHeight);
-					// we have discovered a mine so increase fitness
-					vecSweepers[i].IncrementFitness();
-				}
+	QList<QGraphicsView *> views = gs->views();
+	for (auto i = views.begin(); i != views.end(); ++i)
+		(*i)->viewport()->repaint();
 
-				// update the chromos fitness score
-				vecThePopulation[i].dFitness = vecSweepers[i].Fitness();
-			}
+	pacer.frameRendered(timer.nsecsElapsed());
 
-		}
+}
 
+// Update our rendering scene. Note, that displaying is separated form
+// the actual simulation process - we are using only the latest snapshot
+// published by the engine thread.
+bool SceneController::updateScene() {
+
+	CProfileScope profile(ProfileScene);
+
+	QRectF visible = visibleRect();
+
+	// the replay takes the place of the engine snapshots
+	auto &snapshots = m_pEngine->snapshots();
+	bool changed = replay.isOpen() ? replay.consume() : snapshots.Consume();
+	if (!changed && visible == gsVisibleRect)
+		// nothing has changed since the last frame
+		return false;
+
+	gsVisibleRect = visible;
+	CProfiler::Count(ProfileFrames);
+	const SRenderSnapshot &snapshot = replay.isOpen() ? replay.snapshot() : snapshots.Front();
+
+	if (snapshot.bError) {
+		// something goes terribly wrong
+		gsInfo->setText("ERROR: Wrong amount of NN inputs!");
+		return true;
 	}
-	// Another generation has been completed.
-	// Time to run the GA and update the sweepers with their new NNs
-	else {
-
-		// run the GA to create a new population
-		// NN uses STL (it's not ported into the QTL)
-		auto population = vecThePopulation.toStdVector();
-		vecThePopulation = QVector<SGenome>::fromStdVector(m_pGA->Epoch(population));
-
-		// emit current generation stats
-		emit generationStats(m_iGenerations,
-				m_pGA->BestFitness(), m_pGA->AverageFitness());
-
-		// insert the new (hopefully) improved brains back into the sweepers
-		for (int i = 0; i < vecSweepers.size(); ++i) {
-			vecSweepers[i].PutWeights(vecThePopulation[i].vecWeights);
-			vecSweepers[i].Respawn();
-		}
 
-		// increment the generation counter
-		++m_iGenerations;
+	// objects are rendered with the configuration of the simulated generation
+	const SSimulationConfig &config = snapshot.config;
+	const double mineScale = config.dMineScale;
+	const double sweeperScale = config.dSweeperScale;
+
+	// objects are culled by their origin, so extend the rectangle by the
+	// maximal object extent
+	double margin = 2 * qMax(sweeperScale, mineScale);
+	QRectF cull = visible.adjusted(-margin, -margin, margin, margin);
+
+	// objects can stick out of the world by their extent
+	QRectF bounds = gs->sceneRect().adjusted(-margin, -margin, margin, margin);
+	gsMines->setBounds(bounds);
+	gsSweepers->setBounds(bounds);
+
+	// level of detail depends on the on-screen size of objects and on their
+	// expected number in the visible part of the world
+	QRectF world = gs->sceneRect();
+	QRectF area = cull.intersected(bounds);
+	double fraction = area.width() * area.height() / (world.width() * world.height());
+	double zoom = viewScale();
+	setDetail(gsMines, 2 * mineScale * zoom, fraction * snapshot.vecMines.size(), area, zoom);
+	setDetail(gsSweepers, 2 * sweeperScale * zoom, fraction * snapshot.vecSweepers.size(), area, zoom);
+
+	// update positions of visible mines
+	gsMines->clear();
+	for (auto i = snapshot.vecMines.begin(); i < snapshot.vecMines.end(); ++i)
+		if (cull.contains(QPointF(i->x, i->y)))
+			gsMines->addObject(i->x, i->y, 0, mineScale);
+
+	// update positions, rotations and colors of visible minesweepers, we want
+	// the fittest displayed in a different color
+	gsSweepers->clear();
+	for (auto i = snapshot.vecSweepers.begin(); i < snapshot.vecSweepers.end(); ++i)
+		if (cull.contains(QPointF(i->x, i->y)))
+			gsSweepers->addObject(i->x, i->y, i->rotation, sweeperScale, i->elite ? 1 : 0);
 
-		// reset cycles
-		m_iTicks = 0;
+	// update info statistics
+	QString textGeneration = QString("Generation: %1 [TTL: %2]\n")
+		.arg(snapshot.iGeneration).arg(snapshot.iTicksLeft);
+	QString textFitness = QString("Fitness: best: %1, avge: %2\n")
+		.arg(snapshot.dBestFitness).arg(snapshot.dAverageFitness);
+	QString textElite = QString("Elite threshold: %1\n").arg(snapshot.iEliteThreshold);
+	unsigned long queries = snapshot.iClosestMineSearches + snapshot.iClosestMineCacheHits;
+	QString textCache = QString("Mine cache: %1% hits, %2 searches avoided\n")
+		.arg(queries ? 100.0 * snapshot.iClosestMineCacheHits / queries : 0, 0, 'f', 1)
+		.arg(snapshot.iClosestMineCacheHits);
+	unsigned long updates = snapshot.iControlUpdates + snapshot.iKinematicUpdates;
+	QString textControl = QString("Control: every %1 ticks, brain updated in %2% of ticks\n")
+		.arg(config.iControlInterval)
+		.arg(updates ? 100.0 * snapshot.iControlUpdates / updates : 0, 0, 'f', 1);
+	QString textEpisodes;
+	if (config.iNumEpisodes > 1)
+		textEpisodes = QString("Episodes: %1 per genome, %2 per second\n")
+			.arg(config.iNumEpisodes).arg(snapshot.dEpisodesPerSecond, 0, 'f', 0);
+	QString textConfig = QString("Config: version %1%2\n").arg(snapshot.iConfigVersion)
+		.arg(snapshot.bConfigPending ? " (update pending)" : "");
+	QString textStartup = QString("Startup: %1 ms to the first tick\n")
+		.arg(snapshot.dStartupTime * 1000, 0, 'f', 0);
+	QString textThreads;
+	if (snapshot.vecThreadUtilization.size() > 1) {
+		textThreads = QString("Threads: %1 [").arg(snapshot.vecThreadUtilization.size());
+		for (auto i = snapshot.vecThreadUtilization.begin(); i != snapshot.vecThreadUtilization.end(); ++i)
+			textThreads += QString(" %1%").arg(100 * *i, 0, 'f', 0);
+		textThreads += " ]\n";
+	}
+	QString textRender = QString("Render: %1 fps, %2 ms per frame, %3 dropped, simulation share: %4%\n")
+		.arg(pacer.framesPerSecond(), 0, 'f', 1)
+		.arg(pacer.frameCost() * 1000, 0, 'f', 1)
+		.arg(pacer.droppedFrames())
+		.arg(100 * (1 - pacer.renderShare()), 0, 'f', 0);
+	QString textRecording;
+	if (snapshot.bRecording)
+		textRecording = QString("Recording: %1 generations, %2 us per tick, overhead: %3%\n")
+			.arg(snapshot.iRecordedGenerations)
+			.arg(snapshot.dRecordingTime * 1e6, 0, 'f', 0)
+			.arg(100 * snapshot.dRecordingOverhead, 0, 'f', 1);
+	QString textExport;
+	if (snapshot.bExporting) {
+		QString textHistory;
+		if (snapshot.dExportCompression)
+			textHistory = QString(", history: %1x smaller, %2 ms to encode")
+				.arg(snapshot.dExportCompression, 0, 'f', 1)
+				.arg(snapshot.dExportEncodeTime * 1e3, 0, 'f', 2);
+		textExport = QString("Export: %1 generations, %2 dropped, queue: %3 (%4 kB), %5 MB/s%6%7\n")
+			.arg(snapshot.iExportedGenerations)
+			.arg(snapshot.iExportDropped)
+			.arg(snapshot.iExportQueue)
+			.arg(snapshot.iExportQueueBytes / 1024)
+			.arg(snapshot.dExportThroughput / 1e6, 0, 'f', 1)
+			.arg(textHistory)
+			.arg(snapshot.bExportError ? ", write error" : "");
+	}
+	QString textCheckpoints;
+	if (snapshot.iCheckpoints || snapshot.bCheckpointError)
+		textCheckpoints = QString("Checkpoints: %1 written, %2 ms to capture, %3 ms to write%4\n")
+			.arg(snapshot.iCheckpoints)
+			.arg(snapshot.dCheckpointTime * 1000, 0, 'f', 0)
+			.arg(snapshot.dCheckpointWriteTime * 1000, 0, 'f', 0)
+			.arg(snapshot.bCheckpointError ? ", write error" : "");
+	QString textHallOfFame;
+	if (snapshot.iHallOfFameChampions || snapshot.iSeededGenomes || snapshot.bHallOfFameError)
+		textHallOfFame = QString("Hall of fame: %1 champions, best: %2, seeded: %3%4\n")
+			.arg(snapshot.iHallOfFameChampions)
+			.arg(snapshot.dHallOfFameBest)
+			.arg(snapshot.iSeededGenomes)
+			.arg(snapshot.bHallOfFameError ? ", file error" : "");
+	QString textProfile;
+	if (CProfiler::Enabled())
+		textProfile = profileText();
+	QString textStatistics;
+	if (snapshot.dStatisticsTime)
+		textStatistics = QString("Statistics: %1 ms per generation\n")
+			.arg(snapshot.dStatisticsTime * 1000, 0, 'f', 2);
+
+	if (snapshot.bReplay) {
+		// engine statistics are not recorded
+		QString textReplay = QString("Replay: tick %1 of %2%3\n")
+			.arg(replay.position() + 1).arg(replay.length())
+			.arg(replayRunning ? "" : " (paused)");
+		gsInfo->setText(textGeneration + textFitness + textElite + textReplay + textRender);
+	}
+	else
+		gsInfo->setText(textGeneration + textFitness + textElite +
+				textCache + textControl + textEpisodes + textConfig +
+				textStartup + textThreads + textStatistics +
+				textRecording + textExport + textCheckpoints + textHallOfFame +
+				textProfile + textRender);
+	gsInfo->setPos(visible.topLeft());
+
+	return true;
+
+}
+
+static QString profileDuration(double seconds) {
+	if (seconds >= 1e-3)
+		return QString("%1 ms").arg(seconds * 1e3, 0, 'f', 2);
+	if (seconds >= 1e-6)
+		return QString("%1 us").arg(seconds * 1e6, 0, 'f', 2);
+	return QString("%1 ns").arg(seconds * 1e9, 0, 'f', 0);
+}
+
+// Rates and phase timings over the last second. The share of the phase is
+// related to the wall time, so phases run by multiple threads can take more
+// than 100%.
+QString SceneController::profileText() {
+
+	if (!profileTimer.isValid() || profileTimer.elapsed() >= 1000) {
+		SProfileReport report;
+		CProfiler::Capture(report);
+		profileInterval = report.Since(profileLast);
+		profileLast = report;
+		profileTimer.start();
+	}
+
+	const double wall = profileInterval.dWallTime;
+	if (!wall)
+		return QString();
 
+	QString text = QString("Profile: %1 ticks/s, %2 generations/s, %3 frames/s\n ")
+		.arg(profileInterval.iCounters[ProfileTicks] / wall, 0, 'f', 0)
+		.arg(profileInterval.iCounters[ProfileGenerations] / wall, 0, 'f', 2)
+		.arg(profileInterval.iCounters[ProfileFrames] / wall, 0, 'f', 1);
+	for (int i = 0; i < ProfilePhases; ++i) {
+		if (!profileInterval.iCalls[i])
+			continue;
+		text += QString(" %1: %2 (%3%)")
+			.arg(QString(CProfiler::PhaseName(i)).replace('_', ' '))
+			.arg(profileDuration(profileInterval.dTime[i] / profileInterval.iCalls[i]))
+			.arg(100 * profileInterval.dTime[i] / wall, 0, 'f', 0);
 	}
 
+	return text + "\n";
 }
 
-void SceneController::updateSimulationOpenMP() {
+// Scale of the scene views (the largest one), i.e. pixels per world unit.
+double SceneController::viewScale() const {
+	double scale = 0;
+	QList<QGraphicsView *> views = gs->views();
+	for (auto i = views.begin(); i != views.end(); ++i)
+		scale = qMax(scale, (*i)->transform().m11());
+	return scale;
+}
 
-	// NN uses STL (it's not ported into the QTL)
-	auto mines = vecMines.toStdVector();
+// Select the level of detail for objects of the given on-screen size (in
+// pixels). Objects smaller than a pixel, or too many to be drawn within the
+// frame budget even as points, are aggregated into a density map with cells
+// of a few pixels.
+void SceneController::setDetail(ObjectBatchItem *item, double size, double objects,
+		const QRectF &area, double zoom) {
 
-	#pragma omp parallel for
-	for (int i = 0; i < vecSweepers.size(); ++i) {
+	const double cell = 4 / qMax(zoom, 1e-6);
 
-		int grabHit;
+	if (size >= 16 && objects * item->segments(ObjectBatchItem::DetailOutline) <= maxSegmentsPerFrame)
+		item->setDetail(ObjectBatchItem::DetailOutline);
+	else if (size >= 4 && objects * item->segments(ObjectBatchItem::DetailSimplified) <= maxSegmentsPerFrame)
+		item->setDetail(ObjectBatchItem::DetailSimplified);
+	else if (size >= 1 && objects <= maxSegmentsPerFrame)
+		item->setDetail(ObjectBatchItem::DetailPoint);
+	else
+		item->setDetail(ObjectBatchItem::DetailDensity, area, cell);
 
-		// update the NN and position
-		if (!vecSweepers[i].Update(mines)) {
-			// error in processing the neural net
-			gsInfo->setText("ERROR: Wrong amount of NN inputs!");
-			m_bInternalError = true;
-			continue;
-		}
+}
 
-		// keep minesweepers in our viewport
-		vecSweepers[i].WarpWorld(0, 0, vpWidth, vpHeight);
+QRectF SceneController::visibleRect() const {
+	QRectF rect;
+	QList<QGraphicsView *> views = gs->views();
+	for (auto i = views.begin(); i != views.end(); ++i)
+		rect |= (*i)->mapToScene((*i)->viewport()->rect()).boundingRect();
+	return rect;
+}
 
-		#pragma omp critical
-		// see if it's found a mine
-		if ((grabHit = vecSweepers[i].CheckForMine(mines, MainWindow::s.dMineScale)) != -1) {
-			// mine found so replace the mine with another at a random position
-			vecMines[grabHit] = SVector2D(RandFloat() * vpWidth, RandFloat() * vpHeight);
-			// we have discovered a mine so increase fitness
-			vecSweepers[i].IncrementFitness();
+// The scene is set up the same way as the one used by the controller, and
+// every frame rebuilds batches from scratch (with the level of detail for
+// the whole world in view), just like the updateScene().
+double SceneController::renderBenchmark(int objects, int frames) {
+
+	const int width = 4000;
+	const int height = 3000;
+
+	QPolygonF mine, sweeper;
+	for (unsigned int i = 0; i < sizeof(objectMinePoints) / sizeof(*objectMinePoints); ++i)
+		mine.append(objectMinePoints[i]);
+	for (unsigned int i = 0; i < sizeof(objectSweeperPoints) / sizeof(*objectSweeperPoints); ++i)
+		sweeper.append(objectSweeperPoints[i]);
+
+	QPen defaultPen, elitePen(Qt::red), minePen(Qt::green);
+	defaultPen.setCosmetic(true);
+	elitePen.setCosmetic(true);
+	minePen.setCosmetic(true);
+
+	QGraphicsScene scene(0, 0, width, height);
+	scene.setItemIndexMethod(QGraphicsScene::NoIndex);
+
+	ObjectBatchItem *mines = new ObjectBatchItem(mine);
+	mines->setPen(0, minePen);
+	mines->setBounds(QRectF(-10, -10, width + 20, height + 20));
+	scene.addItem(mines);
+
+	ObjectBatchItem *sweepers = new ObjectBatchItem(sweeper, 2);
+	sweepers->setPen(0, defaultPen);
+	sweepers->setPen(1, elitePen);
+	sweepers->setBounds(QRectF(-10, -10, width + 20, height + 20));
+	scene.addItem(sweepers);
+
+	QImage image(1280, 960, QImage::Format_ARGB32_Premultiplied);
+	const QRectF world(0, 0, width, height);
+	const double zoom = (double)image.width() / width;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	for (int frame = 0; frame < frames; ++frame) {
+
+		setDetail(mines, 2 * 2 * zoom, objects / 2, world, zoom);
+		setDetail(sweepers, 2 * 5 * zoom, objects / 2, world, zoom);
+		mines->clear();
+		sweepers->clear();
+
+		// objects are scattered over the world and moved between frames
+		for (int i = 0; i < objects; ++i) {
+			double x = fmod(i * 7919.0 + frame * 3, width);
+			double y = fmod(i * 104729.0 / width + frame * 2, height);
+			if (i % 2)
+				mines->addObject(x, y, 0, 2);
+			else
+				sweepers->addObject(x, y, 0.01 * (i + frame), 5, i % 50 == 0);
 		}
 
-		// update the chromos fitness score
-		vecThePopulation[i].dFitness = vecSweepers[i].Fitness();
+		image.fill(Qt::white);
+		QPainter painter(&image);
+		scene.render(&painter);
+		painter.end();
+
 	}
 
+	qint64 elapsed = timer.elapsed();
+	return elapsed ? 1000.0 * frames / elapsed : 0;
 }
@@ -11,15 +11,17 @@
 #ifndef SMARTSWEEPERSQT_SCENECONTROLER_H_
 #define SMARTSWEEPERSQT_SCENECONTROLER_H_
 
+#include <QElapsedTimer>
 #include <QGraphicsScene>
-#include <QGraphicsPolygonItem>
+#include <QGraphicsSimpleTextItem>
 #include <QObject>
 #include <QPolygonF>
-#include <QVector>
 
-#include "CGenAlg.h"
-#include "CMinesweeper.h"
-#include "SVector2D.h"
+#include "CProfiler.h"
+#include "FramePacer.h"
+#include "ObjectBatchItem.h"
+#include "SimulationThread.h"
+#include "TrajectoryReplay.h"
 
 
 class SceneController : public QObject {
@@ -27,35 +29,101 @@ class SceneController : public QObject {
 
 public:
 
-	SceneController(int width = 0, int height = 0, QObject *parent = 0);
+	SceneController(const SSimulationConfig &config, int width, int height, QObject *parent = 0);
 	~SceneController();
 
 	QGraphicsScene *scene() const { return gs; }
 
+	// Render the given number of objects (half mines, half sweepers) into
+	// an offscreen image, and return the number of frames per second.
+	static double renderBenchmark(int objects, int frames);
+
+	// Replay the recorded trajectories instead of the simulation, which is
+	// paused for the time of the replay. Start and pause control playback.
+	bool startReplay(const QString &filename);
+	void stopReplay();
+	bool isReplaying() const { return replay.isOpen(); }
+	int replayLength() const { return replay.length(); }
+
+	// record trajectories into the given file, empty name stops recording
+	void setRecording(const QString &filename, int interval);
+	// export finished generations into files with the given base name (see
+	// SExportConfig), empty name stops the export
+	void setExport(const QString &basename, int genomes, int topGenomes,
+			int keyframeInterval);
+
+	// write checkpoints of every interval-th generation into the given file
+	void setCheckpoints(const QString &filename, int interval);
+	void saveCheckpoint(const QString &filename);
+	// continue the simulation from the checkpoint instead of resetting it
+	void restoreCheckpoint(const QString &filename);
+	// keep champions in the given file, part of every new population (in
+	// percents) is seeded from them
+	void setHallOfFame(const QString &filename, int capacity, int seedShare);
+
 public slots:
 
-	virtual void setViewport(int width, int height);
+	virtual void setConfig(const SSimulationConfig &config);
+	virtual void setWorldSize(int width, int height);
 	virtual void updateMineObjects(int number);
 
-	virtual void updateScene();
-	virtual void updateSimulation();
+	virtual void setCyclesPerSecond(int cycles);
+	virtual void setFramesPerSecond(int frames);
+	virtual void setRenderBudget(double share);
+	virtual void setThreads(int threads, bool pin);
+
+	virtual void resetSimulation();
+	virtual void startSimulation();
+	virtual void pauseSimulation();
+
+	// render the scene if the frame pacing allows it, otherwise the frame
+	// is dropped (this shall be called with the requested frame rate)
+	virtual void renderFrame();
+	// render the scene right away, e.g. when the view has been changed
+	virtual void renderScene();
+
+	virtual void seekReplay(int position);
 
 signals:
 
 	// signal emitted upon current generation life-time end, can be used
 	// to collect simulation statistics
-	void generationStats(int generation, double bestFitness, double avgeFitness);
+	void generationStats(const SGenerationStats &stats);
+
+	// signal emitted when the checkpoint has been restored, if it was not
+	// possible, a new simulation has been started instead
+	void checkpointRestored(bool ok);
+
+	// signal emitted when the replay advances during playback
+	void replayPositionChanged(int position);
 
 protected:
 
-	void updateSimulationOpenMP();
+	void advanceReplay();
+
+	// part of the world visible in the scene views
+	QRectF visibleRect() const;
+
+	// update scene items, returns false if nothing has changed
+	bool updateScene();
+	// overlay lines with the profiler report (it is refreshed every second)
+	QString profileText();
+
+	double viewScale() const;
+	static void setDetail(ObjectBatchItem *item, double size, double objects,
+			const QRectF &area, double zoom);
 
 private:
 
 	QGraphicsScene *gs;
 	QGraphicsSimpleTextItem *gsInfo;
-	QVector<QGraphicsPolygonItem *> gsMines;
-	QVector<QGraphicsPolygonItem *> gsSweepers;
+	// All mines and all sweepers are rendered by a single item each, and
+	// only visible objects are added to these batches.
+	ObjectBatchItem *gsMines;
+	ObjectBatchItem *gsSweepers;
+
+	// visible rectangle used for rendering the last frame
+	QRectF gsVisibleRect;
 
 	// pen used for painting mines and minesweepers
 	QPen gsDefaultPen;
@@ -66,26 +134,26 @@ private:
 	QPolygonF objectMine;
 	QPolygonF objectSweeper;
 
-	// storage for the population of genomes, minesweepers and mines
-	QVector<SGenome> vecThePopulation;
-	QVector<CMinesweeper> vecSweepers;
-	QVector<SVector2D> vecMines;
-
-	// internal viewport dimensions
-	int vpWidth;
-	int vpHeight;
-
-	// pointer to the GA
-	CGenAlg *m_pGA;
-
-	// indicates NN processing error
-	bool m_bInternalError;
-
-	// cycles per generation
-	int m_iTicks;
-
-	// generation counter
-	int m_iGenerations;
+	// Views of the scene are repainted explicitly, so the cost of the whole
+	// frame can be measured and kept within the budget.
+	FramePacer pacer;
+
+	// the last captured profiler report, and the activity since the one
+	// captured before it
+	SProfileReport profileLast;
+	SProfileReport profileInterval;
+	QElapsedTimer profileTimer;
+
+	// simulation engine running in its own thread
+	SimulationThread *m_pEngine;
+
+	// Replay is played with the simulation speed, fractional ticks are
+	// accumulated between frames.
+	TrajectoryReplay replay;
+	bool replayRunning;
+	int replayCyclesPerSecond;
+	double replayTicks;
+	QElapsedTimer replayClock;
 
 };
 
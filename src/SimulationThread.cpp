@@ -0,0 +1,242 @@
+// SimulationThread.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "SimulationThread.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+
+#include "CProfiler.h"
+
+
+SimulationThread::SimulationThread(const SSimulationConfig &config, int width, int height, QObject *parent) :
+		QThread(parent),
+		m_Simulation(config, width, height),
+		m_bCommandsPending(false),
+		m_bRunning(false),
+		m_bQuit(false),
+		m_iCyclesPerSecond(0),
+		m_iSnapshotInterval(0) {
+	// statistics are passed to the GUI thread by the queued connection
+	qRegisterMetaType<SGenerationStats>("SGenerationStats");
+}
+
+SimulationThread::~SimulationThread() {
+	stop();
+}
+
+void SimulationThread::postCommand(const std::function<void()> &command) {
+	QMutexLocker locker(&m_Mutex);
+	m_Commands.push_back(command);
+	m_bCommandsPending = true;
+	m_Condition.wakeOne();
+}
+
+void SimulationThread::setConfig(const SSimulationConfig &config) {
+	postCommand([this, config]() {
+		m_Simulation.SetConfig(config);
+	});
+}
+
+void SimulationThread::setRunning(bool running) {
+	postCommand([this, running]() { m_bRunning = running; });
+}
+
+void SimulationThread::setCyclesPerSecond(int cycles) {
+	postCommand([this, cycles]() { m_iCyclesPerSecond = cycles; });
+}
+
+void SimulationThread::setSnapshotInterval(int msec) {
+	postCommand([this, msec]() { m_iSnapshotInterval = msec; });
+}
+
+// The population is created in the engine thread, so it is allocated by the
+// pool threads which are going to process it.
+void SimulationThread::reset(uint64_t seed) {
+	postCommand([this, seed]() {
+		m_Simulation.Reset(seed);
+		publishSnapshot();
+	});
+}
+
+void SimulationThread::setWorldSize(int width, int height) {
+	postCommand([this, width, height]() {
+		m_Simulation.SetWorldSize(width, height);
+	});
+}
+
+void SimulationThread::setNumMines(int number) {
+	postCommand([this, number]() {
+		m_Simulation.SetNumMines(number);
+		publishSnapshot();
+	});
+}
+
+// The pool is resized in the engine thread, because the calling thread of
+// the pool takes part in the processing (and it might be pinned).
+void SimulationThread::setThreads(int threads, bool pin) {
+	postCommand([this, threads, pin]() {
+		m_Simulation.SetThreads(threads, pin);
+	});
+}
+
+// The recording status is published with snapshots, so the failure of
+// creating the file is visible in the scene.
+void SimulationThread::setRecording(const std::string &path, int interval) {
+	postCommand([this, path, interval]() {
+		if (path.empty())
+			m_Simulation.StopRecording();
+		else
+			m_Simulation.StartRecording(path, interval);
+		publishSnapshot();
+	});
+}
+
+void SimulationThread::setExport(const SExportConfig &config) {
+	postCommand([this, config]() {
+		if (config.sPath.empty())
+			m_Simulation.StopExport();
+		else
+			m_Simulation.StartExport(config);
+		publishSnapshot();
+	});
+}
+
+void SimulationThread::setCheckpoints(const std::string &path, int interval) {
+	postCommand([this, path, interval]() {
+		m_Simulation.SetCheckpoints(path, interval);
+	});
+}
+
+void SimulationThread::saveCheckpoint(const std::string &path) {
+	postCommand([this, path]() {
+		m_Simulation.SaveCheckpoint(path);
+	});
+}
+
+// The checkpoint is restored straight from the memory-mapped file, so it is
+// read only once, by the copy into the simulation buffers.
+void SimulationThread::restoreCheckpoint(const std::string &path, uint64_t seed) {
+	postCommand([this, path, seed]() {
+
+		QFile file(QFile::decodeName(path.c_str()));
+		uchar *data = nullptr;
+		if (file.open(QIODevice::ReadOnly))
+			data = file.map(0, file.size());
+
+		bool ok = data && m_Simulation.RestoreCheckpoint(data, file.size());
+		if (data)
+			file.unmap(data);
+		if (!ok)
+			m_Simulation.Reset(seed);
+
+		publishSnapshot();
+		emit checkpointRestored(ok);
+
+	});
+}
+
+// The load failure is published with the snapshot (the file is not
+// overwritten then).
+void SimulationThread::setHallOfFame(const std::string &path, int capacity, int seedShare) {
+	postCommand([this, path, capacity, seedShare]() {
+		m_Simulation.SetHallOfFame(path, capacity, seedShare);
+		publishSnapshot();
+	});
+}
+
+void SimulationThread::stop() {
+	if (isRunning()) {
+		postCommand([this]() { m_bQuit = true; });
+		wait();
+	}
+}
+
+void SimulationThread::run() {
+
+	CProfiler::SetThreadName("simulation");
+
+	QElapsedTimer clock;
+	clock.start();
+
+	qint64 nextCycle = 0;
+	qint64 nextSnapshot = 0;
+
+	for (;;) {
+
+		// Process pending commands. If the simulation is paused or the next
+		// cycle is not due yet, wait for new commands or for the deadline.
+		// The mutex is not touched at all when running at full speed with
+		// no commands pending.
+		if (m_bCommandsPending || !m_bRunning || m_iCyclesPerSecond) {
+			QMutexLocker locker(&m_Mutex);
+			for (;;) {
+
+				while (!m_Commands.empty()) {
+					std::function<void()> command = m_Commands.front();
+					m_Commands.pop_front();
+					locker.unlock();
+					command();
+					locker.relock();
+				}
+				m_bCommandsPending = false;
+
+				if (m_bQuit)
+					return;
+
+				if (!m_bRunning) {
+					m_Condition.wait(&m_Mutex);
+					continue;
+				}
+
+				qint64 delay = nextCycle - clock.elapsed();
+				if (m_iCyclesPerSecond && delay > 0) {
+					m_Condition.wait(&m_Mutex, delay);
+					continue;
+				}
+
+				break;
+			}
+		}
+
+		if (m_iCyclesPerSecond) {
+			// do not try to catch up if we have been lagging behind
+			qint64 period = 1000 / m_iCyclesPerSecond;
+			nextCycle = qMax(nextCycle + period, clock.elapsed());
+		}
+
+		// when the snapshot is due, the engine fills it in during the cycle,
+		// so there is no separate pass over the population
+		SRenderSnapshot *snapshot = nullptr;
+		if (m_iSnapshotInterval && clock.elapsed() >= nextSnapshot) {
+			nextSnapshot = clock.elapsed() + m_iSnapshotInterval;
+			snapshot = &m_Snapshots.Back();
+		}
+
+		int generation = m_Simulation.Generation();
+		if (!m_Simulation.Update(snapshot)) {
+			// there is no point in running broken simulation
+			m_bRunning = false;
+			publishSnapshot();
+			continue;
+		}
+
+		if (m_Simulation.Generation() != generation)
+			emit generationStats(m_Simulation.GenerationStats());
+
+		if (snapshot)
+			m_Snapshots.Publish();
+
+	}
+
+}
+
+void SimulationThread::publishSnapshot() {
+	m_Simulation.FillSnapshot(m_Snapshots.Back());
+	m_Snapshots.Publish();
+}
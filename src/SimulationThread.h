@@ -0,0 +1,117 @@
+// SimulationThread.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Thread running the simulation engine. The engine state is never accessed
+// from the outside directly - modifications are passed as commands, which
+// are executed between simulation cycles, and the state is published to
+// the renderer by the means of the lock-free triple buffer.
+
+#ifndef SMARTSWEEPERSQT_SIMULATIONTHREAD_H_
+#define SMARTSWEEPERSQT_SIMULATIONTHREAD_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+
+#include <QMetaType>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "CSimulation.h"
+#include "CTripleBuffer.h"
+
+Q_DECLARE_METATYPE(SGenerationStats)
+
+class SimulationThread : public QThread {
+	Q_OBJECT
+
+public:
+
+	SimulationThread(const SSimulationConfig &config, int width, int height, QObject *parent = 0);
+	~SimulationThread();
+
+	// enqueue command for execution in the engine thread
+	void postCommand(const std::function<void()> &command);
+
+	// start a new run with a fresh population
+	void reset(uint64_t seed);
+
+	// the configuration is applied at the next generation boundary
+	void setConfig(const SSimulationConfig &config);
+
+	void setRunning(bool running);
+	void setCyclesPerSecond(int cycles);
+	void setSnapshotInterval(int msec);
+	void setWorldSize(int width, int height);
+	void setNumMines(int number);
+	void setThreads(int threads, bool pin);
+
+	// record trajectories of every interval-th generation into the given
+	// file, empty path stops the recording
+	void setRecording(const std::string &path, int interval);
+
+	// export finished generations, empty path stops (and flushes) the export
+	void setExport(const SExportConfig &config);
+
+	// write the checkpoint of every interval-th generation into the given
+	// file, zero interval disables checkpoints
+	void setCheckpoints(const std::string &path, int interval);
+	// write the checkpoint of the current state right away
+	void saveCheckpoint(const std::string &path);
+	// Continue the simulation saved in the given checkpoint. If it can not be
+	// restored, a new run is started with the given seed instead.
+	void restoreCheckpoint(const std::string &path, uint64_t seed);
+
+	// keep champions in the given file and seed new runs from them
+	void setHallOfFame(const std::string &path, int capacity, int seedShare);
+
+	// stop the thread and wait for it to finish
+	void stop();
+
+	// render snapshots published by the engine
+	CTripleBuffer<SRenderSnapshot> &snapshots() { return m_Snapshots; }
+
+signals:
+
+	// signal emitted upon current generation life-time end
+	void generationStats(const SGenerationStats &stats);
+
+	// signal emitted when the checkpoint has been restored (or not)
+	void checkpointRestored(bool ok);
+
+protected:
+
+	void run();
+
+	void publishSnapshot();
+
+private:
+
+	// simulation engine, accessed only from within the thread
+	CSimulation m_Simulation;
+
+	CTripleBuffer<SRenderSnapshot> m_Snapshots;
+
+	// command queue and the wake-up condition
+	QMutex m_Mutex;
+	QWaitCondition m_Condition;
+	std::deque<std::function<void()>> m_Commands;
+	std::atomic<bool> m_bCommandsPending;
+
+	// engine thread state (modified by commands only)
+	bool m_bRunning;
+	bool m_bQuit;
+	int m_iCyclesPerSecond;
+	int m_iSnapshotInterval;
+
+};
+
+#endif
@@ -0,0 +1,224 @@
+// StatisticsModel.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "StatisticsModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// delay between the first appended row and the notification of views
+static const int flushInterval = 200;
+
+static const char *columnNames[] = {
+	"Generation", "Best Fitness", "Avge Fitness", "Worst Fitness", "Std Dev",
+	"10th Pct", "Median", "90th Pct", "Genome Distance", "Weight Diversity" };
+
+// number of columns stored as floats (all but the generation)
+static const int valueColumns = sizeof(columnNames) / sizeof(*columnNames) - 1;
+
+
+StatisticsModel::StatisticsModel(QObject *parent) :
+		QAbstractTableModel(parent),
+		capacity(0),
+		head(0),
+		rows(0) {
+
+	flushTimer.setSingleShot(true);
+	flushTimer.setInterval(flushInterval);
+	connect(&flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
+}
+
+// The ring buffer is linearized, so the new capacity can be applied by
+// simply dropping the oldest rows.
+void StatisticsModel::setCapacity(int limit) {
+
+	flush();
+
+	if (limit < 0)
+		limit = 0;
+	if (limit == capacity)
+		return;
+
+	if (limit && rows > limit)
+		dropRows(rows - limit);
+
+	QVector<int> gens(rows);
+	QVector<float> vals(rows * valueColumns);
+	for (int i = 0; i < rows; ++i) {
+		gens[i] = generations[slot(i)];
+		std::copy_n(values.constData() + slot(i) * valueColumns, valueColumns,
+				vals.data() + i * valueColumns);
+	}
+
+	generations.swap(gens);
+	values.swap(vals);
+	capacity = limit;
+	head = 0;
+
+}
+
+bool StatisticsModel::setSpillFile(const QString &filename) {
+
+	if (spill.isOpen() && filename == spill.fileName())
+		return true;
+
+	spill.close();
+	if (filename.isEmpty())
+		return true;
+
+	spill.setFileName(filename);
+	return spill.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+}
+
+int StatisticsModel::rowCount(const QModelIndex &parent) const {
+	return parent.isValid() ? 0 : rows;
+}
+
+int StatisticsModel::columnCount(const QModelIndex &parent) const {
+	return parent.isValid() ? 0 : sizeof(columnNames) / sizeof(*columnNames);
+}
+
+QVariant StatisticsModel::data(const QModelIndex &index, int role) const {
+	if (role != Qt::DisplayRole || !index.isValid() || index.row() >= rows)
+		return QVariant();
+	return text(index.row(), index.column());
+}
+
+QVariant StatisticsModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (role != Qt::DisplayRole || orientation != Qt::Horizontal ||
+			section < 0 || section >= columnCount())
+		return QVariant();
+	return QString(columnNames[section]);
+}
+
+QString StatisticsModel::text(int row, int column) const {
+	if (column == 0)
+		return QString::number(generations[slot(row)]);
+	if (column > 0 && column <= valueColumns)
+		return QString::number(values[slot(row) * valueColumns + column - 1]);
+	return QString();
+}
+
+// Values are appended in the order of columns.
+void StatisticsModel::append(const SGenerationStats &stats) {
+
+	pendingGenerations.append(stats.iGeneration);
+	pendingValues.append(stats.dBestFitness);
+	pendingValues.append(stats.dAverageFitness);
+	pendingValues.append(stats.dWorstFitness);
+	pendingValues.append(sqrt(stats.dFitnessVariance));
+	pendingValues.append(stats.dFitnessPercentiles[0]);
+	pendingValues.append(stats.dFitnessPercentiles[2]);
+	pendingValues.append(stats.dFitnessPercentiles[4]);
+	pendingValues.append(stats.dGenomeDistance);
+	pendingValues.append(stats.dWeightDiversity);
+
+	if (!flushTimer.isActive())
+		flushTimer.start();
+
+}
+
+// Start with an empty table, the spill file is truncated as well.
+void StatisticsModel::clear() {
+
+	flushTimer.stop();
+	pendingGenerations.clear();
+	pendingValues.clear();
+
+	beginResetModel();
+	generations.clear();
+	values.clear();
+	head = rows = 0;
+	endResetModel();
+
+	if (spill.isOpen())
+		spill.resize(0);
+
+}
+
+void StatisticsModel::flush() {
+
+	flushTimer.stop();
+
+	int count = pendingGenerations.size();
+	if (count == 0)
+		return;
+
+	// pending rows which would be dropped right away go to the spill file
+	// directly (after older rows), and the rest replaces the whole table
+	const int skip = capacity ? std::max(0, count - capacity) : 0;
+	count -= skip;
+
+	if (capacity && rows + count > capacity)
+		dropRows(rows + count - capacity);
+
+	for (int i = 0; i < skip; ++i)
+		spillRow(pendingGenerations[i], pendingValues.constData() + i * valueColumns);
+
+	beginInsertRows(QModelIndex(), rows, rows + count - 1);
+	for (int i = 0; i < count; ++i)
+		storeRow(rows + i, pendingGenerations[skip + i],
+				pendingValues.constData() + (skip + i) * valueColumns);
+	rows += count;
+	endInsertRows();
+
+	pendingGenerations.clear();
+	pendingValues.clear();
+
+}
+
+// Remove the given number of the oldest rows.
+void StatisticsModel::dropRows(int count) {
+
+	beginRemoveRows(QModelIndex(), 0, count - 1);
+
+	for (int i = 0; i < count; ++i)
+		spillRow(generations[slot(i)], values.constData() + slot(i) * valueColumns);
+
+	head = capacity ? (head + count) % capacity : 0;
+	rows -= count;
+	if (!capacity) {
+		generations.remove(0, count);
+		values.remove(0, count * valueColumns);
+	}
+
+	endRemoveRows();
+
+}
+
+// Dropped rows are written in the same tab-separated format which is used
+// for copying the table into the clipboard.
+void StatisticsModel::spillRow(int generation, const float *fields) {
+
+	if (!spill.isOpen())
+		return;
+
+	QString line = QString::number(generation);
+	for (int i = 0; i < valueColumns; ++i)
+		line += "\t" + QString::number(fields[i]);
+	spill.write((line + "\n").toUtf8());
+
+}
+
+// Rows are stored in order, so the buffer grows until the capacity has been
+// reached, and then it wraps around.
+void StatisticsModel::storeRow(int row, int generation, const float *fields) {
+
+	const int index = slot(row);
+
+	if (index == generations.size()) {
+		generations.append(generation);
+		values.resize(values.size() + valueColumns);
+	}
+	else
+		generations[index] = generation;
+
+	std::copy_n(fields, valueColumns, values.data() + index * valueColumns);
+
+}
@@ -0,0 +1,84 @@
+// StatisticsModel.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Table model with per-generation statistics (see SGenerationStats). Rows
+// are stored in the ring buffer, which might be limited in size - the oldest rows are then
+// dropped (or moved to the text file). Appended rows are announced to views
+// in batches, so the cost of the update does not depend on the generation
+// rate.
+
+#ifndef SMARTSWEEPERSQT_STATISTICSMODEL_H_
+#define SMARTSWEEPERSQT_STATISTICSMODEL_H_
+
+#include <QAbstractTableModel>
+#include <QFile>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include "CPopulationStats.h"
+
+
+class StatisticsModel : public QAbstractTableModel {
+	Q_OBJECT
+
+public:
+
+	explicit StatisticsModel(QObject *parent = 0);
+
+	// maximal number of rows kept in the memory (0 for no limit)
+	void setCapacity(int limit);
+	// rows dropped from the memory are appended to the given file (empty
+	// name disables spilling), returns false if the file can not be opened
+	bool setSpillFile(const QString &filename);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+	// textual representation of the cell, the same as displayed
+	QString text(int row, int column) const;
+
+public slots:
+
+	void append(const SGenerationStats &stats);
+	void clear();
+
+	// announce rows appended since the last call
+	void flush();
+
+protected:
+
+	// position of the given row in the ring buffer
+	int slot(int row) const { return capacity ? (head + row) % capacity : row; }
+
+	void dropRows(int count);
+	void spillRow(int generation, const float *fields);
+	void storeRow(int row, int generation, const float *fields);
+
+private:
+
+	int capacity;
+	int head;
+	int rows;
+
+	// generation numbers and the rest of columns (row by row)
+	QVector<int> generations;
+	QVector<float> values;
+
+	// rows which have not been announced yet
+	QVector<int> pendingGenerations;
+	QVector<float> pendingValues;
+	QTimer flushTimer;
+
+	QFile spill;
+
+};
+
+#endif
@@ -0,0 +1,81 @@
+// TrajectoryReplay.cpp
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+
+#include "TrajectoryReplay.h"
+
+#include <algorithm>
+
+
+TrajectoryReplay::TrajectoryReplay() :
+		data(nullptr),
+		ticks(0),
+		current(0),
+		changed(false) {
+}
+
+TrajectoryReplay::~TrajectoryReplay() {
+	close();
+}
+
+bool TrajectoryReplay::open(const QString &filename) {
+
+	close();
+
+	file.setFileName(filename);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	if ((data = file.map(0, file.size())) == nullptr ||
+			!reader.Open(data, file.size()) || reader.Generations() == 0) {
+		close();
+		return false;
+	}
+
+	for (int i = 0; i < reader.Generations(); ++i) {
+		offsets.append(ticks);
+		ticks += reader.Generation(i).ticks;
+	}
+
+	seek(0);
+	return true;
+}
+
+void TrajectoryReplay::close() {
+
+	if (data)
+		file.unmap(data);
+	data = nullptr;
+	file.close();
+
+	offsets.clear();
+	ticks = 0;
+	current = 0;
+
+}
+
+void TrajectoryReplay::seek(int position) {
+
+	if (!isOpen())
+		return;
+
+	current = qBound(0, position, ticks - 1);
+
+	// the last generation which starts at or before the position
+	int index = std::upper_bound(offsets.begin(), offsets.end(), current) - offsets.begin() - 1;
+	reader.Seek(index, current - offsets[index]);
+	reader.FillSnapshot(frame);
+	frame.bReplay = true;
+
+	changed = true;
+
+}
+
+bool TrajectoryReplay::consume() {
+	bool ret = changed;
+	changed = false;
+	return ret;
+}
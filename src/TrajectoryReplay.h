@@ -0,0 +1,63 @@
+// TrajectoryReplay.h
+// Copyright (c) 2018 Arkadiusz Bokowy
+//
+// This file is a part of smart-sweepers-qt.
+//
+// This project is licensed under the terms of the MIT license.
+//
+// Synopsis:
+// Playback of the recorded trajectories. The recording is memory-mapped,
+// so only the frames which are actually shown are read from the disk, and
+// recorded generations are joined into a single timeline of ticks.
+
+#ifndef SMARTSWEEPERSQT_TRAJECTORYREPLAY_H_
+#define SMARTSWEEPERSQT_TRAJECTORYREPLAY_H_
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "CSimulation.h"
+#include "CTrajectoryReader.h"
+
+
+class TrajectoryReplay {
+
+public:
+
+	TrajectoryReplay();
+	~TrajectoryReplay();
+
+	// open the recording, returns false if it can not be replayed
+	bool open(const QString &filename);
+	void close();
+
+	bool isOpen() const { return data != nullptr; }
+
+	// total number of recorded ticks and the current one
+	int length() const { return ticks; }
+	int position() const { return current; }
+
+	void seek(int position);
+
+	// check whether the snapshot has been changed since the last call
+	bool consume();
+	const SRenderSnapshot &snapshot() const { return frame; }
+
+private:
+
+	QFile file;
+	uchar *data;
+	CTrajectoryReader reader;
+
+	// timeline position of the first tick of every recorded generation
+	QVector<int> offsets;
+	int ticks;
+	int current;
+
+	SRenderSnapshot frame;
+	bool changed;
+
+};
+
+#endif
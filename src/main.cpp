@@ -5,20 +5,344 @@
 //
 // This project is licensed under the terms of the MIT license.
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
 #include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
 
+#include "CGenomeHistory.h"
+#include "CProfiler.h"
+#include "CSimulation.h"
 #include "MainWindow.h"
+#include "SceneController.h"
+
+
+// run the simulation till the end of the current generation
+static bool runGeneration(CSimulation &simulation) {
+	const int generation = simulation.Generation();
+	while (simulation.Generation() == generation)
+		if (!simulation.Update())
+			return false;
+	return true;
+}
+
+// Compare the start of the run seeded from champions with the random one.
+// Champions are collected by the training run with the same settings, so
+// the outcome does not depend on the content of the user's hall of fame.
+// Both compared runs use the same seed, so they differ by seeded genomes.
+static int seedBenchmark(const MainWindow::SmartSweepersSettings &s, int generations, int share) {
+
+	const std::string path = QFile::encodeName(
+			QDir::temp().filePath("smart-sweepers-benchmark.sshf")).constData();
+	const int capacity = s.iHallOfFameSize ? s.iHallOfFameSize : 20;
+	remove(path.c_str());
+
+	double target = 0;
+	{
+		CSimulation training(s, s.iWorldWidth, s.iWorldHeight);
+		training.SetThreads(s.iNumThreads, false);
+		training.SetHallOfFame(path, capacity, 0);
+		training.Reset(1);
+		for (int i = 0; i < generations; ++i)
+			if (!runGeneration(training))
+				return 1;
+		target = training.AverageFitness();
+		// the hall of fame is written when the training run is destroyed
+	}
+
+	CSimulation random(s, s.iWorldWidth, s.iWorldHeight);
+	CSimulation seeded(s, s.iWorldWidth, s.iWorldHeight);
+	random.SetThreads(s.iNumThreads, false);
+	seeded.SetThreads(s.iNumThreads, false);
+	random.SetHallOfFame(std::string(), 0, 0);
+	if (!seeded.SetHallOfFame(path, capacity, share))
+		return 1;
+	random.Reset(2);
+	seeded.Reset(2);
+
+	SRenderSnapshot snapshot;
+	seeded.FillSnapshot(snapshot);
+	printf("Seeded %d of %d genomes from %d champions (best fitness %g)\n", snapshot.iSeededGenomes,
+			s.iNumSweepers, snapshot.iHallOfFameChampions, snapshot.dHallOfFameBest);
+	printf("generation,random_best,random_average,seeded_best,seeded_average\n");
+
+	double randomSum = 0, seededSum = 0;
+	int randomReached = -1, seededReached = -1;
+	for (int i = 0; i < generations; ++i) {
+		if (!runGeneration(random) || !runGeneration(seeded))
+			return 1;
+		printf("%d,%g,%g,%g,%g\n", i, random.BestFitness(), random.AverageFitness(),
+				seeded.BestFitness(), seeded.AverageFitness());
+		randomSum += random.AverageFitness();
+		seededSum += seeded.AverageFitness();
+		if (randomReached == -1 && random.AverageFitness() >= target)
+			randomReached = i;
+		if (seededReached == -1 && seeded.AverageFitness() >= target)
+			seededReached = i;
+	}
+
+	printf("Mean average fitness over %d generations: random %.2f, seeded %.2f\n",
+			generations, randomSum / generations, seededSum / generations);
+	printf("Average fitness of the training run (%.2f) reached in generation (-1 for never): random %d, seeded %d\n",
+			target, randomReached, seededReached);
+
+	remove(path.c_str());
+	return 0;
+}
+
+// Measure the speed and the learning quality for control intervals of 1, 2, 4
+// and 8 ticks. Every closest mine tracked by sweepers is checked against the
+// exact search done at the start of the tick, so the cache can not go stale
+// unnoticed. The mean fitness is taken from the last 10 generations.
+static int controlBenchmark(MainWindow::SmartSweepersSettings s, int generations) {
+
+	const int seeds = 3;
+	int failures = 0;
+
+	printf("interval,time,mean_fitness,lookups,mismatches\n");
+	for (int interval = 1; interval <= 8; interval *= 2) {
+
+		s.iControlInterval = interval;
+		double elapsed = 0, fitness = 0;
+		long lookups = 0, mismatches = 0;
+		int samples = 0;
+
+		for (int seed = 1; seed <= seeds; ++seed) {
+
+			CSimulation simulation(s, s.iWorldWidth, s.iWorldHeight);
+			simulation.SetThreads(s.iNumThreads, false);
+			simulation.SetHallOfFame(std::string(), 0, 0);
+			simulation.Reset(seed);
+
+			vector<SVector2D> positions;
+			vector<double> closest;
+			while (simulation.Generation() < generations) {
+
+				// sweepers read mines as they were at the tick start
+				const int generation = simulation.Generation();
+				const vector<SVector2D> mines = simulation.Mines();
+				const vector<CMinesweeper> &sweepers = simulation.Sweepers();
+				positions.resize(sweepers.size());
+				closest.resize(sweepers.size());
+				for (unsigned int i = 0; i < sweepers.size(); ++i) {
+					positions[i] = sweepers[i].Position();
+					closest[i] = 99999;
+					for (auto j = mines.begin(); j != mines.end(); ++j)
+						closest[i] = std::min(closest[i], Vec2DLength(*j - positions[i]));
+				}
+
+				auto start = std::chrono::steady_clock::now();
+				if (!simulation.Update())
+					return 1;
+				std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+				elapsed += duration.count();
+
+				if (simulation.Generation() != generation) {
+					if (generation >= generations - 10) {
+						fitness += simulation.AverageFitness();
+						++samples;
+					}
+					continue;
+				}
+
+				for (unsigned int i = 0; i < sweepers.size() && i < positions.size(); ++i) {
+					const double distance = Vec2DLength(mines[sweepers[i].ClosestMine()] - positions[i]);
+					if (distance > closest[i] + 1e-9)
+						++mismatches;
+					++lookups;
+				}
+
+			}
+		}
+
+		printf("%d,%.3f,%.2f,%ld,%ld\n", interval, elapsed / seeds,
+				samples ? fitness / samples : 0, lookups, mismatches);
+		if (mismatches)
+			failures++;
+	}
+
+	return failures ? 1 : 0;
+}
+
+// Compare the run resumed from a checkpoint with the uninterrupted one. The
+// population is made odd (the GA breeds pairs) and the checkpoint is taken
+// in the middle of the generation, so the state of the GA and of the world
+// is carried over. The exit status is non-zero if runs differ.
+static int resumeCheck(MainWindow::SmartSweepersSettings s, int generations) {
+
+	const QString path = QDir::temp().filePath("smart-sweepers-resume.sscp");
+	const int resume = generations / 2;
+	const int ticks = s.iNumTicks / 2;
+	s.iNumSweepers |= 1;
+
+	CSimulation uninterrupted(s, s.iWorldWidth, s.iWorldHeight);
+	uninterrupted.SetThreads(s.iNumThreads, false);
+	uninterrupted.SetHallOfFame(std::string(), 0, 0);
+	uninterrupted.Reset(1);
+	for (int i = 0; i < resume; ++i)
+		if (!runGeneration(uninterrupted))
+			return 1;
+	for (int i = 0; i < ticks; ++i)
+		if (!uninterrupted.Update())
+			return 1;
+
+	{
+		CSimulation saved(s, s.iWorldWidth, s.iWorldHeight);
+		saved.SetThreads(s.iNumThreads, false);
+		saved.SetHallOfFame(std::string(), 0, 0);
+		saved.Reset(1);
+		for (int i = 0; i < resume; ++i)
+			if (!runGeneration(saved))
+				return 1;
+		for (int i = 0; i < ticks; ++i)
+			if (!saved.Update())
+				return 1;
+		saved.SaveCheckpoint(QFile::encodeName(path).constData());
+		// the checkpoint is written when the simulation is destroyed
+	}
+
+	QFile file(path);
+	const uchar *data = nullptr;
+	if (file.open(QIODevice::ReadOnly))
+		data = file.map(0, file.size());
+	CSimulation resumed(s, s.iWorldWidth, s.iWorldHeight);
+	resumed.SetThreads(s.iNumThreads, false);
+	resumed.SetHallOfFame(std::string(), 0, 0);
+	if (!data || !resumed.RestoreCheckpoint(data, file.size())) {
+		fprintf(stderr, "Couldn't restore checkpoint: %s\n", QFile::encodeName(path).constData());
+		return 1;
+	}
+	file.close();
+	QFile::remove(path);
+
+	int mismatches = 0;
+	printf("generation,uninterrupted_best,uninterrupted_average,resumed_best,resumed_average\n");
+	for (int i = resume; i < generations; ++i) {
+		if (!runGeneration(uninterrupted) || !runGeneration(resumed))
+			return 1;
+		printf("%d,%g,%g,%g,%g\n", i, uninterrupted.BestFitness(), uninterrupted.AverageFitness(),
+				resumed.BestFitness(), resumed.AverageFitness());
+		if (uninterrupted.BestFitness() != resumed.BestFitness() ||
+				uninterrupted.AverageFitness() != resumed.AverageFitness())
+			mismatches++;
+	}
+
+	// the final state of the world has to be the same as well
+	auto differ = [](SVector2D a, SVector2D b) { return a.x != b.x || a.y != b.y; };
+	const vector<CMinesweeper> &a = uninterrupted.Sweepers();
+	const vector<CMinesweeper> &b = resumed.Sweepers();
+	const vector<SVector2D> &mines = uninterrupted.Mines();
+	if (a.size() != b.size() || mines.size() != resumed.Mines().size())
+		mismatches++;
+	for (unsigned int i = 0; i < a.size() && i < b.size(); ++i)
+		if (differ(a[i].Position(), b[i].Position()) || a[i].Rotation() != b[i].Rotation() ||
+				a[i].Fitness() != b[i].Fitness())
+			mismatches++;
+	for (unsigned int i = 0; i < mines.size() && i < resumed.Mines().size(); ++i)
+		if (differ(mines[i], resumed.Mines()[i]))
+			mismatches++;
+
+	printf("Resumed run of %d sweepers %s the uninterrupted one\n", (int)a.size(),
+			mismatches ? "differs from" : "matches");
+	return mismatches ? 1 : 0;
+}
+
+// Print the population of the given generation from the exported history
+// as CSV (the fitness followed by weights of every genome).
+static int historyDump(const QString &filename, int generation) {
+
+	QFile file(filename);
+	const uchar *data = nullptr;
+	if (file.open(QIODevice::ReadOnly))
+		data = file.map(0, file.size());
+	if (!data) {
+		fprintf(stderr, "Couldn't read history: %s\n", QFile::encodeName(filename).constData());
+		return 1;
+	}
+
+	CGenomeHistoryReader reader;
+	vector<SGenome> population;
+	if (!reader.Open(data, file.size())) {
+		fprintf(stderr, "Invalid history: %s\n", QFile::encodeName(filename).constData());
+		return 1;
+	}
+
+	const int index = reader.Find(generation);
+	if (index == -1 || !reader.Population(index, population)) {
+		fprintf(stderr, "Couldn't decode generation: %d\n", generation);
+		return 1;
+	}
+
+	for (auto i = population.begin(); i != population.end(); ++i) {
+		printf("%.17g", i->dFitness);
+		for (auto j = i->vecWeights.begin(); j != i->vecWeights.end(); ++j)
+			printf(",%.17g", *j);
+		printf("\n");
+	}
+
+	return 0;
+}
 
 
 int main(int argc, char *argv[]) {
 
 	QApplication app(argc, argv);
+	CProfiler::SetThreadName("gui");
 
 	// set values required by the settings manager
 	app.setOrganizationName("ArkqSoft");
 	app.setApplicationName("SmartSweepers");
 
+	// offscreen rendering benchmark: --render-benchmark [OBJECTS]
+	QStringList args = app.arguments();
+	int index = args.indexOf("--render-benchmark");
+	if (index != -1) {
+		int objects = index + 1 < args.size() ? args[index + 1].toInt() : 50000;
+		const int frames = 100;
+		double fps = SceneController::renderBenchmark(objects, frames);
+		printf("Rendered %d frames with %d objects: %.1f frames per second\n", frames, objects, fps);
+		return 0;
+	}
+
+	// decode genomes from the exported history: --history-dump FILE GENERATION
+	index = args.indexOf("--history-dump");
+	if (index != -1) {
+		if (index + 2 >= args.size()) {
+			fprintf(stderr, "usage: --history-dump FILE GENERATION\n");
+			return 1;
+		}
+		return historyDump(args[index + 1], args[index + 2].toInt());
+	}
+
 	MainWindow window(app);
+
+	// warm start benchmark with current settings: --seed-benchmark [GENERATIONS [SHARE]]
+	index = args.indexOf("--seed-benchmark");
+	if (index != -1) {
+		int generations = index + 1 < args.size() ? args[index + 1].toInt() : 50;
+		int share = index + 2 < args.size() ? args[index + 2].toInt() : 20;
+		return seedBenchmark(window.s, std::max(1, generations), share);
+	}
+
+	// control rate benchmark with current settings: --control-benchmark [GENERATIONS]
+	index = args.indexOf("--control-benchmark");
+	if (index != -1) {
+		int generations = index + 1 < args.size() ? args[index + 1].toInt() : 40;
+		return controlBenchmark(window.s, std::max(1, generations));
+	}
+
+	// checkpoint resume self-check with current settings: --resume-check [GENERATIONS]
+	index = args.indexOf("--resume-check");
+	if (index != -1) {
+		int generations = index + 1 < args.size() ? args[index + 1].toInt() : 10;
+		return resumeCheck(window.s, std::max(2, generations));
+	}
+
 	window.show();
 
 	return app.exec();
@@ -9,6 +9,7 @@
 #ifndef SMARTSWEEPERSQT_UTILS_H_
 #define SMARTSWEEPERSQT_UTILS_H_
 
+#include <cstdint>
 #include <cstdlib>
 
 
@@ -27,6 +28,51 @@ inline double RandomClamped() {
 	return RandFloat() - RandFloat();
 }
 
+// Seedable pseudo-random number generator (xorshift64*). Contrary to the
+// rand(), the state is owned by the caller, so the sequence does not depend
+// on other users of the global generator nor on the threads scheduling.
+class CRandom {
+
+public:
+
+	CRandom(uint64_t seed = 1) { Seed(seed); }
+
+	void Seed(uint64_t seed) { m_State = seed ? seed : 0x9E3779B97F4A7C15ull; }
+
+	// the state is never zero, so seeding with it restores the sequence
+	uint64_t State() const { return m_State; }
+
+	uint64_t Next() {
+		m_State ^= m_State >> 12;
+		m_State ^= m_State << 25;
+		m_State ^= m_State >> 27;
+		return m_State * 0x2545F4914F6CDD1Dull;
+	}
+
+	// returns a random integer between x and y
+	int RandInt(int x, int y) { return (int)(Next() % (y - x + 1)) + x; }
+
+	// returns a random float between zero and 1
+	double RandFloat() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+	// returns a random float in the range -1 < n < 1
+	double RandomClamped() { return RandFloat() - RandFloat(); }
+
+private:
+
+	uint64_t m_State;
+
+};
+
+// Derive a seed for the given stream index (splitmix64 finalizer), so every
+// object can own an independent generator regardless of the processing order.
+inline uint64_t SplitSeed(uint64_t seed, uint64_t index) {
+	uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
 // clamps the first argument between the second two
 inline void Clamp(double &arg, double min, double max) {
 	if (arg < min)
@@ -16,30 +16,63 @@ unix:!greaterThan(QT_MAJOR_VERSION, 4) {
 	QMAKE_CXXFLAGS += -std=c++11
 }
 
-contains(DEFINES, WITH_OPENMP) {
-	win32-msvc* {
-		QMAKE_CXXFLAGS += -openmp
-	} else {
-		QMAKE_CXXFLAGS += -fopenmp
-		QMAKE_LFLAGS += -fopenmp
-	}
+unix {
+	# required by the std::thread
+	QMAKE_CXXFLAGS += -pthread
+	QMAKE_LFLAGS += -pthread
 }
 
 HEADERS += \
+	src/CCheckpoint.h \
+	src/CExportWriter.h \
 	src/CGenAlg.h \
+	src/CGenomeHistory.h \
+	src/CHallOfFame.h \
+	src/CMineGrid.h \
 	src/CMinesweeper.h \
 	src/CNeuralNet.h \
+	src/CPopulationStats.h \
+	src/CProfiler.h \
+	src/CQuantileSketch.h \
+	src/CSimulation.h \
+	src/CThreadPool.h \
+	src/CTrajectory.h \
+	src/CTrajectoryReader.h \
+	src/CTripleBuffer.h \
+	src/FramePacer.h \
 	src/MainWindow.h \
+	src/ObjectBatchItem.h \
 	src/SceneController.h \
+	src/SimulationThread.h \
+	src/SSimulationConfig.h \
+	src/StatisticsModel.h \
 	src/SVector2D.h \
+	src/TrajectoryReplay.h \
 	src/utils.h
 
 SOURCES += \
+	src/CCheckpoint.cpp \
+	src/CExportWriter.cpp \
 	src/CGenAlg.cpp \
+	src/CGenomeHistory.cpp \
+	src/CHallOfFame.cpp \
+	src/CMineGrid.cpp \
 	src/CMinesweeper.cpp \
 	src/CNeuralNet.cpp \
+	src/CPopulationStats.cpp \
+	src/CProfiler.cpp \
+	src/CQuantileSketch.cpp \
+	src/CSimulation.cpp \
+	src/CThreadPool.cpp \
+	src/CTrajectory.cpp \
+	src/CTrajectoryReader.cpp \
+	src/FramePacer.cpp \
 	src/MainWindow.cpp \
+	src/ObjectBatchItem.cpp \
 	src/SceneController.cpp \
+	src/SimulationThread.cpp \
+	src/StatisticsModel.cpp \
+	src/TrajectoryReplay.cpp \
 	src/main.cpp
 
 FORMS += \